@@ -0,0 +1,75 @@
+// Compares GerberFile::GetCoordinate with the digit by digit reference path
+// on a synthetic stream of D01 statements.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "gerber_file.h"
+
+
+namespace {
+
+std::string MakeCoordinates(std::size_t count) {
+	std::mt19937 random(1);
+	std::uniform_int_distribution<int> value(-99999999, 99999999);
+
+	std::string text;
+	for (std::size_t i = 0; i < count; i++) {
+		text += 'X' + std::to_string(value(random));
+		text += 'Y' + std::to_string(value(random));
+		text += "D01*\n";
+	}
+	return text;
+}
+
+template <typename Parse>
+double Run(const std::string& text, Parse parse, double& checksum) {
+	GerberFile file;
+	file.buffer_ = text;
+
+	auto start = std::chrono::steady_clock::now();
+	while (!file.EndOfFile()) {
+		auto c = file.GetChar();
+		if (c == 'X' || c == 'Y') {
+			double number;
+			parse(file, number);
+			checksum += number;
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	constexpr int kRounds = 5;
+	auto text = MakeCoordinates(argc > 1 ? std::stoul(argv[1]) : 2000000);
+
+	auto fast = [](GerberFile& file, double& number) { file.GetCoordinate(number, 3, 5, false); };
+	auto scalar = [](GerberFile& file, double& number) { file.GetCoordinateScalar(number, 3, 5, false); };
+
+	double fast_time = 1e300, scalar_time = 1e300;
+	double fast_sum = 0, scalar_sum = 0;
+	for (int i = 0; i < kRounds; i++) {
+		fast_sum = scalar_sum = 0;
+		fast_time = std::min(fast_time, Run(text, fast, fast_sum));
+		scalar_time = std::min(scalar_time, Run(text, scalar, scalar_sum));
+	}
+
+	auto megabytes = text.size() / 1e6;
+	std::cout << "input:            " << megabytes << " MB" << std::endl;
+	std::cout << "GetCoordinate:    " << fast_time << " ms, " << megabytes / fast_time * 1000 << " MB/s" << std::endl;
+	std::cout << "scalar reference: " << scalar_time << " ms, " << megabytes / scalar_time * 1000 << " MB/s" << std::endl;
+
+	if (std::memcmp(&fast_sum, &scalar_sum, sizeof(double)) != 0) {
+		std::cout << "results differ!" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+// Times aperture macro instantiation on a synthetic macro-heavy layer: every
+// pad is its own aperture, so each definition renders its macro once.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "gerber.h"
+
+
+namespace {
+
+std::string MakeLayer(int apertures) {
+	std::string text = "%FSLAX26Y26*%\n%MOMM*%\n";
+
+	// Thermal relief and moire targets sized from a few parameters, the way
+	// CAD tools write them for inner plane connections.
+	text += "%AMTHERMAL*\n$4=$1x0.5*\n$5=$4-$2*\n"
+		"1,1,$1+$3x2,0,0*\n1,0,$1,0,0*\n"
+		"7,0,0,$1,$1-($2x2),$3,45*\n"
+		"21,1,$3,$1+(0.25x4),0,0,$5x(180/3.14159265)*%\n";
+	text += "%AMTARGET*\n6,0,0,$1x(1+2/10),$1/(2x4),$2,3,$2/2,$1x1.5,0*\n"
+		"4,1,4,-$1,-$1,$1,-$1,$1,$1,-$1,$1,-$1,-$1,0*%\n";
+
+	for (int i = 0; i < apertures; i++) {
+		auto code = std::to_string(10 + i);
+		auto size = std::to_string(0.5 + (i % 1000) * 0.001);
+		if (i % 4) {
+			text += "%ADD" + code + "THERMAL," + size + "X0.1X0.2*%\n";
+		}
+		else {
+			text += "%ADD" + code + "TARGET," + size + "X0.05*%\n";
+		}
+	}
+
+	for (int i = 0; i < apertures; i++) {
+		text += "D" + std::to_string(10 + i) + "*\n";
+		text += "X" + std::to_string(i * 1000) + "Y0D03*\n";
+	}
+	text += "M02*\n";
+
+	return text;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	constexpr int kRounds = 5;
+	auto text = MakeLayer(argc > 1 ? std::stoi(argv[1]) : 100000);
+
+	double best = 1e300;
+	std::size_t commands = 0;
+	for (int i = 0; i < kRounds; i++) {
+		auto start = std::chrono::steady_clock::now();
+		auto gerber = Gerber::FromMemory(text);
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+
+		commands = 0;
+		for (const auto& level : gerber->Levels()) {
+			commands += level->RenderCommands().size();
+		}
+	}
+
+	std::cout << "input:    " << text.size() / 1e6 << " MB, " << commands << " commands" << std::endl;
+	std::cout << "parse:    " << best << " ms" << std::endl;
+
+	return 0;
+}
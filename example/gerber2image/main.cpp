@@ -1,17 +1,21 @@
 #include <QApplication>
 #include <QFileDialog>
 #include <QIcon>
-#include <QBitmap>
+#include <QImage>
 
+#include "tiled_renderer.h"
 #include "gerber_renderer.h"
-#include "engine/qt_engine.h"
+#include "gerber_set.h"
+#include "engine/raster_engine.h"
+#include "thread_pool.h"
 
 #include <gflags/gflags.h>
 #include "main.h"
 
-DEFINE_string(gerber_files, "", "The path of gerber files you want to export.If there are more than one file, separate them with ','.");
+DEFINE_string(gerber_files, "", "The path of gerber files you want to export.If there are more than one file, separate them with ','. Zip archives and gzip compressed files are read directly.");
 DEFINE_string(output_path, "", "Output path of rendered image files");
 DEFINE_double(um_pixel, 5, "How much um/pixel.Default value is 5um/pixel");
+DEFINE_string(format, "bmp", "bmp: 1-bit BMP; pbm: packed 1-bit PBM; runs: run length encoding of every row, see RasterEngine::SaveRuns. pbm and runs are rendered without anti-aliasing straight into packed bits.");
 
 int main(int argc, char* argv[]) {
 	gflags::SetUsageMessage("Usage: gerber2image --gerber_files=\"path/to/gerber/file1, path/to/gerber/file2...\" --output_path=\"path/\" --um_pixel=5.\
@@ -28,15 +32,22 @@ int main(int argc, char* argv[]) {
 	QString files(FLAGS_gerber_files.c_str());
 	auto file_list = files.split(',', Qt::SkipEmptyParts);
 
-	std::vector<std::shared_ptr<Gerber>> gerbers;
+	GerberSet set;
+
+	std::vector<std::string> file_names;
 	for (const auto file : file_list) {
-		gerbers.push_back(std::make_shared<Gerber>(file.toLocal8Bit().toStdString()));
+		if (file.endsWith(".zip", Qt::CaseInsensitive)) {
+			set.LoadArchive(file.toLocal8Bit().toStdString());
+		}
+		else {
+			file_names.push_back(file.toLocal8Bit().toStdString());
+		}
 	}
 
-	BoundBox box;
-	for (const auto gerber : gerbers) {
-		box.UpdateBox(gerber->GetBBox());
-	}
+	set.Load(file_names);
+
+	auto gerbers = set.Gerbers();
+	auto box = set.GetBBox();
 
 	for (const auto gerber : gerbers) {
 		auto width = box.Right() - box.Left();
@@ -69,26 +80,66 @@ int main(int argc, char* argv[]) {
 
 void ExportGerber(std::shared_ptr<Gerber> gerber, const BoundBox& box, int img_w, int img_h, int pixel_w, int pixel_h)
 {
-	auto image = std::make_unique<QBitmap>(img_w, img_h);
-	auto engine = std::make_unique<QtEngine>(image.get(), box, BoundBox(0.0, 0.0, 0.0, 0.0));
-	GerberRender render(engine.get());
-
 	int height_scale = (pixel_h - 1) / img_h + 1;
 	int width_scale = (pixel_w - 1) / img_w + 1;
 
-	engine->Scale(std::max(width_scale, height_scale) - 1);
+	// Each image shows the same share of the box
+	const auto times = std::max(width_scale, height_scale);
+	const auto part_w = box.Width() / times;
+	const auto part_h = box.Height() / times;
+
+	auto part_box = [&](int i, int j) {
+		return BoundBox(
+			box.Left() + j * part_w,
+			box.Left() + (j + 1) * part_w,
+			box.Top() - i * part_h,
+			box.Top() - (i + 1) * part_h
+		);
+	};
+
+	auto file_name = QString(gerber->FileName().c_str()).split('/').last();
+	auto image_file = [&](int i, int j) {
+		return QString(FLAGS_output_path.c_str()) + file_name + '_' + QString("%1").arg(i) + '_' + QString("%1").arg(j) + '.' + QString(FLAGS_format.c_str());
+	};
+
+	if (FLAGS_format == "pbm" || FLAGS_format == "runs") {
+		// A binary engine for each part, the parts rendered at once
+		ThreadPool pool;
+		std::vector<std::future<void>> results;
+		for (int i = 0; i < height_scale; ++i) {
+			for (int j = 0; j < width_scale; ++j) {
+				results.push_back(pool.Submit([gerber, part = part_box(i, j), file = image_file(i, j).toLocal8Bit().toStdString(), img_w, img_h]() {
+					RasterEngine engine(img_w, img_h, part, rfBinary);
+
+					// All the engine shows: the part centred, with a single scale
+					const auto scale = std::max(part.Width() / img_w, part.Height() / img_h);
+					const auto x = (img_w * scale - part.Width()) / 2.0;
+					const auto y = (img_h * scale - part.Height()) / 2.0;
+					GerberRender(&engine).RenderGerber(gerber, BoundBox(part.Left() - x, part.Right() + x, part.Top() + y, part.Bottom() - y));
+					if (FLAGS_format == "pbm") {
+						engine.SavePnm(file);
+					}
+					else {
+						engine.SaveRuns(file);
+					}
+				}));
+			}
+		}
 
-	for (int i = 0; i < height_scale; ++i) {
-		for (int j = 0; j < width_scale; ++j) {
-			render.RenderGerber(gerber);
+		for (auto& result : results) {
+			result.get();
+		}
+		return;
+	}
 
-			auto file_name = QString(gerber->FileName().c_str()).split('/').last();
-			auto image_file = QString(FLAGS_output_path.c_str()) + file_name + '_' + QString("%1").arg(i) + '_' + QString("%1").arg(j) + ".bmp";
-			image->save(image_file);
+	// The tiles of each image are rendered at once, and converted to bits
+	QImage image(img_w, img_h, QImage::Format_Mono);
+	TiledRender render;
 
-			engine->Move(-img_w, 0);
+	for (int i = 0; i < height_scale; ++i) {
+		for (int j = 0; j < width_scale; ++j) {
+			render.Render(gerber, part_box(i, j), image);
+			image.save(image_file(i, j));
 		}
-
-		engine->Move(img_w * width_scale, -img_h);
 	}
 }
@@ -13,6 +13,7 @@ public:
 		gerber_ = std::make_shared<Gerber>(file.toLocal8Bit().toStdString());
 
 		engine_ = std::make_unique<QtEngine>(this, gerber_->GetBBox(), BoundBox(0.025, 0.025, 0.025, 0.025));
+		engine_->level_of_detail_ = true;
 		render_ = std::make_unique<GerberRender>(engine_.get());
 	}
 
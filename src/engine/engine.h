@@ -44,6 +44,9 @@ public:
 	virtual void PrepareCopyLayer(double left, double bottom, double right, double top) = 0;
 	virtual void CopyLayer(int count_x, int count_y, double step_x, double step_y) = 0;
 	virtual void Prepare2Render() = 0;
+	// Moves what is drawn from now on by x, y mm, as for a single copy of a
+	// step and repeat level. Not used between PrepareCopyLayer and CopyLayer.
+	virtual void Translate(double x, double y) = 0;
 
 	virtual bool PrepareExistAperture(int code) = 0;
 	virtual void BeginRender() = 0;
@@ -53,5 +56,12 @@ public:
 	virtual void EndDrawNewAperture(int code) = 0;
 	virtual void NewAperture(double left, double bottom, double right, double top) = 0;
 
+	// A single device pixel in the current polarity
+	virtual void DrawDot(double x, double y) = 0;
+	// The size of a device pixel in mm at the current scale
+	virtual double PixelSize() const = 0;
+
 	bool convert_strokes2fills_{ false };
+	// Render simplified geometry where the detail would be below a pixel
+	bool level_of_detail_{ false };
 };
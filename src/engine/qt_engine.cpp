@@ -1,10 +1,11 @@
 #include "qt_engine.h"
 #include <QPainter>
-#include <QPixmap>
+#include <QImage>
 
 
 QtEngine::QtEngine(QPaintDevice* device, const BoundBox& bound_box, const BoundBox& offset) :
 	pic_(device),
+	offset_(offset),
 	trans_(bound_box.Scaled(kTimes), offset)
 {
 	trans_.SetPhysicalSize(pic_->width(), pic_->height());
@@ -35,6 +36,19 @@ void QtEngine::Move(int delta_x, int delta_y)
 	trans_.Move(delta_x, delta_y);
 }
 
+void QtEngine::View(const BoundBox& bound_box)
+{
+	const auto scale = trans_.TranslateLogicCoord(1.0);
+
+	trans_ = Transformation(bound_box.Scaled(kTimes), offset_);
+	trans_.SetPhysicalSize(pic_->width(), pic_->height());
+
+	// Aperture images are drawn at the scale of the time
+	if (fabs(trans_.TranslateLogicCoord(1.0) - scale) > scale * 1e-9) {
+		apertures_.clear();
+	}
+}
+
 void QtEngine::BeginRender() {
 	painter_ = CreatePainter(pic_);
 	painter_->fillRect(0, 0, pic_->width(), pic_->height(), QColor(255, 255, 255));
@@ -442,7 +456,7 @@ void QtEngine::PrepareCopyLayer(double left, double bottom, double right, double
 		height = 1;
 	}
 
-	copy_level_ = std::make_shared<QPixmap>(width, height);
+	copy_level_ = std::make_shared<QImage>(width, height, QImage::Format_ARGB32_Premultiplied);
 	copy_level_->fill(QColor(255, 255, 255, 0));
 	copy_painter_ = std::make_shared<QPainter>(copy_level_.get());
 	copy_painter_->setRenderHint(QPainter::Antialiasing);
@@ -459,7 +473,7 @@ void QtEngine::CopyLayer(int count_x, int count_y, double step_x, double step_y)
 
 	for (int y = 0; y < count_y; ++y) {
 		for (int x = 0; x < count_x; ++x) {
-			painter_->drawPixmap(QRectF(copy_left_, copy_bottom_, copy_right_ - copy_left_, copy_top_ - copy_bottom_), *copy_level_, copy_level_->rect());
+			painter_->drawImage(QRectF(copy_left_, copy_bottom_, copy_right_ - copy_left_, copy_top_ - copy_bottom_), *copy_level_, copy_level_->rect());
 			painter_->translate(step_x, 0);
 		}
 
@@ -474,13 +488,21 @@ void QtEngine::Prepare2Render() {
 	copy_level_ = nullptr;
 }
 
+void QtEngine::Translate(double x, double y) {
+	painter_->resetTransform();
+	painter_->translate(x * kTimes, y * kTimes);
+
+	// Where the selection is on the copy
+	selected_ = painter_->combinedTransform().inverted().map(QPoint(select_x_, select_y_));
+}
+
 bool QtEngine::PrepareExistAperture(int code) {
 	if (apertures_.find(code) != apertures_.end()) {
 		aperture_left_ = apertures_[code].left_;
 		aperture_right_ = apertures_[code].right;
 		aperture_top_ = apertures_[code].top;
 		aperture_bottom_ = apertures_[code].bottom;
-		aperture_ = apertures_[code].pixmap;
+		aperture_ = apertures_[code].image;
 		return true;
 	}
 
@@ -488,7 +510,7 @@ bool QtEngine::PrepareExistAperture(int code) {
 }
 
 int QtEngine::Flash(double x, double y) {
-	current_painter_->drawPixmap(
+	current_painter_->drawImage(
 		QRectF(
 			x * kTimes - (aperture_right_ - aperture_left_) / 2,
 			y * kTimes - (aperture_top_ - aperture_bottom_) / 2,
@@ -507,7 +529,7 @@ void QtEngine::EndDrawNewAperture(int code) {
 	aperture.right = aperture_right_;
 	aperture.top = aperture_top_;
 	aperture.bottom = aperture_bottom_;
-	aperture.pixmap = aperture_;
+	aperture.image = aperture_;
 
 	apertures_[code] = aperture;
 
@@ -537,7 +559,7 @@ void QtEngine::NewAperture(double left, double bottom, double right, double top)
 		height = 1;
 	}
 
-	aperture_ = std::make_shared<QPixmap>(width, height);
+	aperture_ = std::make_shared<QImage>(width, height, QImage::Format_ARGB32_Premultiplied);
 	aperture_->fill(QColor(255, 255, 255, 0));
 	aperture_painter_ = std::make_shared<QPainter>(aperture_.get());
 	aperture_painter_->setRenderHint(QPainter::Antialiasing);
@@ -545,3 +567,15 @@ void QtEngine::NewAperture(double left, double bottom, double right, double top)
 
 	path_.clear();
 }
+
+void QtEngine::DrawDot(double x, double y) {
+	QPen pen(negative_ ? QColor(255, 255, 255) : QColor(255, 0, 0));
+	pen.setCosmetic(true);
+	pen.setWidth(1);
+	current_painter_->setPen(pen);
+	current_painter_->drawPoint(QPointF(x * kTimes, y * kTimes));
+}
+
+double QtEngine::PixelSize() const {
+	return trans_.TranslatePenWidth(1.0) / kTimes;
+}
@@ -6,7 +6,7 @@
 #include "transformation.h"
 
 class QPainter;
-class QPixmap;
+class QImage;
 class QPaintDevice;
 
 class QtEngine : public Engine {
@@ -17,6 +17,9 @@ public:
 	void Scale(double delta, double center_x = 0.0, double center_y = 0.0);
 	void Select(int x, int y);
 	void Move(int delta_x, int delta_y);
+	// Shows the bound box on the device from now on, like a new engine would,
+	// but keeps the apertures drawn so far if the scale stays the same.
+	void View(const BoundBox& bound_box);
 
 protected:
 	void BeginRender() override;
@@ -54,10 +57,13 @@ protected:
 	void PrepareCopyLayer(double left, double bottom, double right, double top) override;
 	void CopyLayer(int count_x, int count_y, double step_x, double step_y) override;
 	void Prepare2Render() override;
+	void Translate(double x, double y) override;
 	bool PrepareExistAperture(int code) override;
 	int Flash(double x, double y) override;
 	void EndDrawNewAperture(int code) override;
 	void NewAperture(double left, double bottom, double right, double top) override;
+	void DrawDot(double x, double y) override;
+	double PixelSize() const override;
 
 	virtual std::shared_ptr<QPainter> CreatePainter(QPaintDevice* pic);
 
@@ -65,10 +71,11 @@ private:
 	QPaintDevice* pic_;
 	std::shared_ptr<QPainter> painter_;
 
-	std::shared_ptr<QPixmap> aperture_;
+	// Images rather than pixmaps, which belong to the GUI thread
+	std::shared_ptr<QImage> aperture_;
 	std::shared_ptr<QPainter> aperture_painter_;
 
-	std::shared_ptr<QPixmap> copy_level_;
+	std::shared_ptr<QImage> copy_level_;
 	std::shared_ptr<QPainter> copy_painter_;
 
 	std::shared_ptr<QPainter> current_painter_;
@@ -87,6 +94,7 @@ private:
 
 	static constexpr int kTimes = 10000;
 
+	BoundBox offset_;
 	Transformation trans_;
 
 	int select_x_{ 0 };
@@ -100,7 +108,7 @@ private:
 		double right;
 		double bottom;
 
-		std::shared_ptr<QPixmap> pixmap;
+		std::shared_ptr<QImage> image;
 	};
 	std::map<int, Aperture> apertures_;
 
@@ -0,0 +1,773 @@
+#include "raster_engine.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTER_ENGINE_SSE2 1
+#endif
+
+
+namespace {
+
+constexpr double kPi = 3.141592653589793;
+
+// a * b / 255, rounded
+inline std::uint8_t Multiply(unsigned a, unsigned b) {
+	const auto t = a * b + 128;
+	return static_cast<std::uint8_t>((t + (t >> 8)) >> 8);
+}
+
+// Painting adds the coverage to what is there, erasing takes it away.
+inline std::uint8_t Blend(std::uint8_t pixel, std::uint8_t coverage, bool negative) {
+	return negative ?
+		Multiply(pixel, 255 - coverage) :
+		static_cast<std::uint8_t>(pixel + Multiply(255 - pixel, coverage));
+}
+
+#ifdef RASTER_ENGINE_SSE2
+// The same as Blend for 16 pixels at once
+inline __m128i Blend(__m128i pixels, __m128i coverage, bool negative) {
+	const auto zero = _mm_setzero_si128();
+	const auto all = _mm_set1_epi8(static_cast<char>(0xFF));
+	const auto half = _mm_set1_epi16(128);
+
+	auto multiply = [&](__m128i a, __m128i b) {
+		auto low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)), half);
+		auto high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)), half);
+		low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+		high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+		return _mm_packus_epi16(low, high);
+	};
+
+	if (negative) {
+		return multiply(pixels, _mm_xor_si128(coverage, all));
+	}
+	return _mm_add_epi8(pixels, multiply(_mm_xor_si128(pixels, all), coverage));
+}
+#endif
+
+// count pixels of a single coverage
+void FillSpan(std::uint8_t* pixels, int count, std::uint8_t coverage, bool negative) {
+	if (coverage == 255) {
+		std::memset(pixels, negative ? 0 : 255, count);
+		return;
+	}
+
+	int i = 0;
+#ifdef RASTER_ENGINE_SSE2
+	const auto block = _mm_set1_epi8(static_cast<char>(coverage));
+	for (; i + 16 <= count; i += 16) {
+		auto target = reinterpret_cast<__m128i*>(pixels + i);
+		_mm_storeu_si128(target, Blend(_mm_loadu_si128(target), block, negative));
+	}
+#endif
+	for (; i < count; i++) {
+		pixels[i] = Blend(pixels[i], coverage, negative);
+	}
+}
+
+// count pixels, each with its own coverage
+void BlendSpan(std::uint8_t* pixels, const std::uint8_t* coverage, int count, bool negative) {
+	int i = 0;
+#ifdef RASTER_ENGINE_SSE2
+	for (; i + 16 <= count; i += 16) {
+		auto target = reinterpret_cast<__m128i*>(pixels + i);
+		const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage + i));
+		_mm_storeu_si128(target, Blend(_mm_loadu_si128(target), block, negative));
+	}
+#endif
+	for (; i < count; i++) {
+		pixels[i] = Blend(pixels[i], coverage[i], negative);
+	}
+}
+
+// Sets or clears count pixels from x of a packed row, the whole bytes in
+// between at once
+void SetBits(std::uint8_t* row, int x, int count, bool value) {
+	if (count <= 0) {
+		return;
+	}
+
+	const auto first = x >> 3;
+	const auto last = (x + count - 1) >> 3;
+	auto head = static_cast<std::uint8_t>(0xFF >> (x & 7));
+	const auto tail = static_cast<std::uint8_t>(0xFF << (7 - ((x + count - 1) & 7)));
+
+	auto apply = [value](std::uint8_t& byte, std::uint8_t mask) {
+		byte = value ? byte | mask : byte & ~mask;
+	};
+
+	if (first == last) {
+		apply(row[first], head & tail);
+		return;
+	}
+
+	apply(row[first], head);
+	std::memset(row + first + 1, value ? 0xFF : 0x00, last - first - 1);
+	apply(row[last], tail);
+}
+
+// The same for the pixels that are at least half covered
+void SetCovered(std::uint8_t* row, int x, const std::uint8_t* coverage, int count, bool value) {
+	for (int i = 0; i < count;) {
+		if (coverage[i] < 128) {
+			i++;
+			continue;
+		}
+
+		const auto start = i;
+		while (i < count && coverage[i] >= 128) {
+			i++;
+		}
+		SetBits(row, x + start, i - start, value);
+	}
+}
+
+// Enough segments for an arc of the angle that none is further than the
+// tolerance from it
+int Segments(double radius, double angle, double tolerance) {
+	const auto step = radius > tolerance ? 2.0 * std::acos(1.0 - tolerance / radius) : kPi / 2.0;
+	return std::min(std::max(static_cast<int>(std::ceil(std::fabs(angle) / step)), 1), 4096);
+}
+
+// Where the points between segments of the angle go, so that the segments
+// enclose as much area as the arc does
+double OuterRadius(double radius, double angle) {
+	angle = std::fabs(angle);
+	return angle > 1e-9 ? radius * std::sqrt(angle / std::sin(angle)) : radius;
+}
+
+// Takes the output of ScanlineRasterizer into an 8-bit buffer
+struct COVERAGE_SINK {
+	std::uint8_t* pixels_;
+	int stride_;
+	bool negative_;
+
+	void Span(int y, int x, int count, std::uint8_t coverage) {
+		FillSpan(pixels_ + static_cast<std::size_t>(y) * stride_ + x, count, coverage, negative_);
+	}
+
+	void Cells(int y, int x, const std::uint8_t* coverage, int count) {
+		BlendSpan(pixels_ + static_cast<std::size_t>(y) * stride_ + x, coverage, count, negative_);
+	}
+};
+
+// The same into packed bits, without anti-aliasing
+struct BINARY_SINK {
+	std::uint8_t* pixels_;
+	std::size_t stride_;
+	bool negative_;
+
+	void Span(int y, int x, int count, std::uint8_t coverage) {
+		if (coverage >= 128) {
+			SetBits(pixels_ + y * stride_, x, count, !negative_);
+		}
+	}
+
+	void Cells(int y, int x, const std::uint8_t* coverage, int count) {
+		SetCovered(pixels_ + y * stride_, x, coverage, count, !negative_);
+	}
+};
+
+void Write32(std::ostream& stream, std::uint32_t value) {
+	const char bytes[] = {
+		static_cast<char>(value & 0xFF),
+		static_cast<char>((value >> 8) & 0xFF),
+		static_cast<char>((value >> 16) & 0xFF),
+		static_cast<char>((value >> 24) & 0xFF)
+	};
+	stream.write(bytes, sizeof(bytes));
+}
+
+}
+
+RasterEngine::RasterEngine(int width, int height, const BoundBox& bound_box, RASTER_FORMAT format) :
+	width_(std::max(width, 0)),
+	height_(std::max(height, 0)),
+	format_(format),
+	stride_(format == rfBinary ? (static_cast<std::size_t>(width_) + 7) / 8 : width_),
+	pixels_(stride_ * height_, 0)
+{
+	// Centred, with a single scale
+	scale_ = std::max(bound_box.Width() / std::max(width_, 1), bound_box.Height() / std::max(height_, 1));
+	if (!(scale_ > 0.0)) {
+		scale_ = 1.0;
+	}
+	left_ = bound_box.Left() - (width_ * scale_ - bound_box.Width()) / 2.0;
+	top_ = bound_box.Top() + (height_ * scale_ - bound_box.Height()) / 2.0;
+}
+
+int RasterEngine::Width() const {
+	return width_;
+}
+
+int RasterEngine::Height() const {
+	return height_;
+}
+
+RASTER_FORMAT RasterEngine::Format() const {
+	return format_;
+}
+
+std::size_t RasterEngine::Stride() const {
+	return stride_;
+}
+
+const std::vector<std::uint8_t>& RasterEngine::Pixels() const {
+	return pixels_;
+}
+
+void RasterEngine::Runs(int y, std::vector<RUN>& runs) const {
+	runs.clear();
+	if (y < 0 || y >= height_) {
+		return;
+	}
+
+	const auto row = pixels_.data() + y * stride_;
+	auto start = -1;
+	auto toggle = [&](int x, bool covered) {
+		if (covered && start < 0) {
+			start = x;
+		}
+		else if (!covered && start >= 0) {
+			runs.push_back({ start, x - start });
+			start = -1;
+		}
+	};
+
+	if (format_ == rfCoverage) {
+		for (int x = 0; x < width_; x++) {
+			toggle(x, row[x] >= 128);
+		}
+	}
+	else {
+		for (std::size_t i = 0; i < stride_;) {
+			// Eight bytes at once while nothing changes
+			const std::uint64_t same = start < 0 ? 0 : ~0ull;
+			if (i + 8 <= stride_) {
+				std::uint64_t word;
+				std::memcpy(&word, row + i, 8);
+				if (word == same) {
+					i += 8;
+					continue;
+				}
+			}
+
+			if (row[i] != static_cast<std::uint8_t>(same)) {
+				for (int bit = 0; bit < 8; bit++) {
+					const auto x = static_cast<int>(i * 8) + bit;
+					if (x < width_) {
+						toggle(x, (row[i] >> (7 - bit)) & 1);
+					}
+				}
+			}
+			i++;
+		}
+	}
+
+	if (start >= 0) {
+		runs.push_back({ start, width_ - start });
+	}
+}
+
+bool RasterEngine::SavePnm(const std::string& file_name) const {
+	std::ofstream file(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
+	file << (format_ == rfBinary ? "P4" : "P5") << '\n' << width_ << ' ' << height_ << '\n';
+	if (format_ == rfBinary) {
+		file.write(reinterpret_cast<const char*>(pixels_.data()), pixels_.size());
+	}
+	else {
+		// PGM has 0 for black, so covered pixels are inverted to look like
+		// those of a PBM
+		file << "255\n";
+		std::vector<char> row(stride_);
+		for (std::size_t offset = 0; offset < pixels_.size() && file; offset += stride_) {
+			for (std::size_t x = 0; x < stride_; x++) {
+				row[x] = static_cast<char>(255 - pixels_[offset + x]);
+			}
+			file.write(row.data(), row.size());
+		}
+	}
+
+	if (!file) {
+		LOG(ERROR) << "Error: Failed to write image " << file_name;
+		return false;
+	}
+	return true;
+}
+
+bool RasterEngine::SaveRuns(const std::string& file_name) const {
+	std::ofstream file(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
+	Write32(file, width_);
+	Write32(file, height_);
+
+	std::vector<RUN> runs;
+	for (int y = 0; y < height_ && file; y++) {
+		Runs(y, runs);
+		Write32(file, static_cast<std::uint32_t>(runs.size()));
+		for (const auto& run : runs) {
+			Write32(file, run.x_);
+			Write32(file, run.length_);
+		}
+	}
+
+	if (!file) {
+		LOG(ERROR) << "Error: Failed to write runs " << file_name;
+		return false;
+	}
+	return true;
+}
+
+double RasterEngine::DeviceX(double x) const {
+	return (x - left_) / scale_;
+}
+
+double RasterEngine::DeviceY(double y) const {
+	return (top_ - y) / scale_;
+}
+
+double RasterEngine::Tolerance() const {
+	return scale_ / 4.0;
+}
+
+void RasterEngine::AddArc(std::vector<POINT>& contour, double x, double y, double degree) const {
+	const auto start = contour.back();
+	const auto radius = std::hypot(start.x_ - x, start.y_ - y);
+	if (radius < 1e-15) {
+		return;
+	}
+
+	const auto angle = degree * kPi / 180.0;
+	const auto segments = Segments(radius, angle, Tolerance());
+	const auto outer = OuterRadius(radius, angle / segments);
+
+	const auto begin = std::atan2(start.y_ - y, start.x_ - x);
+	for (int i = 1; i <= segments; i++) {
+		const auto a = begin + angle * i / segments;
+		const auto r = i < segments ? outer : radius;
+		contour.push_back({ x + r * std::cos(a), y + r * std::sin(a) });
+	}
+}
+
+void RasterEngine::AddCircle(std::vector<POINT>& contour, double x, double y, double r) const {
+	if (r <= 0.0) {
+		return;
+	}
+
+	const auto segments = std::max(Segments(r, 2.0 * kPi, Tolerance()), 4);
+	const auto outer = OuterRadius(r, 2.0 * kPi / segments);
+	for (int i = 0; i < segments; i++) {
+		const auto a = 2.0 * kPi * i / segments;
+		contour.push_back({ x + outer * std::cos(a), y + outer * std::sin(a) });
+	}
+}
+
+void RasterEngine::Fill(PATH path, FILL_RULE rule) {
+	OPERATION operation{ otFill, std::move(path), rule, nullptr, 0.0, 0.0 };
+	if (copy_level_) {
+		copy_operations_.push_back(std::move(operation));
+	}
+	else {
+		Execute(operation, dx_, dy_);
+	}
+}
+
+void RasterEngine::Execute(const OPERATION& operation, double dx, double dy) {
+	switch (operation.type_) {
+	case otFill:
+		FillNow(operation.path_, operation.rule_, dx, dy);
+		break;
+
+	case otFlash:
+		FlashNow(*operation.aperture_, operation.x_ + dx, operation.y_ + dy);
+		break;
+
+	case otDot:
+		DotNow(operation.x_ + dx, operation.y_ + dy);
+		break;
+	}
+}
+
+void RasterEngine::FillNow(const PATH& path, FILL_RULE rule, double dx, double dy) {
+	rasterizer_.Reset(width_, height_);
+	for (const auto& contour : path) {
+		if (contour.size() < 3) {
+			continue;
+		}
+
+		rasterizer_.MoveTo(DeviceX(contour.front().x_ + dx), DeviceY(contour.front().y_ + dy));
+		for (std::size_t i = 1; i < contour.size(); i++) {
+			rasterizer_.LineTo(DeviceX(contour[i].x_ + dx), DeviceY(contour[i].y_ + dy));
+		}
+	}
+
+	if (format_ == rfBinary) {
+		BINARY_SINK sink{ pixels_.data(), stride_, negative_ };
+		rasterizer_.Render(rule, sink);
+	}
+	else {
+		COVERAGE_SINK sink{ pixels_.data(), width_, negative_ };
+		rasterizer_.Render(rule, sink);
+	}
+}
+
+const std::vector<std::uint8_t>& RasterEngine::Mask(APERTURE& aperture, int phase_x, int phase_y) {
+	auto& mask = aperture.masks_[phase_y * 4 + phase_x];
+	if (!mask.empty()) {
+		return mask;
+	}
+
+	mask.assign(static_cast<std::size_t>(aperture.mask_width_) * aperture.mask_height_, 0);
+	const auto offset_x = phase_x / 4.0 - aperture.mask_x_;
+	const auto offset_y = phase_y / 4.0 - aperture.mask_y_;
+
+	for (const auto& object : aperture.objects_) {
+		rasterizer_.Reset(aperture.mask_width_, aperture.mask_height_);
+		for (const auto& contour : object.path_) {
+			if (contour.size() < 3) {
+				continue;
+			}
+
+			rasterizer_.MoveTo(offset_x + contour.front().x_ / scale_, offset_y - contour.front().y_ / scale_);
+			for (std::size_t i = 1; i < contour.size(); i++) {
+				rasterizer_.LineTo(offset_x + contour[i].x_ / scale_, offset_y - contour[i].y_ / scale_);
+			}
+		}
+
+		COVERAGE_SINK sink{ mask.data(), aperture.mask_width_, object.erase_ };
+		rasterizer_.Render(frEvenOdd, sink);
+	}
+
+	return mask;
+}
+
+void RasterEngine::FlashNow(APERTURE& aperture, double x, double y) {
+	// To the nearest quarter pixel, which a mask is made for
+	const auto device_x = std::round(DeviceX(x) * 4.0);
+	const auto device_y = std::round(DeviceY(y) * 4.0);
+	if (!std::isfinite(device_x) || !std::isfinite(device_y)) {
+		return;
+	}
+
+	const auto pixel_x = static_cast<long long>(std::floor(device_x / 4.0));
+	const auto pixel_y = static_cast<long long>(std::floor(device_y / 4.0));
+	const auto left = pixel_x + aperture.mask_x_;
+	const auto top = pixel_y + aperture.mask_y_;
+
+	const auto first_x = std::max<long long>(left, 0);
+	const auto last_x = std::min<long long>(left + aperture.mask_width_, width_);
+	const auto first_y = std::max<long long>(top, 0);
+	const auto last_y = std::min<long long>(top + aperture.mask_height_, height_);
+	if (first_x >= last_x || first_y >= last_y) {
+		return;
+	}
+
+	const auto& mask = Mask(
+		aperture,
+		static_cast<int>(device_x - pixel_x * 4.0),
+		static_cast<int>(device_y - pixel_y * 4.0)
+	);
+
+	for (auto row = first_y; row < last_y; row++) {
+		const auto coverage = mask.data() + (row - top) * aperture.mask_width_ + (first_x - left);
+		const auto count = static_cast<int>(last_x - first_x);
+		if (format_ == rfBinary) {
+			SetCovered(pixels_.data() + row * stride_, static_cast<int>(first_x), coverage, count, !negative_);
+		}
+		else {
+			BlendSpan(pixels_.data() + row * stride_ + first_x, coverage, count, negative_);
+		}
+	}
+}
+
+void RasterEngine::DotNow(double x, double y) {
+	const auto device_x = std::floor(DeviceX(x));
+	const auto device_y = std::floor(DeviceY(y));
+	if (device_x < 0.0 || device_x >= width_ || device_y < 0.0 || device_y >= height_) {
+		return;
+	}
+
+	const auto row = pixels_.data() + static_cast<std::size_t>(device_y) * stride_;
+	if (format_ == rfBinary) {
+		SetBits(row, static_cast<int>(device_x), 1, !negative_);
+	}
+	else {
+		row[static_cast<std::size_t>(device_x)] = negative_ ? 0 : 255;
+	}
+}
+
+void RasterEngine::BeginRender() {
+	std::fill(pixels_.begin(), pixels_.end(), 0);
+	path_.clear();
+	copy_level_ = false;
+	copy_operations_.clear();
+	dx_ = dy_ = 0.0;
+}
+
+void RasterEngine::EndRender() {
+}
+
+void RasterEngine::BeginDraw(bool negative) {
+	negative_ = negative;
+}
+
+void RasterEngine::EndDraw() {
+}
+
+void RasterEngine::BeginOutline() {
+	path_.clear();
+}
+
+void RasterEngine::EndOutline() {
+	Fill(std::move(path_), frEvenOdd);
+	path_.clear();
+}
+
+void RasterEngine::FillEvenOdd() {
+}
+
+void RasterEngine::Stroke() {
+	// Every segment with its round ends as a polygon of the same orientation,
+	// so that together they fill with the non-zero rule. Hairlines are a pixel.
+	const auto radius = (line_width_ > 0.0 ? line_width_ : scale_) / 2.0;
+
+	PATH stroke;
+	for (const auto& line : path_) {
+		auto dot = !line.empty();
+		for (std::size_t i = 1; i < line.size(); i++) {
+			const auto& a = line[i - 1];
+			const auto& b = line[i];
+			const auto length = std::hypot(b.x_ - a.x_, b.y_ - a.y_);
+			if (length <= 0.0) {
+				continue;
+			}
+
+			const auto normal_x = (a.y_ - b.y_) / length * radius;
+			const auto normal_y = (b.x_ - a.x_) / length * radius;
+
+			stroke.push_back({ { a.x_ - normal_x, a.y_ - normal_y }, { b.x_ - normal_x, b.y_ - normal_y } });
+			auto& contour = stroke.back();
+			AddArc(contour, b.x_, b.y_, 180.0);
+			contour.push_back({ a.x_ + normal_x, a.y_ + normal_y });
+			AddArc(contour, a.x_, a.y_, 180.0);
+			contour.pop_back();
+			dot = false;
+		}
+
+		if (dot) {
+			stroke.emplace_back();
+			AddCircle(stroke.back(), line.front().x_, line.front().y_, radius);
+		}
+	}
+
+	path_.clear();
+	Fill(std::move(stroke), frNonZero);
+}
+
+void RasterEngine::Close() {
+}
+
+void RasterEngine::DrawArc(double x, double y, double degree) {
+	if (path_.empty() || path_.back().empty()) {
+		return;
+	}
+
+	AddArc(path_.back(), x, y, degree);
+}
+
+void RasterEngine::DrawLine(double x, double y) {
+	if (path_.empty()) {
+		path_.emplace_back();
+	}
+
+	path_.back().push_back({ x, y });
+}
+
+void RasterEngine::BeginSolidCircleLine(double x, double y, double line_width) {
+	line_width_ = line_width;
+	BeginLine(x, y);
+}
+
+void RasterEngine::BeginLine(double x, double y) {
+	path_.push_back({ { x, y } });
+}
+
+void RasterEngine::DrawCircle(double x, double y, double r) {
+	path_.emplace_back();
+	AddCircle(path_.back(), x, y, r);
+}
+
+void RasterEngine::DrawRectangle(double x, double y, double w, double h) {
+	path_.push_back({ { x, y }, { x + w, y }, { x + w, y + h }, { x, y + h } });
+}
+
+void RasterEngine::DrawRectLine(double x1, double y1, double x2, double y2, double w, double h) {
+	w /= 2.0;
+	h /= 2.0;
+
+	// The hull of the rectangle at both ends
+	std::vector<POINT> corners{
+		{ x1 - w, y1 - h }, { x1 + w, y1 - h }, { x1 + w, y1 + h }, { x1 - w, y1 + h },
+		{ x2 - w, y2 - h }, { x2 + w, y2 - h }, { x2 + w, y2 + h }, { x2 - w, y2 + h }
+	};
+	std::sort(corners.begin(), corners.end(), [](const POINT& a, const POINT& b) {
+		return a.x_ < b.x_ || (a.x_ == b.x_ && a.y_ < b.y_);
+	});
+
+	auto turn = [](const POINT& o, const POINT& a, const POINT& b) {
+		return (a.x_ - o.x_) * (b.y_ - o.y_) - (a.y_ - o.y_) * (b.x_ - o.x_);
+	};
+
+	std::vector<POINT> hull;
+	for (int pass = 0; pass < 2; pass++) {
+		const auto start = hull.size();
+		for (const auto& corner : corners) {
+			while (hull.size() >= start + 2 && turn(hull[hull.size() - 2], hull.back(), corner) <= 0.0) {
+				hull.pop_back();
+			}
+			hull.push_back(corner);
+		}
+		hull.pop_back();
+		std::reverse(corners.begin(), corners.end());
+	}
+
+	Fill({ hull }, frNonZero);
+}
+
+void RasterEngine::ApertureErase(double /*left*/, double /*bottom*/, double /*top*/, double /*right*/) {
+	new_aperture_.objects_.push_back({ std::move(path_), true });
+	path_.clear();
+}
+
+void RasterEngine::ApertureFill() {
+	new_aperture_.objects_.push_back({ std::move(path_), false });
+	path_.clear();
+}
+
+void RasterEngine::ApertureStroke() {
+	ApertureFill();
+}
+
+void RasterEngine::ApertureClose() {
+}
+
+void RasterEngine::DrawApertureArc(double x, double y, double angle) {
+	DrawArc(x, y, angle);
+}
+
+void RasterEngine::DrawApertureLine(double x, double y) {
+	DrawLine(x, y);
+}
+
+void RasterEngine::BeginApertureLine(double x, double y) {
+	BeginLine(x, y);
+}
+
+void RasterEngine::DrawAperatureCircle(double x, double y, double w) {
+	DrawCircle(x, y, w / 2.0);
+}
+
+void RasterEngine::DrawApertureRect(double x, double y, double w, double h) {
+	DrawRectangle(x, y, w, h);
+}
+
+void RasterEngine::EndDrawAperture() {
+	// The objects came last first
+	std::reverse(new_aperture_.objects_.begin(), new_aperture_.objects_.end());
+}
+
+void RasterEngine::PrepareDrawAperture() {
+	new_aperture_.objects_.clear();
+	path_.clear();
+}
+
+void RasterEngine::PrepareCopyLayer(double /*left*/, double /*bottom*/, double /*right*/, double /*top*/) {
+	copy_level_ = true;
+	copy_operations_.clear();
+	path_.clear();
+}
+
+void RasterEngine::CopyLayer(int count_x, int count_y, double step_x, double step_y) {
+	for (int y = 0; y < count_y; ++y) {
+		for (int x = 0; x < count_x; ++x) {
+			for (const auto& operation : copy_operations_) {
+				Execute(operation, x * step_x, y * step_y);
+			}
+		}
+	}
+
+	copy_level_ = false;
+	copy_operations_.clear();
+}
+
+void RasterEngine::Prepare2Render() {
+	copy_level_ = false;
+	copy_operations_.clear();
+}
+
+void RasterEngine::Translate(double x, double y) {
+	dx_ = x;
+	dy_ = y;
+}
+
+bool RasterEngine::PrepareExistAperture(int code) {
+	auto aperture = apertures_.find(code);
+	if (aperture == apertures_.end()) {
+		return false;
+	}
+
+	aperture_ = &aperture->second;
+	return true;
+}
+
+int RasterEngine::Flash(double x, double y) {
+	if (!aperture_) {
+		return 0;
+	}
+
+	if (copy_level_) {
+		copy_operations_.push_back({ otFlash, {}, frEvenOdd, aperture_, x, y });
+	}
+	else {
+		FlashNow(*aperture_, x + dx_, y + dy_);
+	}
+	return 0;
+}
+
+void RasterEngine::EndDrawNewAperture(int code) {
+	auto& aperture = apertures_[code];
+	aperture = std::move(new_aperture_);
+	aperture_ = &aperture;
+
+	new_aperture_ = APERTURE();
+}
+
+void RasterEngine::NewAperture(double left, double bottom, double right, double top) {
+	// A pixel of margin for the quarter pixel phases and rounding
+	new_aperture_ = APERTURE();
+	new_aperture_.mask_x_ = static_cast<int>(std::floor(left / scale_)) - 1;
+	new_aperture_.mask_y_ = static_cast<int>(std::floor(-top / scale_)) - 1;
+	new_aperture_.mask_width_ = std::max(static_cast<int>(std::ceil(right / scale_)) + 2 - new_aperture_.mask_x_, 1);
+	new_aperture_.mask_height_ = std::max(static_cast<int>(std::ceil(-bottom / scale_)) + 2 - new_aperture_.mask_y_, 1);
+
+	path_.clear();
+}
+
+void RasterEngine::DrawDot(double x, double y) {
+	if (copy_level_) {
+		copy_operations_.push_back({ otDot, {}, frEvenOdd, nullptr, x, y });
+	}
+	else {
+		DotNow(x + dx_, y + dy_);
+	}
+}
+
+double RasterEngine::PixelSize() const {
+	return scale_;
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "engine.h"
+#include "scanline_rasterizer.h"
+
+
+enum RASTER_FORMAT {
+	rfCoverage, // A byte per pixel, 0 blank to 255 fully covered
+	rfBinary    // A bit per pixel, set when at least half covered
+};
+
+// Renders into a plain buffer with its own scanline rasterizer, so it needs
+// neither Qt nor a QApplication. Negative levels clear what is below them.
+//
+// Binary buffers are packed 8 pixels to a byte, the leftmost in the highest
+// bit, as PBM and 1-bit BMP and TIFF images store them. They are not
+// anti-aliased and take an eighth of the memory.
+//
+// Paths and strokes are filled with analytic anti-aliasing. Strokes have
+// round caps and joins, apertures are rasterised once for each quarter
+// pixel position they are flashed at, and step and repeat levels are
+// replayed for every copy.
+class RasterEngine : public Engine {
+public:
+	// The bound box is centred on the image and keeps its aspect ratio.
+	RasterEngine(int width, int height, const BoundBox& bound_box, RASTER_FORMAT format = rfCoverage);
+
+	int Width() const;
+	int Height() const;
+	RASTER_FORMAT Format() const;
+	// Bytes per row
+	std::size_t Stride() const;
+	// Stride bytes per row, top row first
+	const std::vector<std::uint8_t>& Pixels() const;
+
+	// Covered pixels of a row, at least half covered for rfCoverage
+	struct RUN {
+		int x_;
+		int length_;
+	};
+	void Runs(int y, std::vector<RUN>& runs) const;
+
+	// Binary PBM (P4) for rfBinary, PGM (P5) otherwise. Both show covered
+	// pixels black, so coverage is inverted in the PGM.
+	bool SavePnm(const std::string& file_name) const;
+	// Run length encoding of the covered pixels, all numbers little endian
+	// 32-bit: width, height, then for every row from the top the number of
+	// runs followed by the x and length of each.
+	bool SaveRuns(const std::string& file_name) const;
+
+protected:
+	void BeginRender() override;
+	void EndRender() override;
+	void BeginDraw(bool negative) override;
+	void EndDraw() override;
+	void BeginOutline() override;
+	void EndOutline() override;
+	void FillEvenOdd() override;
+	void Stroke() override;
+	void Close() override;
+	void DrawArc(double x, double y, double degree) override;
+	void DrawLine(double x, double y) override;
+	void BeginSolidCircleLine(double x, double y, double line_width) override;
+	void BeginLine(double x, double y) override;
+	void DrawCircle(double x, double y, double r) override;
+	void DrawRectangle(double x, double y, double w, double h) override;
+	void DrawRectLine(
+		double x1, double y1, // Start
+		double x2, double y2, // End
+		double w, double h   // Rect Width; Height
+	) override;
+	void ApertureErase(double left, double bottom, double top, double right) override;
+	void ApertureFill() override;
+	void ApertureStroke() override;
+	void ApertureClose() override;
+	void DrawApertureArc(double x, double y, double angle) override;
+	void DrawApertureLine(double x, double y) override;
+	void BeginApertureLine(double x, double y) override;
+	void DrawAperatureCircle(double x, double y, double w) override;
+	void DrawApertureRect(double x, double y, double w, double h) override;
+	void EndDrawAperture() override;
+	void PrepareDrawAperture() override;
+	void PrepareCopyLayer(double left, double bottom, double right, double top) override;
+	void CopyLayer(int count_x, int count_y, double step_x, double step_y) override;
+	void Prepare2Render() override;
+	void Translate(double x, double y) override;
+	bool PrepareExistAperture(int code) override;
+	int Flash(double x, double y) override;
+	void EndDrawNewAperture(int code) override;
+	void NewAperture(double left, double bottom, double right, double top) override;
+	void DrawDot(double x, double y) override;
+	double PixelSize() const override;
+
+private:
+	struct POINT {
+		double x_;
+		double y_;
+	};
+	// Contours in mm
+	using PATH = std::vector<std::vector<POINT>>;
+
+	// Filled or, for exposure off, erased, in the order of the aperture
+	struct OBJECT {
+		PATH path_;
+		bool erase_;
+	};
+
+	struct APERTURE {
+		std::vector<OBJECT> objects_;
+
+		// Pixels of the masks relative to the flash position
+		int mask_x_;
+		int mask_y_;
+		int mask_width_;
+		int mask_height_;
+		// Coverage for each quarter pixel phase, made when first flashed
+		std::array<std::vector<std::uint8_t>, 16> masks_;
+	};
+
+	enum OPERATION_TYPE {
+		otFill,
+		otFlash,
+		otDot
+	};
+
+	// What a step and repeat level drew, to do again for every copy
+	struct OPERATION {
+		OPERATION_TYPE type_;
+		PATH path_;
+		FILL_RULE rule_;
+		APERTURE* aperture_;
+		double x_;
+		double y_;
+	};
+
+	double DeviceX(double x) const;
+	double DeviceY(double y) const;
+	// Largest distance in mm between a curve and its segments
+	double Tolerance() const;
+
+	void AddArc(std::vector<POINT>& contour, double x, double y, double degree) const;
+	void AddCircle(std::vector<POINT>& contour, double x, double y, double r) const;
+
+	// Draws now, or for every copy of a step and repeat level
+	void Fill(PATH path, FILL_RULE rule);
+	void Execute(const OPERATION& operation, double dx, double dy);
+	void FillNow(const PATH& path, FILL_RULE rule, double dx, double dy);
+	void FlashNow(APERTURE& aperture, double x, double y);
+	void DotNow(double x, double y);
+
+	const std::vector<std::uint8_t>& Mask(APERTURE& aperture, int phase_x, int phase_y);
+
+	int width_;
+	int height_;
+	RASTER_FORMAT format_;
+	std::size_t stride_;
+	std::vector<std::uint8_t> pixels_;
+
+	// mm per pixel, and the mm at the top left corner of the image
+	double scale_;
+	double left_;
+	double top_;
+
+	ScanlineRasterizer rasterizer_;
+
+	PATH path_;
+	double line_width_{ 0.0 };
+	bool negative_{ false };
+
+	APERTURE new_aperture_;
+	APERTURE* aperture_{ nullptr };
+	std::map<int, APERTURE> apertures_;
+
+	bool copy_level_{ false };
+	std::vector<OPERATION> copy_operations_;
+
+	// Of everything drawn now, see Translate
+	double dx_{ 0.0 };
+	double dy_{ 0.0 };
+};
@@ -0,0 +1,139 @@
+#include "scanline_rasterizer.h"
+
+
+void ScanlineRasterizer::Reset(int width, int height) {
+	width_ = std::max(width, 0);
+	height_ = std::max(height, 0);
+	open_ = false;
+	edges_.clear();
+
+	if (cells_.size() != static_cast<std::size_t>(width_) + 2) {
+		cells_.assign(width_ + 2, 0.0f);
+		coverage_.resize(width_ + 2);
+	}
+}
+
+void ScanlineRasterizer::MoveTo(double x, double y) {
+	Close();
+	start_x_ = x_ = x;
+	start_y_ = y_ = y;
+	open_ = true;
+}
+
+void ScanlineRasterizer::LineTo(double x, double y) {
+	if (!open_) {
+		MoveTo(x, y);
+		return;
+	}
+
+	AddLine(x_, y_, x, y);
+	x_ = x;
+	y_ = y;
+}
+
+void ScanlineRasterizer::Close() {
+	if (open_) {
+		AddLine(x_, y_, start_x_, start_y_);
+		x_ = start_x_;
+		y_ = start_y_;
+		open_ = false;
+	}
+}
+
+bool ScanlineRasterizer::Empty() const {
+	return edges_.empty();
+}
+
+void ScanlineRasterizer::AddLine(double x0, double y0, double x1, double y1) {
+	if (y0 == y1 || !std::isfinite(x0) || !std::isfinite(x1) || !std::isfinite(y0) || !std::isfinite(y1)) {
+		return;
+	}
+
+	if (std::max(y0, y1) <= 0.0 || std::min(y0, y1) >= height_) {
+		return;
+	}
+
+	// Split where the edge crosses a side, so that the outer part can run
+	// along the side instead.
+	for (double side : { 0.0, static_cast<double>(width_) }) {
+		if ((x0 < side && x1 > side) || (x0 > side && x1 < side)) {
+			const auto y = y0 + (side - x0) / (x1 - x0) * (y1 - y0);
+			AddLine(x0, y0, side, y);
+			AddLine(side, y, x1, y1);
+			return;
+		}
+	}
+
+	x0 = std::min(std::max(x0, 0.0), static_cast<double>(width_));
+	x1 = std::min(std::max(x1, 0.0), static_cast<double>(width_));
+
+	EDGE edge;
+	if (y0 < y1) {
+		edge = { x0, y0, x1, y1, 0.0, 1.0f };
+	}
+	else {
+		edge = { x1, y1, x0, y0, 0.0, -1.0f };
+	}
+	edge.dxdy_ = (edge.x1_ - edge.x0_) / (edge.y1_ - edge.y0_);
+	edges_.push_back(edge);
+}
+
+void ScanlineRasterizer::Accumulate(double x0, double x1, float dy) {
+	const auto left = std::min(x0, x1);
+	const auto right = std::max(x0, x1);
+	const auto first = static_cast<int>(std::floor(left));
+	const auto last = static_cast<int>(std::ceil(right));
+
+	if (last <= first + 1) {
+		// Within a single cell; the rest of the height carries to the next
+		const auto middle = static_cast<float>((x0 + x1) / 2.0 - first);
+		cells_[first] += dy * (1.0f - middle);
+		cells_[first + 1] += dy * middle;
+		ranges_.emplace_back(first, first + 1);
+		return;
+	}
+
+	// Across several cells: the area left of the edge in each of them
+	const auto slope = static_cast<float>(1.0 / (right - left));
+	const auto first_part = static_cast<float>(left - first);
+	const auto first_area = 0.5f * slope * (1.0f - first_part) * (1.0f - first_part);
+	const auto last_part = static_cast<float>(right - last + 1);
+	const auto last_area = 0.5f * slope * last_part * last_part;
+
+	cells_[first] += dy * first_area;
+	if (last == first + 2) {
+		cells_[first + 1] += dy * (1.0f - first_area - last_area);
+	}
+	else {
+		const auto second_area = slope * (1.5f - first_part);
+		cells_[first + 1] += dy * (second_area - first_area);
+		for (auto cell = first + 2; cell < last - 1; cell++) {
+			cells_[cell] += dy * slope;
+		}
+		const auto area = second_area + (last - first - 3) * slope;
+		cells_[last - 1] += dy * (1.0f - area - last_area);
+	}
+	cells_[last] += dy * last_area;
+	ranges_.emplace_back(first, last);
+}
+
+void ScanlineRasterizer::Sort() {
+	std::sort(edges_.begin(), edges_.end(), [](const EDGE& a, const EDGE& b) {
+		return a.y0_ < b.y0_;
+	});
+}
+
+std::uint8_t ScanlineRasterizer::Coverage(float area, FILL_RULE rule) {
+	area = std::fabs(area);
+	if (rule == frEvenOdd) {
+		area = std::fmod(area, 2.0f);
+		if (area > 1.0f) {
+			area = 2.0f - area;
+		}
+	}
+	else if (area > 1.0f) {
+		area = 1.0f;
+	}
+
+	return static_cast<std::uint8_t>(area * 255.0f + 0.5f);
+}
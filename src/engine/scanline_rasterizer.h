@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+enum FILL_RULE {
+	frNonZero,
+	frEvenOdd
+};
+
+// Polygon scan conversion with exact area coverage. Edges are kept in an
+// active edge table sorted by their top; for every scanline the signed area
+// and cover of the active edges are accumulated into the cells they cross
+// and summed from left to right. Between the cells of two edges the
+// coverage stays the same and goes out as a single span.
+//
+// Coordinates are device pixels, y down. Edges are clipped to the size
+// given to Reset; what is left or right of it counts as the border.
+class ScanlineRasterizer {
+public:
+	// Drops all edges; later ones are clipped to width x height pixels.
+	void Reset(int width, int height);
+
+	void MoveTo(double x, double y);
+	void LineTo(double x, double y);
+	// Joins the current contour to its start, also done by MoveTo and Render
+	void Close();
+
+	bool Empty() const;
+
+	// Calls sink.Cells(y, x, coverage, count) for the cells touched by edges
+	// and sink.Span(y, x, count, coverage) for the runs between them, row by
+	// row from the top. Coverage is 0-255 and runs of 0 are left out.
+	template <class SINK>
+	void Render(FILL_RULE rule, SINK& sink);
+
+private:
+	struct EDGE {
+		double x0_;
+		double y0_;
+		double x1_;
+		double y1_;
+		double dxdy_;
+		// +1 going down, -1 going up
+		float direction_;
+	};
+
+	void AddLine(double x0, double y0, double x1, double y1);
+	// Accumulates the part of an edge in a row, from x0 to x1 with the
+	// signed height dy, and notes the cells it wrote to.
+	void Accumulate(double x0, double x1, float dy);
+	// Prepares the active edge table
+	void Sort();
+
+	static std::uint8_t Coverage(float area, FILL_RULE rule);
+
+	int width_{ 0 };
+	int height_{ 0 };
+
+	double start_x_{ 0.0 };
+	double start_y_{ 0.0 };
+	double x_{ 0.0 };
+	double y_{ 0.0 };
+	bool open_{ false };
+
+	std::vector<EDGE> edges_;
+	std::vector<std::uint32_t> active_;
+	// Inclusive cell ranges written in the current row
+	std::vector<std::pair<int, int>> ranges_;
+	// width + 2 cells, zero outside of Render
+	std::vector<float> cells_;
+	std::vector<std::uint8_t> coverage_;
+};
+
+
+template <class SINK>
+void ScanlineRasterizer::Render(FILL_RULE rule, SINK& sink) {
+	Close();
+	if (edges_.empty()) {
+		return;
+	}
+
+	Sort();
+
+	double lowest = 0.0;
+	for (const auto& edge : edges_) {
+		lowest = std::max(lowest, edge.y1_);
+	}
+
+	const auto end = std::min(height_, static_cast<int>(std::ceil(lowest)));
+	std::size_t next = 0;
+	active_.clear();
+
+	for (auto row = std::max(0, static_cast<int>(std::floor(edges_.front().y0_))); row < end; row++) {
+		while (next < edges_.size() && edges_[next].y0_ < row + 1) {
+			active_.push_back(static_cast<std::uint32_t>(next++));
+		}
+		active_.erase(std::remove_if(active_.begin(), active_.end(), [&](std::uint32_t index) {
+			return edges_[index].y1_ <= row;
+		}), active_.end());
+
+		if (active_.empty()) {
+			if (next == edges_.size()) {
+				break;
+			}
+
+			// Straight to the row of the next edge
+			row = std::max(row, static_cast<int>(std::floor(edges_[next].y0_))) - 1;
+			continue;
+		}
+
+		ranges_.clear();
+		for (auto index : active_) {
+			const auto& edge = edges_[index];
+			const auto top = std::max<double>(row, edge.y0_);
+			const auto bottom = std::min<double>(row + 1, edge.y1_);
+			if (bottom <= top) {
+				continue;
+			}
+
+			Accumulate(
+				edge.x0_ + (top - edge.y0_) * edge.dxdy_,
+				edge.x0_ + (bottom - edge.y0_) * edge.dxdy_,
+				static_cast<float>(bottom - top) * edge.direction_
+			);
+		}
+
+		std::sort(ranges_.begin(), ranges_.end());
+
+		float area = 0.0f;
+		int x = 0;
+		for (std::size_t i = 0; i < ranges_.size();) {
+			auto first = ranges_[i].first;
+			auto last = ranges_[i].second;
+			for (i++; i < ranges_.size() && ranges_[i].first <= last + 1; i++) {
+				last = std::max(last, ranges_[i].second);
+			}
+
+			// Nothing but whole pixels since the last edge
+			first = std::max(first, x);
+			if (first > x && x < width_) {
+				const auto coverage = Coverage(area, rule);
+				if (coverage) {
+					sink.Span(row, x, std::min(first, width_) - x, coverage);
+				}
+			}
+
+			for (auto cell = first; cell <= last; cell++) {
+				area += cells_[cell];
+				cells_[cell] = 0.0f;
+				coverage_[cell - first] = Coverage(area, rule);
+			}
+
+			const auto count = std::min(last + 1, width_) - first;
+			if (count > 0) {
+				sink.Cells(row, first, coverage_.data(), count);
+			}
+			x = last + 1;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#include "chunk_reader.h"
+#include <algorithm>
+#include <cstring>
+
+
+StreamChunkReader::StreamChunkReader(std::istream& stream) :
+	stream_(stream)
+{
+}
+
+StreamChunkReader::StreamChunkReader(std::unique_ptr<std::istream> stream) :
+	owned_stream_(std::move(stream)),
+	stream_(*owned_stream_)
+{
+}
+
+std::size_t StreamChunkReader::Read(char* buffer, std::size_t size)
+{
+	if (!stream_) {
+		return 0;
+	}
+
+	stream_.read(buffer, size);
+	return static_cast<std::size_t>(stream_.gcount());
+}
+
+MemoryChunkReader::MemoryChunkReader(const char* data, std::size_t size) :
+	data_(data),
+	size_(size)
+{
+}
+
+std::size_t MemoryChunkReader::Read(char* buffer, std::size_t size)
+{
+	auto count = std::min(size, size_ - index_);
+	std::memcpy(buffer, data_ + index_, count);
+	index_ += count;
+	return count;
+}
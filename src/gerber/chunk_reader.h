@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <memory>
+
+
+// Source of Gerber text for the streaming load mode.
+class ChunkReader {
+public:
+	virtual ~ChunkReader() = default;
+
+	// Copies up to size bytes into buffer and returns how many were copied.
+	// Returns 0 once the input is exhausted.
+	virtual std::size_t Read(char* buffer, std::size_t size) = 0;
+};
+
+
+class StreamChunkReader : public ChunkReader {
+public:
+	StreamChunkReader(std::istream& stream);
+	StreamChunkReader(std::unique_ptr<std::istream> stream);
+
+	std::size_t Read(char* buffer, std::size_t size) override;
+
+private:
+	std::unique_ptr<std::istream> owned_stream_;
+	std::istream& stream_;
+};
+
+
+// Reads from memory owned by someone else, e.g. a member of a mapped archive.
+class MemoryChunkReader : public ChunkReader {
+public:
+	MemoryChunkReader(const char* data, std::size_t size);
+
+	std::size_t Read(char* buffer, std::size_t size) override;
+
+private:
+	const char* data_;
+	std::size_t size_;
+	std::size_t index_{ 0 };
+};
@@ -1,25 +1,85 @@
 #include "gerber.h"
-#include "parser/xcode_parser.h"
-#include "parser/ycode_parser.h"
-#include "parser/icode_parser.h"
-#include "parser/jcode_parser.h"
-#include "parser/star_parser.h"
 #include "parser/gcode_parser.h"
 #include "parser/dcode_parser.h"
-#include "parser/ncode_parser.h"
 #include "parser/mcode_parser.h"
 #include "parser/parameter_parser.h"
+#include "thread_pool.h"
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <future>
+#include <thread>
 
 
 bool gerber_warnings = true;
 
-Gerber::Gerber(const std::string& file_name) : file_name_(file_name) {
-	gerber_file_.buffer_.clear();
-	gerber_file_.index_ = 0;
+Gerber::Gerber(const std::string& file_name, GERBER_LOAD_MODE mode, unsigned threads) : file_name_(file_name) {
+	Reset();
 
+	if (gerber_file_.Load(file_name, mode)) {
+		LoadGerber(threads);
+	}
+}
+
+Gerber::Gerber() {
+	Reset();
+}
+
+std::shared_ptr<Gerber> Gerber::FromMemory(std::string_view text, unsigned threads) {
+	std::shared_ptr<Gerber> gerber(new Gerber());
+	if (gerber->gerber_file_.Load(text)) {
+		gerber->LoadGerber(threads);
+	}
+
+	return gerber;
+}
+
+std::shared_ptr<Gerber> Gerber::FromStream(std::istream& stream, GERBER_LOAD_MODE mode, unsigned threads) {
+	std::shared_ptr<Gerber> gerber(new Gerber());
+	if (gerber->gerber_file_.Load(stream, mode)) {
+		gerber->LoadGerber(threads);
+	}
+
+	return gerber;
+}
+
+std::shared_ptr<Gerber> Gerber::FromReader(std::unique_ptr<ChunkReader> reader, const std::string& file_name) {
+	std::shared_ptr<Gerber> gerber(new Gerber());
+	gerber->file_name_ = file_name;
+	if (reader && gerber->gerber_file_.Load(std::move(reader))) {
+		gerber->LoadGerber(1);
+	}
+
+	return gerber;
+}
+
+Gerber::Gerber(const Gerber& scan, const SPLIT& split) : file_name_(scan.file_name_) {
+	Reset();
+
+	pass_ = ppSegment;
+	gerber_file_.buffer_ = scan.gerber_file_.buffer_;
+	gerber_file_.index_ = split.offset_;
+	gerber_file_.quiet_ = true;
+
+	format_ = split.format_;
+	units_ = split.units_;
+	start_of_level_ = split.start_of_level_;
+
+	// Apertures can not be redefined, so the final table of the scan is
+	// valid for every block.
+	apertures_ = scan.apertures_;
+
+	if (split.level_) {
+		current_level_ = split.level_;
+		current_level_->plot_ = true;
+		levels_.push_back(current_level_);
+	}
+}
+
+Gerber::~Gerber() {
+}
+
+void Gerber::Reset() {
 	units_ = guInches;
 
 	format_.omit_trailing_zeroes_ = false;
@@ -28,31 +88,42 @@ Gerber::Gerber(const std::string& file_name) : file_name_(file_name) {
 	format_.YInteger = 6;
 	format_.YDecimal = 6;
 
-	current_level_ = 0;
-	apertures_.resize(1000);
-
-	parsers_['X'] = std::make_shared<XCodeParser>(*this);
-	parsers_['Y'] = std::make_shared<YCodeParser>(*this);
-	parsers_['I'] = std::make_shared<ICodeParser>(*this);
-	parsers_['J'] = std::make_shared<JCodeParser>(*this);
-	parsers_['D'] = std::make_shared<DCodeParser>(*this);
-	parsers_['G'] = std::make_shared<GCodeParser>(*this);
-	parsers_['N'] = std::make_shared<NCodeParser>(*this);
-	parsers_['M'] = std::make_shared<MCodeParser>(*this);
-	parsers_['*'] = std::make_shared<StarParser>(*this);
-	parsers_['0'] = std::make_shared<ParameterParser>(*this);
-
-	LoadGerber(file_name);
-}
+	name_.clear();
+	negative_ = false;
+	start_of_level_ = false;
 
+	current_level_ = 0;
+	levels_.clear();
+	apertures_.Clear();
 
-Gerber::~Gerber() {
+	tokenizer_ = std::make_shared<Tokenizer>(*this);
+	gcode_parser_ = std::make_shared<GCodeParser>(*this);
+	dcode_parser_ = std::make_shared<DCodeParser>(*this);
+	mcode_parser_ = std::make_shared<MCodeParser>(*this);
+	parameter_parser_ = std::make_shared<ParameterParser>(*this);
 }
 
 void Gerber::Add(std::shared_ptr<GerberLevel> level) {
+	level->plot_ = pass_ != ppScan;
+	level->store_commands_ = store_commands_;
+
 	if (current_level_) {
 		current_level_->exposure_ = geOff;
-		current_level_->Do(gerber_file_.line_number_);
+		current_level_->Do(gerber_file_);
+
+		switch (pass_) {
+		case ppScan:
+			split_pending_ = true;
+			break;
+
+		case ppSegment: // The next block belongs to another segment
+			segment_done_ = true;
+			current_level_ = level;
+			return;
+
+		default:
+			break;
+		}
 	}
 
 	levels_.push_back(level);
@@ -71,7 +142,7 @@ BoundBox Gerber::GetBBox() const {
 	}
 
 	BoundBox bound_box(1e3, -1e3, -1e3, 1e3);
-	std::for_each(levels_.begin(), levels_.end(), [&bound_box](std::shared_ptr<GerberLevel> level) {
+	std::for_each(levels_.begin(), levels_.end(), [&bound_box](const std::shared_ptr<const GerberLevel>& level) {
 		bound_box.UpdateBox(level->bound_box_.Left(), level->GetRight(), level->GetTop(), level->bound_box_.Bottom());
 	}
 	);
@@ -94,44 +165,199 @@ std::string Gerber::FileName() const
 	return file_name_;
 }
 
-std::vector<std::shared_ptr<GerberLevel>> Gerber::Levels() const
+const std::vector<std::shared_ptr<const GerberLevel>>& Gerber::Levels() const
 {
 	return levels_;
 }
 
+std::shared_ptr<GerberLevel> Gerber::Mutable(const std::shared_ptr<const GerberLevel>& level) {
+	return std::const_pointer_cast<GerberLevel>(level);
+}
+
+void Gerber::PackCommands() {
+	for (const auto& level : levels_) {
+		Mutable(level)->PackCommands(format_.XDecimal, format_.YDecimal, units_ == guInches);
+	}
+}
+
+void Gerber::ConvertStrokesToFills(unsigned threads) const {
+	std::call_once(fills_once_, [this, threads]() {
+		if (threads == 1 || levels_.size() < 2) {
+			for (const auto& level : levels_) {
+				level->Fills();
+			}
+			return;
+		}
+
+		ThreadPool pool(threads);
+
+		std::vector<std::future<void>> results;
+		for (const auto& level : levels_) {
+			results.push_back(pool.Submit([&level]() { level->Fills(); }));
+		}
+
+		for (auto& result : results) {
+			result.get();
+		}
+	});
+}
+
 bool Gerber::ParseGerber() {
-	while (!gerber_file_.EndOfFile()) {
-		gerber_file_.SkipWhiteSpace();
+	std::vector<GerberWord> words;
+	words.reserve(Tokenizer::kBatchSize);
 
-		auto parser = GetParser(gerber_file_.GetChar());
-		if (!parser->Run()) {
-			return false;
+	while (gerber_file_.Prefetch()) {
+		tokenizer_->Next(words);
+		if (words.empty()) {
+			break;
 		}
 
-		if (parser->EndOfFile()) {
-			return true;
+		for (const auto& word : words) {
+			// Diagnostics report the line the word came from.
+			gerber_file_.index_ = word.end_;
+
+			if (!Execute(word)) {
+				return false;
+			}
+
+			if (split_pending_) {
+				split_pending_ = false;
+				splits_.push_back({ gerber_file_.index_, format_, units_, start_of_level_, current_level_->CopyState() });
+			}
+
+			if (mcode_parser_->EndOfFile() || segment_done_) {
+				return true;
+			}
 		}
 	}
 
-	LOG(ERROR) << "Line " << gerber_file_.line_number_ << " - Error: No end-of-file code";
+	LOG_IF(ERROR, !gerber_file_.quiet_) << "Line " << gerber_file_.LineNumber() << " - Error: No end-of-file code";
 	return false;
 }
 
-std::shared_ptr<Parser> Gerber::GetParser(char code)
-{
-	if (parsers_.find(code) != parsers_.end()) {
-		return parsers_[code];
+bool Gerber::ParseGerberParallel(unsigned threads) {
+	auto start = gerber_file_.index_;
+	auto text = gerber_file_.buffer_;
+	if (text.find("%LP") == text.npos && text.find("%SR") == text.npos && text.find("%LN") == text.npos) {
+		return ParseGerber(); // A single level, nothing to split
+	}
+
+	pass_ = ppScan;
+	splits_.push_back({ start, format_, units_, start_of_level_, nullptr });
+	auto scanned = ParseGerber();
+	pass_ = ppSerial;
+
+	auto splits = std::move(splits_);
+	splits_.clear();
+
+	std::vector<std::shared_ptr<GerberLevel>> levels;
+	if (scanned && splits.size() > 1) {
+		ThreadPool pool(threads);
+
+		std::vector<std::future<std::shared_ptr<GerberLevel>>> results;
+		for (const auto& split : splits) {
+			results.push_back(pool.Submit([this, &split]() -> std::shared_ptr<GerberLevel> {
+				Gerber segment(*this, split);
+				if (!segment.ParseGerber() || segment.levels_.size() != 1) {
+					return nullptr;
+				}
+				return Mutable(segment.levels_.front());
+			}));
+		}
+
+		for (auto& result : results) {
+			levels.push_back(result.get());
+		}
+	}
+
+	if (levels.empty() || std::find(levels.begin(), levels.end(), nullptr) != levels.end()) {
+		// Parse again serially, so that the partial result is exactly the one
+		// of a serial parse. The scan has already reported every message.
+		Reset();
+		gerber_file_.index_ = start;
+		gerber_file_.quiet_ = true;
+		auto parsed = ParseGerber();
+		gerber_file_.quiet_ = false;
+		return parsed;
 	}
 
-	return parsers_['0'];
+	// Units, format, name, polarity and apertures are those left by the scan.
+	current_level_ = levels.back();
+	levels_.assign(levels.begin(), levels.end());
+	return true;
 }
 
-bool Gerber::LoadGerber(const std::string& file_name) {
-	start_of_level_ = false;
+bool Gerber::Execute(const GerberWord& word) {
+	if (!current_level_) {
+		switch (word.kind_) {
+		case gwX:
+		case gwY:
+		case gwI:
+		case gwJ:
+			Add(std::make_shared<GerberLevel>(nullptr, units_));
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	switch (word.kind_) {
+	case gwX:
+		current_level_->X = word.value_;
+		return true;
+
+	case gwY:
+		current_level_->Y = word.value_;
+		return true;
+
+	case gwI:
+		current_level_->I = word.value_;
+		return true;
+
+	case gwJ:
+		current_level_->J = word.value_;
+		return true;
+
+	case gwD:
+		return dcode_parser_->Run(word.code_);
+
+	case gwG:
+		return gcode_parser_->Run(word.code_);
+
+	case gwM:
+		return mcode_parser_->Run(word.code_);
 
-	if (!gerber_file_.Load(file_name)) {
+	case gwN:
+		start_of_level_ = false;
+		LOG_IF(ERROR, !gerber_file_.quiet_) << "Line " << gerber_file_.LineNumber() << " - Error: N Code not implemented";
+		return false;
+
+	case gwEndOfBlock:
+		if (current_level_) {
+			current_level_->Do(gerber_file_);
+		}
+		return true;
+
+	case gwParameter:
+		return parameter_parser_->Run();
+
+	default:
 		return false;
 	}
+}
+
+bool Gerber::LoadGerber(unsigned threads) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
 
-	return ParseGerber();
+	// Everything needed later has been copied out of the source text by now.
+	auto result = threads > 1 && !gerber_file_.Streamed() ? ParseGerberParallel(threads) : ParseGerber();
+	gerber_file_.Close();
+
+	for (const auto& level : levels_) {
+		Mutable(level)->BuildIndex();
+	}
+	return result;
 }
@@ -4,10 +4,13 @@
 #include <list>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #include "gerber_file.h"
+#include "parser/tokenizer.h"
 
 #include "gerber/gerber_aperture.h"
+#include "gerber/aperture_table.h"
 #include "gerber/gerber_level.h"
 #include "bound_box.h"
 
@@ -15,16 +18,9 @@
 extern bool gerber_warnings;
 
 
-class Parser;
-class XCodeParser;
-class YCodeParser;
-class ICodeParser;
-class JCodeParser;
 class GCodeParser;
 class DCodeParser;
-class NCodeParser;
 class MCodeParser;
-class StarParser;
 class ParameterParser;
 
 class Gerber {
@@ -49,29 +45,80 @@ private:
 	bool start_of_level_{ false };
 
 	bool negative_{ false };
-	std::vector<std::shared_ptr<GerberLevel>> levels_;
+	// Only the parser changes a level, everyone else sees it const.
+	std::vector<std::shared_ptr<const GerberLevel>> levels_;
+	mutable std::once_flag fills_once_;
+
+	static std::shared_ptr<GerberLevel> Mutable(const std::shared_ptr<const GerberLevel>& level);
+
+	// Parallel parsing: a serial pre-scan tracks only the modal state and
+	// records it wherever a new level starts. The blocks between those points
+	// are then parsed again concurrently, each into its own level.
+	enum PARSE_PASS {
+		ppSerial,
+		ppScan,
+		ppSegment
+	};
+
+	struct SPLIT {
+		std::size_t offset_;
+		FORMAT format_;
+		GERBER_UNIT units_;
+		bool start_of_level_;
+		std::shared_ptr<GerberLevel> level_; // State of the level the block continues
+	};
+
+	PARSE_PASS pass_{ ppSerial };
+	std::vector<SPLIT> splits_;
+	bool split_pending_{ false };
+	bool segment_done_{ false };
+
+	// False when only the metadata is gathered, see GerberSummary.
+	bool store_commands_{ true };
 
+	// Parser for the block of the scanned file that starts at split.
+	Gerber(const Gerber& scan, const SPLIT& split);
+	// Nothing loaded yet, used by the factories.
+	Gerber();
+
+	void Reset();
 	bool ParseGerber();
+	bool ParseGerberParallel(unsigned threads);
+	bool Execute(const GerberWord& word);
 	void Add(std::shared_ptr<GerberLevel> level);
-	bool LoadGerber(const std::string& file_name);
+	bool LoadGerber(unsigned threads);
+
+	ApertureTable apertures_;
 
-	std::shared_ptr<Parser> GetParser(char code);
-	std::vector<std::shared_ptr<GerberAperture>> apertures_;
-	std::map<char, std::shared_ptr<Parser>> parsers_;
+	std::shared_ptr<Tokenizer> tokenizer_;
+	std::shared_ptr<GCodeParser> gcode_parser_;
+	std::shared_ptr<DCodeParser> dcode_parser_;
+	std::shared_ptr<MCodeParser> mcode_parser_;
+	std::shared_ptr<ParameterParser> parameter_parser_;
 
+	friend class Tokenizer;
 	friend class GCodeParser;
-	friend class XCodeParser;
-	friend class YCodeParser;
-	friend class ICodeParser;
-	friend class JCodeParser;
 	friend class DCodeParser;
-	friend class NCodeParser;
 	friend class MCodeParser;
-	friend class StarParser;
 	friend class ParameterParser;
+	friend class GerberCache;
+	friend class GerberSummary;
 
 public:
-	Gerber(const std::string& file_name);
+	// By default the file is memory mapped and parsed in place; pass glBuffered
+	// to read it into memory instead, or glStreamed to parse multi-gigabyte
+	// files in bounded memory.
+	// threads > 1 parses the levels of the file concurrently, 0 uses all
+	// hardware threads. Streamed files are always parsed serially.
+	Gerber(const std::string& file_name, GERBER_LOAD_MODE mode = glMapped, unsigned threads = 1);
+	// Parses text in place, without copying it. It is no longer needed once
+	// the function returns.
+	static std::shared_ptr<Gerber> FromMemory(std::string_view text, unsigned threads = 1);
+	// Reads the whole stream first, or parses it while reading with glStreamed.
+	static std::shared_ptr<Gerber> FromStream(std::istream& stream, GERBER_LOAD_MODE mode = glBuffered, unsigned threads = 1);
+	// Parses the text of reader while reading it, e.g. a member of a ZipArchive.
+	// file_name is only used to name the result.
+	static std::shared_ptr<Gerber> FromReader(std::unique_ptr<ChunkReader> reader, const std::string& file_name = "");
 	~Gerber();
 
 	bool IsNegative() const;
@@ -80,5 +127,17 @@ public:
 	std::string Name() const;
 	std::string FileName() const;
 
-	std::vector<std::shared_ptr<GerberLevel>> Levels() const;
+	// Valid for the lifetime of the Gerber; copying it is left to the caller.
+	const std::vector<std::shared_ptr<const GerberLevel>>& Levels() const;
+
+	// Keeps the render commands of every level delta-coded in the resolution
+	// of the file, typically a quarter of the memory or less. They decode
+	// exactly while iterating; random access gets slower. Call it before
+	// rendering: after loading, everything else only reads the Gerber.
+	void PackCommands();
+
+	// Computes GerberLevel::Fills of every level ahead of rendering, once.
+	// Levels are independent, so threads > 1 converts them concurrently, 0
+	// uses all hardware threads.
+	void ConvertStrokesToFills(unsigned threads = 0) const;
 };
@@ -0,0 +1,106 @@
+#include "aperture_table.h"
+#include "gerber_aperture.h"
+
+#include <algorithm>
+
+
+namespace {
+
+constexpr std::size_t kMinimumSlots = 64;
+
+const std::shared_ptr<GerberAperture> kNoAperture;
+
+}
+
+bool ApertureTable::Add(std::shared_ptr<GerberAperture> aperture)
+{
+	if (Find(aperture->code_)) {
+		return false;
+	}
+
+	if ((apertures_.size() + 1) * 2 > slots_.size()) {
+		Grow();
+	}
+
+	auto& slot = slots_[Slot(aperture->code_)];
+	slot.code_ = aperture->code_;
+	slot.index_ = static_cast<std::int32_t>(apertures_.size());
+	apertures_.push_back(std::move(aperture));
+	return true;
+}
+
+const std::shared_ptr<GerberAperture>& ApertureTable::Find(int code) const
+{
+	if (slots_.empty()) {
+		return kNoAperture;
+	}
+
+	const auto& slot = slots_[Slot(code)];
+	return slot.index_ < 0 ? kNoAperture : apertures_[slot.index_];
+}
+
+void ApertureTable::Clear()
+{
+	apertures_.clear();
+	slots_.clear();
+	shift_ = 32;
+}
+
+std::size_t ApertureTable::Size() const
+{
+	return apertures_.size();
+}
+
+std::vector<std::shared_ptr<GerberAperture>>::const_iterator ApertureTable::begin() const
+{
+	return apertures_.begin();
+}
+
+std::vector<std::shared_ptr<GerberAperture>>::const_iterator ApertureTable::end() const
+{
+	return apertures_.end();
+}
+
+std::size_t ApertureTable::Probes(int code) const
+{
+	if (slots_.empty()) {
+		return 0;
+	}
+
+	return ((Slot(code) - Home(code)) & (slots_.size() - 1)) + 1;
+}
+
+std::size_t ApertureTable::Home(int code) const
+{
+	// Fibonacci hashing: the high bits of the product depend on all bits of
+	// the code, so strided codes spread as well as consecutive ones. The low
+	// bits would only depend on the low bits of the code.
+	return static_cast<std::size_t>((static_cast<std::uint32_t>(code) * 0x9E3779B9u) >> shift_);
+}
+
+std::size_t ApertureTable::Slot(int code) const
+{
+	// Linear probing resolves the collisions
+	auto mask = slots_.size() - 1;
+	auto slot = Home(code);
+	while (slots_[slot].index_ >= 0 && slots_[slot].code_ != code) {
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+void ApertureTable::Grow()
+{
+	slots_.assign(std::max(kMinimumSlots, slots_.size() * 2), SLOT{ 0, -1 });
+	shift_ = 32;
+	for (auto size = slots_.size(); size > 1; size >>= 1) {
+		shift_--;
+	}
+
+	for (std::size_t i = 0; i < apertures_.size(); i++) {
+		auto& slot = slots_[Slot(apertures_[i]->code_)];
+		slot.code_ = apertures_[i]->code_;
+		slot.index_ = static_cast<std::int32_t>(i);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class GerberAperture;
+
+
+// Apertures by D code. They are stored densely in definition order, with an
+// open-addressing index from D code to position, so any D code can be used
+// and a lookup costs a hash and usually a single probe.
+class ApertureTable {
+public:
+	// False if an aperture with the same code is already defined.
+	bool Add(std::shared_ptr<GerberAperture> aperture);
+	// The aperture with that code, or an empty pointer.
+	const std::shared_ptr<GerberAperture>& Find(int code) const;
+
+	void Clear();
+	std::size_t Size() const;
+
+	// In definition order.
+	std::vector<std::shared_ptr<GerberAperture>>::const_iterator begin() const;
+	std::vector<std::shared_ptr<GerberAperture>>::const_iterator end() const;
+
+private:
+	friend class ApertureTableTest;
+
+	struct SLOT {
+		int code_;
+		std::int32_t index_; // Into apertures_, -1 if the slot is free
+	};
+
+	// Where the code goes without collisions
+	std::size_t Home(int code) const;
+	std::size_t Slot(int code) const;
+	// Slots looked at to find the code, 1 when it is in its own
+	std::size_t Probes(int code) const;
+	void Grow();
+
+	std::vector<std::shared_ptr<GerberAperture>> apertures_;
+	std::vector<SLOT> slots_; // Power of two in size, at most half full
+	int shift_{ 32 }; // 32 - log2 of the size of slots_
+};
@@ -0,0 +1,504 @@
+#include "command_store.h"
+#include <cmath>
+#include <cstring>
+
+
+namespace {
+
+// Bitwise, so that -0.0 is not taken for 0.0
+bool Same(double a, double b) {
+	return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+void PutVarint(std::vector<std::uint8_t>& bytes, std::uint64_t value) {
+	while (value >= 0x80) {
+		bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t GetVarint(const std::uint8_t* bytes, std::size_t& offset) {
+	std::uint64_t value = 0;
+	for (int shift = 0;; shift += 7) {
+		auto byte = bytes[offset++];
+		value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+		if (byte < 0x80) {
+			return value;
+		}
+	}
+}
+
+// As above, but false rather than reading past size or beyond 64 bits
+bool GetVarint(const std::uint8_t* bytes, std::size_t size, std::size_t& offset, std::uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (offset == size) {
+			return false;
+		}
+		auto byte = bytes[offset++];
+		value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+		if (byte < 0x80) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::uint64_t ZigZag(std::int64_t value) {
+	return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t UnZigZag(std::uint64_t value) {
+	return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+}
+
+CommandStore::Iterator::Iterator(const CommandStore* store, std::size_t index) :
+	store_(store), index_(index) {
+	if (index_ < store_->size_) {
+		Decode();
+	}
+}
+
+CommandStore::Iterator::Iterator(const CommandStore* store, std::size_t index, std::size_t offset, std::int64_t x, std::int64_t y) :
+	store_(store), index_(index), offset_(offset), x_(x), y_(y) {
+	if (index_ < store_->size_) {
+		Decode();
+	}
+}
+
+CommandStore::Iterator& CommandStore::Iterator::operator++() {
+	if (++index_ < store_->size_) {
+		Decode();
+	}
+	return *this;
+}
+
+void CommandStore::Iterator::SkipTo(std::size_t index) {
+	if (!store_->packed_ || index < index_ || index_ < index / kCheckpoint * kCheckpoint || index >= store_->size_) {
+		*this = store_->At(index);
+		return;
+	}
+
+	while (index_ < index) {
+		++*this;
+	}
+}
+
+void CommandStore::Iterator::Decode() {
+	if (store_->packed_) {
+		offset_ = store_->Decode(offset_, x_, y_, command_);
+	}
+	else {
+		command_ = (*store_)[index_];
+	}
+}
+
+std::uint8_t CommandStore::Split(const RenderCommand& command, std::uint32_t& arg, double& x, double& y) {
+	std::uint8_t op = static_cast<std::uint8_t>(command.command_);
+	arg = 0;
+	x = command.X;
+	y = command.Y;
+
+	if (command.command_ == RenderCommand::gcApertureSelect) {
+		auto found = aperture_index_.find(command.aperture_.get());
+		if (found == aperture_index_.end()) {
+			found = aperture_index_.emplace(command.aperture_.get(), static_cast<std::uint32_t>(apertures_.size())).first;
+			apertures_.push_back(command.aperture_);
+		}
+		arg = found->second;
+	}
+
+	const bool plain = Same(command.W, 0.0) && Same(command.H, 0.0) && Same(command.A, 0.0);
+	if (plain && Same(command.End.X, x) && Same(command.End.Y, y)) {
+		op |= fEndIsPoint;
+	}
+	else if (plain && Same(x, 0.0) && Same(y, 0.0)) {
+		op |= fPointIsEnd;
+		x = command.End.X;
+		y = command.End.Y;
+	}
+	else if (!plain || !Same(command.End.X, 0.0) || !Same(command.End.Y, 0.0)) {
+		op |= fExtra;
+		extras_.push_back({ command.W, command.H, command.A, command.End.X, command.End.Y, arg });
+		arg = static_cast<std::uint32_t>(extras_.size() - 1);
+	}
+
+	return op;
+}
+
+bool CommandStore::HasArgument(std::uint8_t op) {
+	return (op & fLayout) == fExtra || (op & fCommand) == RenderCommand::gcApertureSelect;
+}
+
+void CommandStore::Join(RenderCommand& command, std::uint8_t op, std::uint32_t arg, double x, double y) const {
+	command = RenderCommand(static_cast<RenderCommand::GerberCommand>(op & fCommand));
+
+	switch (op & fLayout) {
+	case fEndIsPoint:
+		command.X = command.End.X = x;
+		command.Y = command.End.Y = y;
+		break;
+
+	case fPointIsEnd:
+		command.End.X = x;
+		command.End.Y = y;
+		break;
+
+	case fExtra: {
+		const auto& extra = Extras()[arg];
+		command.X = x;
+		command.Y = y;
+		command.W = extra.W;
+		command.H = extra.H;
+		command.A = extra.A;
+		command.End.X = extra.end_x_;
+		command.End.Y = extra.end_y_;
+		arg = extra.arg_;
+		break;
+	}
+
+	default:
+		command.X = x;
+		command.Y = y;
+		break;
+	}
+
+	if (command.command_ == RenderCommand::gcApertureSelect) {
+		command.aperture_ = apertures_[arg];
+	}
+}
+
+void CommandStore::Add(const RenderCommand& command) {
+	if (mapping_) {
+		Own();
+	}
+
+	std::uint32_t arg;
+	double x, y;
+	auto op = Split(command, arg, x, y);
+
+	if (packed_) {
+		Encode(op, arg, x, y);
+	}
+	else {
+		ops_.push_back(op);
+		x_.push_back(x);
+		y_.push_back(y);
+		args_.push_back(arg);
+	}
+	size_++;
+}
+
+bool CommandStore::Quantize(double value, double divisor, std::int64_t& n, int& correction) const {
+	const auto scaled = value / scale_ * divisor;
+	if (!(std::fabs(scaled) < 9e15)) { // Also rejects NaN
+		return false;
+	}
+
+	// The parser divides by 10 once per decimal, which can be an ulp or two
+	// off a single division, so the difference is stored with the delta.
+	n = std::llround(scaled);
+	std::int64_t bits, rounded;
+	const auto quotient = Dequantize(n, 0, divisor);
+	std::memcpy(&bits, &value, sizeof(double));
+	std::memcpy(&rounded, &quotient, sizeof(double));
+	if (bits - rounded < -kMaxCorrection - 1 || bits - rounded > kMaxCorrection) {
+		return false;
+	}
+
+	correction = static_cast<int>(bits - rounded);
+	return true;
+}
+
+double CommandStore::Dequantize(std::int64_t n, int correction, double divisor) const {
+	auto value = static_cast<double>(n) / divisor * scale_;
+	if (correction) {
+		std::int64_t bits;
+		std::memcpy(&bits, &value, sizeof(double));
+		bits += correction;
+		std::memcpy(&value, &bits, sizeof(double));
+	}
+	return value;
+}
+
+void CommandStore::Encode(std::uint8_t op, std::uint32_t arg, double x, double y) {
+	if (size_ % kCheckpoint == 0) {
+		checkpoints_.push_back({ bytes_.size(), last_x_, last_y_ });
+	}
+
+	std::int64_t nx = 0, ny = 0;
+	int cx = 0, cy = 0;
+	if (Same(x, 0.0) && Same(y, 0.0)) {
+		op |= fPointZero;
+	}
+	else if (Quantize(x, x_divisor_, nx, cx) && Quantize(y, y_divisor_, ny, cy)) {
+		op |= fPointDelta;
+	}
+	else {
+		op |= fPointRaw;
+	}
+
+	bytes_.push_back(op);
+	if (HasArgument(op)) {
+		PutVarint(bytes_, arg);
+	}
+
+	switch (op & fPoint) {
+	case fPointDelta:
+		PutVarint(bytes_, ZigZag(nx - last_x_) << kCorrectionBits | ZigZag(cx));
+		PutVarint(bytes_, ZigZag(ny - last_y_) << kCorrectionBits | ZigZag(cy));
+		last_x_ = nx;
+		last_y_ = ny;
+		break;
+
+	case fPointRaw: {
+		auto size = bytes_.size();
+		bytes_.resize(size + 2 * sizeof(double));
+		std::memcpy(bytes_.data() + size, &x, sizeof(double));
+		std::memcpy(bytes_.data() + size + sizeof(double), &y, sizeof(double));
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+std::size_t CommandStore::Decode(std::size_t offset, std::int64_t& last_x, std::int64_t& last_y, RenderCommand& command) const {
+	const auto* bytes = Bytes();
+	const auto op = bytes[offset++];
+
+	std::uint32_t arg = 0;
+	if (HasArgument(op)) {
+		arg = static_cast<std::uint32_t>(GetVarint(bytes, offset));
+	}
+
+	double x = 0.0, y = 0.0;
+	switch (op & fPoint) {
+	case fPointDelta: {
+		const auto dx = GetVarint(bytes, offset);
+		const auto dy = GetVarint(bytes, offset);
+		last_x += UnZigZag(dx >> kCorrectionBits);
+		last_y += UnZigZag(dy >> kCorrectionBits);
+		x = Dequantize(last_x, static_cast<int>(UnZigZag(dx & kCorrectionMask)), x_divisor_);
+		y = Dequantize(last_y, static_cast<int>(UnZigZag(dy & kCorrectionMask)), y_divisor_);
+		break;
+	}
+
+	case fPointRaw:
+		std::memcpy(&x, bytes + offset, sizeof(double));
+		std::memcpy(&y, bytes + offset + sizeof(double), sizeof(double));
+		offset += 2 * sizeof(double);
+		break;
+
+	default:
+		break;
+	}
+
+	Join(command, static_cast<std::uint8_t>(op & ~fPoint), arg, x, y);
+	return offset;
+}
+
+void CommandStore::Pack(int x_decimals, int y_decimals, bool inches) {
+	CommandStore packed;
+	packed.packed_ = true;
+	packed.x_divisor_ = std::pow(10.0, x_decimals);
+	packed.y_divisor_ = std::pow(10.0, y_decimals);
+	packed.scale_ = inches ? 25.4 : 1.0;
+	if (packed_ && x_divisor_ == packed.x_divisor_ && y_divisor_ == packed.y_divisor_ && scale_ == packed.scale_) {
+		return;
+	}
+
+	for (const auto& command : *this) {
+		packed.Add(command);
+	}
+
+	packed.bytes_.shrink_to_fit();
+	packed.checkpoints_.shrink_to_fit();
+	packed.extras_.shrink_to_fit();
+	packed.apertures_.shrink_to_fit();
+	*this = std::move(packed);
+}
+
+CommandStore::VIEW CommandStore::View() const {
+	if (mapping_) {
+		return view_;
+	}
+
+	return { bytes_.data(), checkpoints_.data(), extras_.data(), bytes_.size(), checkpoints_.size(), extras_.size() };
+}
+
+void CommandStore::Own() {
+	bytes_.assign(view_.bytes_, view_.bytes_ + view_.byte_count_);
+	checkpoints_.assign(view_.checkpoints_, view_.checkpoints_ + view_.checkpoint_count_);
+	extras_.assign(view_.extras_, view_.extras_ + view_.extra_count_);
+
+	mapping_.reset();
+	view_ = VIEW{};
+}
+
+bool CommandStore::Consistent() const {
+	if (!packed_) {
+		return false;
+	}
+
+	const auto view = View();
+	std::size_t offset = 0;
+	std::int64_t x = 0, y = 0;
+	for (std::size_t i = 0; i < size_; i++) {
+		if (i % kCheckpoint == 0) {
+			if (i / kCheckpoint >= view.checkpoint_count_) {
+				return false;
+			}
+			const auto& checkpoint = view.checkpoints_[i / kCheckpoint];
+			if (checkpoint.offset_ != offset || checkpoint.x_ != x || checkpoint.y_ != y) {
+				return false;
+			}
+		}
+
+		if (offset == view.byte_count_) {
+			return false;
+		}
+		const auto op = view.bytes_[offset++];
+		if ((op & fCommand) >= RenderCommand::gcCount || (op & fPoint) == fPoint) {
+			return false;
+		}
+
+		std::uint64_t arg = 0;
+		if (HasArgument(op) && !GetVarint(view.bytes_, view.byte_count_, offset, arg)) {
+			return false;
+		}
+		if ((op & fLayout) == fExtra) {
+			if (arg >= view.extra_count_) {
+				return false;
+			}
+			arg = view.extras_[arg].arg_;
+		}
+		if ((op & fCommand) == RenderCommand::gcApertureSelect && arg >= apertures_.size()) {
+			return false;
+		}
+
+		switch (op & fPoint) {
+		case fPointDelta: {
+			std::uint64_t dx, dy;
+			if (!GetVarint(view.bytes_, view.byte_count_, offset, dx) || !GetVarint(view.bytes_, view.byte_count_, offset, dy)) {
+				return false;
+			}
+			// In the range Quantize leaves, which also rules out overflow
+			x = static_cast<std::int64_t>(static_cast<std::uint64_t>(x) + static_cast<std::uint64_t>(UnZigZag(dx >> kCorrectionBits)));
+			y = static_cast<std::int64_t>(static_cast<std::uint64_t>(y) + static_cast<std::uint64_t>(UnZigZag(dy >> kCorrectionBits)));
+			if (x < -9000000000000000 || x > 9000000000000000 || y < -9000000000000000 || y > 9000000000000000) {
+				return false;
+			}
+			break;
+		}
+
+		case fPointRaw:
+			if (view.byte_count_ - offset < 2 * sizeof(double)) {
+				return false;
+			}
+			offset += 2 * sizeof(double);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return offset == view.byte_count_ && x == last_x_ && y == last_y_;
+}
+
+void CommandStore::clear() {
+	size_ = 0;
+	ops_.clear();
+	x_.clear();
+	y_.clear();
+	args_.clear();
+
+	packed_ = false;
+	last_x_ = last_y_ = 0;
+	bytes_.clear();
+	checkpoints_.clear();
+
+	extras_.clear();
+	apertures_.clear();
+	aperture_index_.clear();
+
+	mapping_.reset();
+	view_ = VIEW{};
+}
+
+void CommandStore::reserve(std::size_t count) {
+	if (packed_) {
+		return; // The size of the stream is not known up front
+	}
+
+	ops_.reserve(count);
+	x_.reserve(count);
+	y_.reserve(count);
+	args_.reserve(count);
+}
+
+RenderCommand::GerberCommand CommandStore::Command(std::size_t index) const {
+	if (packed_) {
+		return (*this)[index].command_;
+	}
+
+	return static_cast<RenderCommand::GerberCommand>(ops_[index] & fCommand);
+}
+
+CommandStore::Iterator CommandStore::At(std::size_t index) const {
+	if (!packed_ || index >= size_) {
+		return Iterator(this, index);
+	}
+
+	const auto& checkpoint = Checkpoints()[index / kCheckpoint];
+	std::size_t offset = checkpoint.offset_;
+	auto x = checkpoint.x_;
+	auto y = checkpoint.y_;
+	RenderCommand skipped(RenderCommand::gcClose);
+	for (auto i = index / kCheckpoint * kCheckpoint; i < index; i++) {
+		offset = Decode(offset, x, y, skipped);
+	}
+
+	return Iterator(this, index, offset, x, y);
+}
+
+RenderCommand CommandStore::operator[](std::size_t index) const {
+	RenderCommand command(RenderCommand::gcClose);
+
+	if (packed_) {
+		const auto& checkpoint = Checkpoints()[index / kCheckpoint];
+		std::size_t offset = checkpoint.offset_;
+		auto x = checkpoint.x_;
+		auto y = checkpoint.y_;
+		for (auto i = index / kCheckpoint * kCheckpoint; i <= index; i++) {
+			offset = Decode(offset, x, y, command);
+		}
+	}
+	else {
+		Join(command, ops_[index], args_[index], x_[index], y_[index]);
+	}
+
+	return command;
+}
+
+std::size_t CommandStore::MemoryUsage() const {
+	if (mapping_) {
+		return view_.byte_count_ * sizeof(std::uint8_t) +
+			view_.checkpoint_count_ * sizeof(CHECKPOINT) +
+			view_.extra_count_ * sizeof(EXTRA) +
+			apertures_.capacity() * sizeof(std::shared_ptr<GerberAperture>);
+	}
+
+	return ops_.capacity() * sizeof(std::uint8_t) +
+		(x_.capacity() + y_.capacity()) * sizeof(double) +
+		args_.capacity() * sizeof(std::uint32_t) +
+		bytes_.capacity() * sizeof(std::uint8_t) +
+		checkpoints_.capacity() * sizeof(CHECKPOINT) +
+		extras_.capacity() * sizeof(EXTRA) +
+		apertures_.capacity() * sizeof(std::shared_ptr<GerberAperture>);
+}
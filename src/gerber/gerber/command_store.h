@@ -0,0 +1,183 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "gerber_command.h"
+
+class GerberAperture;
+
+
+// Render commands of a level, stored as parallel arrays instead of one heap
+// object each. Every command costs an opcode byte, its X and Y and a 32-bit
+// argument. Fields that most commands leave at zero, or that repeat X and Y,
+// are implied by the opcode flags; the rest go to a side table. Apertures
+// are stored once and referred to by index.
+//
+// After Pack the commands are instead kept as a byte stream in which points
+// are varint deltas in the resolution of the file, decoded while iterating.
+// A packed store loaded from a cache file views the stream in the mapping
+// of the file, and copies it only when commands are added.
+class CommandStore {
+public:
+	class Iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = RenderCommand;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const RenderCommand*;
+		using reference = const RenderCommand&;
+
+		Iterator(const CommandStore* store, std::size_t index);
+		// Continues a packed stream at offset, after the given point
+		Iterator(const CommandStore* store, std::size_t index, std::size_t offset, std::int64_t x, std::int64_t y);
+
+		const RenderCommand& operator*() const { return command_; }
+		const RenderCommand* operator->() const { return &command_; }
+		Iterator& operator++();
+		Iterator operator++(int) { auto tmp = *this; ++*this; return tmp; }
+		bool operator==(const Iterator& other) const { return index_ == other.index_; }
+		bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+		RenderCommand::GerberCommand Command() const { return command_.command_; }
+		std::size_t Index() const { return index_; }
+
+		// Moves to index. Packed stores decode forward from here when that is
+		// no further than from the checkpoint before index, so visiting
+		// increasing indices decodes every command at most once.
+		void SkipTo(std::size_t index);
+
+	private:
+		void Decode();
+
+		const CommandStore* store_;
+		std::size_t index_;
+
+		// Position in the packed stream and the last delta-coded point
+		std::size_t offset_{ 0 };
+		std::int64_t x_{ 0 }, y_{ 0 };
+
+		RenderCommand command_{ RenderCommand::gcClose };
+	};
+
+	// The command is stored exactly, including the sign of zeros.
+	void Add(const RenderCommand& command);
+
+	// Converts to the packed form. Points that are whole multiples of
+	// 10^-decimals (of an inch if inches, else of a mm) are delta-coded, any
+	// others are kept as doubles, so decoding is still exact. Commands added
+	// later are packed as well, until clear(). Does nothing if already packed
+	// with the same resolution.
+	void Pack(int x_decimals, int y_decimals, bool inches);
+	bool Packed() const { return packed_; }
+
+	void clear();
+	void reserve(std::size_t count);
+	std::size_t size() const { return size_; }
+	bool empty() const { return !size_; }
+
+	RenderCommand::GerberCommand Command(std::size_t index) const;
+	// Packed stores decode from the nearest checkpoint before index.
+	RenderCommand operator[](std::size_t index) const;
+
+	Iterator begin() const { return Iterator(this, 0); }
+	Iterator end() const { return Iterator(this, size_); }
+	// Packed stores decode from the nearest checkpoint before index; to visit
+	// increasing indices, Iterator::SkipTo avoids doing that every time.
+	Iterator At(std::size_t index) const;
+
+	// Bytes held by the arrays, or viewed in a mapped file, not counting the
+	// apertures themselves.
+	std::size_t MemoryUsage() const;
+
+private:
+	friend class GerberCache;
+
+	enum FLAG : std::uint8_t {
+		fCommand = 0x0F,
+
+		fLayout = 0x30,
+		fEndIsPoint = 0x10, // End equals X, Y
+		fPointIsEnd = 0x20, // X and Y are zero; the stored point is End
+		fExtra = 0x30,      // W, H, A and End are in extras_[arg]
+
+		// Packed form only: how the point is stored
+		fPoint = 0xC0,
+		fPointZero = 0x00,  // Not at all, both are +0.0
+		fPointDelta = 0x40, // Varint deltas from the last delta-coded point
+		fPointRaw = 0x80,   // Two doubles
+	};
+
+	struct EXTRA {
+		double W, H, A;
+		double end_x_, end_y_;
+		std::uint32_t arg_; // What the argument would otherwise be
+	};
+
+	// Decoding state before every kCheckpoint'th packed command
+	static constexpr std::size_t kCheckpoint = 64;
+	struct CHECKPOINT {
+		std::uint64_t offset_;
+		std::int64_t x_, y_;
+	};
+
+	// Splits a command into the opcode, argument and point both forms store.
+	std::uint8_t Split(const RenderCommand& command, std::uint32_t& arg, double& x, double& y);
+	void Join(RenderCommand& command, std::uint8_t op, std::uint32_t arg, double x, double y) const;
+	static bool HasArgument(std::uint8_t op);
+
+	void Encode(std::uint8_t op, std::uint32_t arg, double x, double y);
+	// Decodes the command at offset and returns the offset of the next one.
+	std::size_t Decode(std::size_t offset, std::int64_t& last_x, std::int64_t& last_y, RenderCommand& command) const;
+
+	// Delta-coded values are n / divisor, adjusted by a few ulps. The
+	// adjustment shares the varint with the delta, in its low bits.
+	static constexpr int kCorrectionBits = 3;
+	static constexpr std::uint64_t kCorrectionMask = (1 << kCorrectionBits) - 1;
+	static constexpr int kMaxCorrection = (1 << (kCorrectionBits - 1)) - 1;
+	bool Quantize(double value, double divisor, std::int64_t& n, int& correction) const;
+	double Dequantize(std::int64_t n, int correction, double divisor) const;
+
+	std::size_t size_{ 0 };
+
+	std::vector<std::uint8_t> ops_;
+	std::vector<double> x_;
+	std::vector<double> y_;
+	std::vector<std::uint32_t> args_; // Into extras_ if fExtra, else apertures_ for gcApertureSelect
+
+	bool packed_{ false };
+	double x_divisor_{ 1.0 }, y_divisor_{ 1.0 }; // 10^decimals
+	double scale_{ 1.0 };                        // To mm
+	std::int64_t last_x_{ 0 }, last_y_{ 0 };
+	std::vector<std::uint8_t> bytes_;
+	std::vector<CHECKPOINT> checkpoints_;
+
+	std::vector<EXTRA> extras_;
+	std::vector<std::shared_ptr<GerberAperture>> apertures_;
+	std::unordered_map<const GerberAperture*, std::uint32_t> aperture_index_;
+
+	// Set when the stream, its checkpoints and extras are a view into a
+	// mapped cache file, which this keeps open; the vectors are empty then.
+	struct VIEW {
+		const std::uint8_t* bytes_;
+		const CHECKPOINT* checkpoints_;
+		const EXTRA* extras_;
+		std::size_t byte_count_, checkpoint_count_, extra_count_;
+	};
+	std::shared_ptr<const void> mapping_;
+	VIEW view_{};
+
+	const std::uint8_t* Bytes() const { return mapping_ ? view_.bytes_ : bytes_.data(); }
+	const CHECKPOINT* Checkpoints() const { return mapping_ ? view_.checkpoints_ : checkpoints_.data(); }
+	const EXTRA* Extras() const { return mapping_ ? view_.extras_ : extras_.data(); }
+	// The arrays in use, whether viewed or in the vectors
+	VIEW View() const;
+	// Copies a view into the vectors, so that commands can be added.
+	void Own();
+	// Whether a packed stream read from elsewhere decodes to size_ commands
+	// within its bytes, with every argument, checkpoint and the last point
+	// matching; decoding trusts all of them.
+	bool Consistent() const;
+};
@@ -89,7 +89,8 @@ void GerberAperture::UseMacro(
 	x = y = 0.0;
 
 	type_ = tMacro;
-	render_commands_ = macro->Render(modifiers, modifier_count);
+	render_commands_.clear();
+	macro->Render(modifiers, modifier_count, render_commands_);
 
 	for (auto render : render_commands_) {
 		switch (render->command_) {
@@ -166,19 +167,19 @@ void GerberAperture::UseMacro(
 	}
 }
 
-bool GerberAperture::SolidCircle() {
+bool GerberAperture::SolidCircle() const {
 	return(type_ == tCircle && hole_x_ < 0.0 && hole_y_ < 0.0);
 }
 
-bool GerberAperture::SolidRectangle() {
+bool GerberAperture::SolidRectangle() const {
 	return(type_ == tRectangle && hole_x_ < 0.0 && hole_y_ < 0.0);
 }
 
-void GerberAperture::Add(std::shared_ptr<RenderCommand> render) {
+void GerberAperture::Add(std::shared_ptr<RenderCommand> render) const {
 	render_commands_.push_back(render);
 }
 
-void GerberAperture::RenderHole() {
+void GerberAperture::RenderHole() const {
 	std::shared_ptr<RenderCommand> render;
 
 	if (hole_x_ > 0.0) {
@@ -222,7 +223,7 @@ void GerberAperture::RenderHole() {
 	}
 }
 
-void GerberAperture::RenderObround() {
+void GerberAperture::RenderObround() const {
 	std::shared_ptr<RenderCommand> render;
 
 	double r, t;
@@ -290,7 +291,7 @@ void GerberAperture::RenderObround() {
 	Add(render);
 }
 
-void GerberAperture::RenderCircle() {
+void GerberAperture::RenderCircle() const {
 	std::shared_ptr<RenderCommand> render;
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcCircle);
@@ -305,17 +306,18 @@ void GerberAperture::RenderCircle() {
 	Add(render);
 }
 
-void GerberAperture::RenderPolygon() {
+void GerberAperture::RenderPolygon() const {
 	double        r, a, da, rot, lim;
 	std::shared_ptr<RenderCommand> render;
 
 	// Get Rotation in range [0; 360)
-	while (rotation_ < 0.0) rotation_ += 360;
-	while (rotation_ >= 360.0) rotation_ -= 360;
+	auto rotation = rotation_;
+	while (rotation < 0.0) rotation += 360;
+	while (rotation >= 360.0) rotation -= 360;
 
 	r = dimension_x_ / 2.0;
 	da = 2.0 * kPi / side_count_;
-	rot = rotation_ * kPi / 180.0;
+	rot = rotation * kPi / 180.0;
 	lim = 2.0 * kPi - da / 2.0;
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
@@ -339,7 +341,7 @@ void GerberAperture::RenderPolygon() {
 	Add(render);
 }
 
-void GerberAperture::RenderRectangle() {
+void GerberAperture::RenderRectangle() const {
 	std::shared_ptr<RenderCommand> render;
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcRectangle);
@@ -355,7 +357,7 @@ void GerberAperture::RenderRectangle() {
 	Add(render);
 }
 
-void GerberAperture::RenderAperture() {
+void GerberAperture::RenderAperture() const {
 	switch (type_) {
 	case tCircle:
 		RenderCircle();
@@ -379,9 +381,11 @@ void GerberAperture::RenderAperture() {
 	}
 }
 
-std::vector<std::shared_ptr<RenderCommand>> GerberAperture::Render() {
-	if (render_commands_.empty())
-		RenderAperture();
+const std::vector<std::shared_ptr<RenderCommand>>& GerberAperture::Render() const {
+	std::call_once(render_once_, [this]() {
+		if (render_commands_.empty())
+			RenderAperture();
+	});
 
 	return render_commands_;
 }
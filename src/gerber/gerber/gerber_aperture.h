@@ -1,6 +1,7 @@
 #pragma once
 
 #include <math.h>
+#include <mutex>
 #include <vector>
 
 #include "gerber_macro.h"
@@ -21,17 +22,20 @@ private:
 
 	TYPE type_;
 
-	std::vector<std::shared_ptr<RenderCommand>> render_commands_;
+	// Standard apertures are rendered on first use, once, even when several
+	// threads render at the same time.
+	mutable std::vector<std::shared_ptr<RenderCommand>> render_commands_;
+	mutable std::once_flag render_once_;
 
-	void Add(std::shared_ptr<RenderCommand> render);
+	void Add(std::shared_ptr<RenderCommand> render) const;
 
-	void RenderHole();
-	void RenderObround();
-	void RenderCircle();
-	void RenderPolygon();
-	void RenderRectangle();
+	void RenderHole() const;
+	void RenderObround() const;
+	void RenderCircle() const;
+	void RenderPolygon() const;
+	void RenderRectangle() const;
 
-	void RenderAperture();
+	void RenderAperture() const;
 
 	// Standard Aperture (not Custom) modifiers
 	double dimension_x_; // Also used for outside diameter of circles
@@ -43,6 +47,8 @@ private:
 	int side_count_; // Number of sides
 	double rotation_;  // Degrees of rotaion (rotate the whole thing CCW)
 
+	friend class GerberCache;
+
 public:
 	GerberAperture();
 	~GerberAperture();
@@ -71,11 +77,11 @@ public:
 	void UseMacro(std::shared_ptr<GerberMacro> macro, double* modifiers, int modifier_count);
 
 	// Used to determine if it is a basic shape or not
-	bool SolidCircle();
-	bool SolidRectangle();
+	bool SolidCircle() const;
+	bool SolidRectangle() const;
 
 	// Linked list of render commands
 	// Memory freed automatically
-	std::vector<std::shared_ptr<RenderCommand>> Render();
+	const std::vector<std::shared_ptr<RenderCommand>>& Render() const;
 };
 
@@ -27,7 +27,10 @@ public:
 		gcBeginOutline, // The aperture does not matter
 		gcEndOutline,   // The aperture matters again
 		gcApertureSelect,
-		gcFlash
+		gcFlash,
+		gcDot, // Level of detail only: a flash or path smaller than a pixel
+
+		gcCount // Number of commands, not a command
 	};
 
 
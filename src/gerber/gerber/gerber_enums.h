@@ -19,3 +19,9 @@ enum GERBER_EXPOSURE {
 	geOff,
 	geFlash
 };
+
+enum GERBER_LOAD_MODE {
+	glBuffered, // Read the whole file into memory
+	glMapped,   // Parse straight from a read-only mapping; falls back to glBuffered for pipes and stdin
+	glStreamed  // Read fixed-size chunks and drop the parsed text, memory use is independent of the file size
+};
@@ -2,6 +2,8 @@
 #include "gerber_aperture.h"
 #include "plotter.h"
 #include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
 
 
 constexpr double kPi = 3.141592653589793238463;
@@ -51,7 +53,7 @@ GerberLevel::GerberLevel(std::shared_ptr<GerberLevel> previous_level, GERBER_UNI
 GerberLevel::~GerberLevel() {
 }
 
-bool GerberLevel::IsCopyLayer()
+bool GerberLevel::IsCopyLayer() const
 {
 	return CountX > 1 || CountY > 1;
 }
@@ -78,37 +80,99 @@ void GerberLevel::SetName(const std::string& name) {
 	name_ = name;
 }
 
-void GerberLevel::Add(std::shared_ptr<RenderCommand> command) {
-	render_commands_.push_back(command);
+std::shared_ptr<GerberLevel> GerberLevel::CopyState() const {
+	auto level = std::make_shared<GerberLevel>(nullptr, units_);
+
+	level->bound_box_ = bound_box_;
+	level->CountX = CountX;
+	level->CountY = CountY;
+	level->StepX = StepX;
+	level->StepY = StepY;
+	level->name_ = name_;
+	level->negative_ = negative_;
+	level->relative_ = relative_;
+	level->incremental_ = incremental_;
+	level->multi_quadrant_ = multi_quadrant_;
+	level->X = X;
+	level->Y = Y;
+	level->I = I;
+	level->J = J;
+	level->exposure_ = exposure_;
+	level->interpolation_ = interpolation_;
+	level->plot_ = plot_;
+	level->store_commands_ = store_commands_;
+	level->plotter_->CopyState(*plotter_);
+
+	return level;
 }
 
-std::shared_ptr<RenderCommand> GerberLevel::AddNew(RenderCommand::GerberCommand command) {
-	auto tmp = std::make_shared<RenderCommand>(command);
-	Add(tmp);
-	return tmp;
+void GerberLevel::Add(const RenderCommand& command) {
+	command_counts_[command.command_]++;
+
+	if (store_commands_) {
+		render_commands_.Add(command);
+	}
+}
+
+void GerberLevel::AddNew(RenderCommand::GerberCommand command) {
+	Add(RenderCommand(command));
 }
 
-void GerberLevel::ApertureSelect(std::shared_ptr<GerberAperture> aperture, unsigned line_number) {
-	plotter_->ApertureSelect(aperture, line_number);
+void GerberLevel::ApertureSelect(std::shared_ptr<GerberAperture> aperture, const GerberFile& file) {
+	plotter_->ApertureSelect(aperture, file);
 }
 
-void GerberLevel::OutlineBegin(unsigned LineNumber) {
-	plotter_->OutlineBegin(LineNumber);
+void GerberLevel::OutlineBegin(const GerberFile& file) {
+	plotter_->OutlineBegin(file);
 }
 
-void GerberLevel::OutlineEnd(unsigned LineNumber) {
-	plotter_->OutlineEnd(LineNumber);
+void GerberLevel::OutlineEnd(const GerberFile& file) {
+	plotter_->OutlineEnd(file);
 }
 
-void GerberLevel::Do(unsigned line_number) {
-	plotter_->Do(line_number);
+void GerberLevel::Do(const GerberFile& file) {
+	plotter_->Do(file);
 }
 
-std::vector<std::shared_ptr<RenderCommand>> GerberLevel::RenderCommands() const {
+const CommandStore& GerberLevel::RenderCommands() const {
 	return render_commands_;
 }
 
-void GerberLevel::Segment::Add(std::shared_ptr<RenderCommand> command_) {
+void GerberLevel::PackCommands(int x_decimals, int y_decimals, bool inches) {
+	render_commands_.Pack(x_decimals, y_decimals, inches);
+}
+
+const SpatialIndex& GerberLevel::Index() const {
+	return index_;
+}
+
+void GerberLevel::BuildIndex() {
+	index_.Build(render_commands_);
+
+	std::lock_guard<std::mutex> lock(detail_mutex_);
+	for (auto& detail : details_) {
+		detail.reset();
+	}
+}
+
+const LevelOfDetail* GerberLevel::Detail(double tolerance) const {
+	auto level = -1;
+	for (auto next = kDetailTolerance; level + 1 < static_cast<int>(details_.size()) && next <= tolerance; next *= 4.0) {
+		level++;
+	}
+	if (level < 0) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(detail_mutex_);
+	auto& detail = details_[level];
+	if (!detail) {
+		detail = std::make_unique<LevelOfDetail>(render_commands_, kDetailTolerance * std::pow(4.0, level));
+	}
+	return detail.get();
+}
+
+void GerberLevel::Segment::Add(const RenderCommand& command_) {
 	closed_ = false;
 	command_list_.push_back(command_);
 }
@@ -122,8 +186,8 @@ bool GerberLevel::Segment::IsClosed() {
 		return false;
 	}
 
-	if (command_list_.back()->End.X == command_list_.front()->X &&
-		command_list_.back()->End.Y == command_list_.front()->Y) {
+	if (command_list_.back().End.X == command_list_.front().X &&
+		command_list_.back().End.Y == command_list_.front().Y) {
 		closed_ = true;
 		return true;
 	}
@@ -140,42 +204,42 @@ void GerberLevel::Segment::Reverse() {
 		return;
 	}
 
-	auto old_list = command_list_;
-	command_list_.clear();
-
-	auto begin_line = old_list.front();
+	// Each command takes the start of the one before it, in place
+	auto& begin_line = command_list_.front();
+	double x = begin_line.X;
+	double y = begin_line.Y;
 
-	double x = begin_line->X;
-	double y = begin_line->Y;
+	for (auto iter = std::next(command_list_.begin()); iter != command_list_.end();) {
+		auto& command = *iter;
 
-	auto begin = old_list.begin();
-	for (auto iter = ++begin; iter != old_list.end(); ++iter) {
-		auto command = *iter;
-
-		switch (command->command_) {
+		switch (command.command_) {
 		case RenderCommand::gcLine:
-			command->X = x;
-			command->Y = y;
-			std::swap(x, command->End.X);
-			std::swap(y, command->End.Y);
-			command_list_.push_front(command);
+			command.X = x;
+			command.Y = y;
+			std::swap(x, command.End.X);
+			std::swap(y, command.End.Y);
+			++iter;
 			break;
 
 		case RenderCommand::gcArc:
-			command->A *= -1;
-			std::swap(x, command->End.X);
-			std::swap(y, command->End.Y);
-			command_list_.push_front(command);
+			command.A *= -1;
+			std::swap(x, command.End.X);
+			std::swap(y, command.End.Y);
+			++iter;
 			break;
 
 		default:
+			iter = command_list_.erase(iter);
 			break;
 		}
 	}
 
-	begin_line->X = x;
-	begin_line->Y = y;
-	command_list_.push_front(begin_line);
+	begin_line.X = x;
+	begin_line.Y = y;
+
+	// The begin line stays in front of the reversed rest
+	command_list_.reverse();
+	command_list_.splice(command_list_.begin(), command_list_, std::prev(command_list_.end()));
 }
 
 void GerberLevel::Segment::Isolate() {
@@ -201,20 +265,21 @@ void GerberLevel::NewSegment() {
 	}
 
 	tmp->prev_ = last_segment_;
+	tmp->order_ = last_segment_ ? last_segment_->order_ + 1 : 0;
 	last_segment_ = tmp;
 }
 
 
 void GerberLevel::ExtractSegments() {
-	auto old_list = render_commands_;
-	render_commands_.clear();
+	CommandStore old_list;
+	std::swap(old_list, render_commands_);
 
 	bool is_outline = false;
 	for (const auto& render : old_list) {
-		switch (render->command_) {
+		switch (render.command_) {
 		case RenderCommand::gcBeginLine:
 			if (is_outline) {
-				Add(render);
+				render_commands_.Add(render);
 			}
 			else {
 				NewSegment();
@@ -224,7 +289,7 @@ void GerberLevel::ExtractSegments() {
 
 		case RenderCommand::gcLine:
 			if (is_outline) {
-				Add(render);
+				render_commands_.Add(render);
 			}
 			else {
 				last_segment_->Add(render);
@@ -233,7 +298,7 @@ void GerberLevel::ExtractSegments() {
 
 		case RenderCommand::gcArc:
 			if (is_outline) {
-				Add(render);
+				render_commands_.Add(render);
 			}
 			else {
 				last_segment_->Add(render);
@@ -245,17 +310,17 @@ void GerberLevel::ExtractSegments() {
 
 		case RenderCommand::gcClose:
 		case RenderCommand::gcFill:
-			Add(render);
+			render_commands_.Add(render);
 			break;
 
 		case RenderCommand::gcBeginOutline:
 			is_outline = true;
-			Add(render);
+			render_commands_.Add(render);
 			break;
 
 		case RenderCommand::gcEndOutline:
 			is_outline = false;
-			Add(render);
+			render_commands_.Add(render);
 			break;
 
 		case RenderCommand::gcApertureSelect:
@@ -272,6 +337,49 @@ void GerberLevel::ExtractSegments() {
 }
 
 
+std::int64_t GerberLevel::EndCell(double value) {
+	return static_cast<std::int64_t>(std::floor(value / kJoinTolerance));
+}
+
+std::uint64_t GerberLevel::EndKey(std::int64_t cell_x, std::int64_t cell_y) {
+	// Distinct cells sharing a key only cost a few extra comparisons
+	return static_cast<std::uint64_t>(cell_x) * 0x9E3779B97F4A7C15ull ^ static_cast<std::uint64_t>(cell_y);
+}
+
+void GerberLevel::AddEnds(Segment* segment) {
+	if (segment->command_list_.empty() || segment->IsClosed()) {
+		return;
+	}
+
+	const auto& front = segment->command_list_.front();
+	const auto& back = segment->command_list_.back().End;
+	ends_[EndKey(EndCell(front.X), EndCell(front.Y))].push_back({ segment, true });
+	ends_[EndKey(EndCell(back.X), EndCell(back.Y))].push_back({ segment, false });
+}
+
+void GerberLevel::RemoveEnds(Segment* segment) {
+	if (segment->command_list_.empty()) {
+		return;
+	}
+
+	const auto& front = segment->command_list_.front();
+	const auto& back = segment->command_list_.back().End;
+	for (auto key : { EndKey(EndCell(front.X), EndCell(front.Y)), EndKey(EndCell(back.X), EndCell(back.Y)) }) {
+		auto cell = ends_.find(key);
+		if (cell == ends_.end()) {
+			continue;
+		}
+
+		auto& ends = cell->second;
+		ends.erase(std::remove_if(ends.begin(), ends.end(), [segment](const END& end) {
+			return end.segment_ == segment;
+		}), ends.end());
+		if (ends.empty()) {
+			ends_.erase(cell);
+		}
+	}
+}
+
 GerberLevel::Segment* GerberLevel::FindNeighbour(Segment* current) {
 	if (current->command_list_.empty()) {
 		return nullptr;
@@ -281,66 +389,95 @@ GerberLevel::Segment* GerberLevel::FindNeighbour(Segment* current) {
 		return nullptr;
 	}
 
-	Segment* candidate = segment_list_;
-
-	while (candidate) {
-		if (candidate != current && !candidate->command_list_.empty() && !candidate->IsClosed()) {
-			if (current->command_list_.back()->End.X == candidate->command_list_.front()->X &&
-				current->command_list_.back()->End.Y == candidate->command_list_.front()->Y) {
-				return candidate;
-			}
+	const auto x = current->command_list_.back().End.X;
+	const auto y = current->command_list_.back().End.Y;
+	const auto cell_x = EndCell(x), cell_y = EndCell(y);
+
+	// The first segment in the list that has a matching end, preferring its
+	// front to its back, looking in the given cells around the end.
+	auto find = [&](int reach, auto&& matches) -> const END* {
+		const END* found = nullptr;
+		for (int dy = -reach; dy <= reach; dy++) {
+			for (int dx = -reach; dx <= reach; dx++) {
+				auto cell = ends_.find(EndKey(cell_x + dx, cell_y + dy));
+				if (cell == ends_.end()) {
+					continue;
+				}
 
-			if (current->command_list_.back()->End.X == candidate->command_list_.back()->End.X &&
-				current->command_list_.back()->End.Y == candidate->command_list_.back()->End.Y) {
-				candidate->Reverse();
-				return candidate;
+				for (const auto& end : cell->second) {
+					const auto candidate = end.segment_;
+					if (candidate == current || candidate->command_list_.empty() || candidate->IsClosed()) {
+						continue;
+					}
+
+					const auto& point = end.front_ ? candidate->command_list_.front() : candidate->command_list_.back();
+					const auto end_x = end.front_ ? point.X : point.End.X;
+					const auto end_y = end.front_ ? point.Y : point.End.Y;
+					if (!matches(end_x, end_y)) {
+						continue;
+					}
+
+					if (!found || candidate->order_ < found->segment_->order_ ||
+						(candidate->order_ == found->segment_->order_ && end.front_)) {
+						found = &end;
+					}
+				}
 			}
 		}
-
-		candidate = candidate->next_;
+		return found;
+	};
+
+	auto found = find(0, [&](double end_x, double end_y) {
+		return end_x == x && end_y == y;
+	});
+	if (found) {
+		if (!found->front_) {
+			found->segment_->Reverse();
+		}
+		return found->segment_;
 	}
 
 	// No candidates found, but run the test again checking for near segments.
 	// Points are considered the same if they are closer than 1 μm.
 	// This is required because many Gerber generators make rounding errors.
+	// Such ends are at most one cell away.
+	found = find(1, [&](double end_x, double end_y) {
+		return fabs(x - end_x) < kJoinTolerance && fabs(y - end_y) < kJoinTolerance;
+	});
+	if (!found) {
+		return nullptr;
+	}
 
-	candidate = segment_list_;
-	double dX, dY;
-
-	while (candidate) {
-		if (candidate != current && !candidate->command_list_.empty() && !candidate->IsClosed()) {
-			dX = fabs(current->command_list_.back()->End.X - candidate->command_list_.front()->X);
-			dY = fabs(current->command_list_.back()->End.Y - candidate->command_list_.front()->Y);
-			if (dX < 1e-3 && dY < 1e-3) {
-				if (gerber_warnings) {
-					LOG(WARNING) << "Strokes2Fills - Warning: Joining segments that are close, but not coincident:";
-				}
-				return candidate;
-			}
-			dX = fabs(current->command_list_.back()->End.X - candidate->command_list_.back()->End.X);
-			dY = fabs(current->command_list_.back()->End.Y - candidate->command_list_.back()->End.Y);
-			if (dX < 1e-3 && dY < 1e-3) {
-				candidate->Reverse();
-				if (gerber_warnings) {
-					printf(
-						"Strokes2Fills - Warning: "
-						"Joining segments that are close, but not coincident:\n"
-						"    dX = %08.6lf mm (%07.5lf mil)\n"
-						"    dY = %08.6lf mm (%07.5lf mil)\n",
-						dX, dX / 25.4e-3,
-						dY, dY / 25.4e-3
-					);
-				}
-				return candidate;
-			}
+	auto candidate = found->segment_;
+	if (found->front_) {
+		if (gerber_warnings) {
+			LOG(WARNING) << "Strokes2Fills - Warning: Joining segments that are close, but not coincident:";
 		}
-		candidate = candidate->next_;
+		return candidate;
+	}
+
+	const auto dX = fabs(x - candidate->command_list_.back().End.X);
+	const auto dY = fabs(y - candidate->command_list_.back().End.Y);
+	candidate->Reverse();
+	if (gerber_warnings) {
+		printf(
+			"Strokes2Fills - Warning: "
+			"Joining segments that are close, but not coincident:\n"
+			"    dX = %08.6lf mm (%07.5lf mil)\n"
+			"    dY = %08.6lf mm (%07.5lf mil)\n",
+			dX, dX / 25.4e-3,
+			dY, dY / 25.4e-3
+		);
 	}
-	return 0;
+	return candidate;
 }
 
 
 void GerberLevel::JoinSegments() {
+	for (auto segment = segment_list_; segment; segment = segment->next_) {
+		AddEnds(segment);
+	}
+
 	auto current = segment_list_;
 
 	while (current) {
@@ -355,21 +492,22 @@ void GerberLevel::JoinSegments() {
 				last_segment_ = last_segment_->prev_;
 			}
 
+			RemoveEnds(current);
+			RemoveEnds(neighbour);
 			neighbour->Isolate();
 
-			auto begin_line = neighbour->command_list_.front();
 			neighbour->command_list_.pop_front();
-
-			for (const auto& each : neighbour->command_list_) {
-				current->command_list_.push_back(each);
-			}
+			current->command_list_.splice(current->command_list_.end(), neighbour->command_list_);
 			delete neighbour;
 
+			AddEnds(current);
 		}
 		else {
 			current = current->next_;
 		}
 	}
+
+	ends_.clear();
 }
 
 
@@ -382,7 +520,7 @@ void GerberLevel::AddSegments() {
 
 	while (segment_list_) {
 		for (const auto& each : segment_list_->command_list_) {
-			render_commands_.push_back(each);
+			render_commands_.Add(each);
 		}
 
 		if (!segment_list_->IsClosed()) {
@@ -401,9 +539,22 @@ void GerberLevel::AddSegments() {
 }
 
 
+const GerberLevel& GerberLevel::Fills() const {
+	std::call_once(fills_once_, [this]() {
+		auto level = CopyState();
+		level->render_commands_ = render_commands_;
+		level->command_counts_ = command_counts_;
+		level->ConvertStrokesToFills();
+		fills_ = std::move(level);
+	});
+
+	return *fills_;
+}
+
 void GerberLevel::ConvertStrokesToFills() {
 	ExtractSegments();
 	JoinSegments();
 	AddSegments();
+	BuildIndex();
 }
 
@@ -1,26 +1,44 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <list>
 #include <memory>
+#include <mutex>
 
 #include "gerber_enums.h"
 #include "gerber_command.h"
+#include "command_store.h"
+#include "spatial_index.h"
+#include "level_of_detail.h"
 #include "bound_box.h"
 
 
 extern bool gerber_warnings;
 
 class GerberAperture;
+class GerberFile;
 class Plotter;
+class Gerber;
+class GCodeParser;
+class DCodeParser;
+class MCodeParser;
+class ParameterParser;
 
 class GerberLevel {
 private: // Standard private members and functions
-	std::vector<std::shared_ptr<RenderCommand>> render_commands_;
+	CommandStore render_commands_;
+	SpatialIndex index_;
 
-	void Add(std::shared_ptr<RenderCommand> command);
-	std::shared_ptr<RenderCommand> AddNew(RenderCommand::GerberCommand command);
+	// Built on first use, so only the scales actually viewed cost anything
+	mutable std::mutex detail_mutex_;
+	mutable std::array<std::unique_ptr<LevelOfDetail>, 5> details_;
+
+	// Counts the command, and stores it unless only counting.
+	void Add(const RenderCommand& command);
+	void AddNew(RenderCommand::GerberCommand command);
 
 private: // Specifically used by ConvertStrokesToFills()
 
@@ -29,11 +47,12 @@ private: // Specifically used by ConvertStrokesToFills()
 		bool closed_ = false; // true => closed; false => maybe closed
 
 	public:
-		std::list<std::shared_ptr<RenderCommand>> command_list_;
+		std::list<RenderCommand> command_list_;
 		Segment* prev_ = nullptr;
 		Segment* next_ = nullptr;
+		std::size_t order_ = 0; // Position in the segment list when extracted
 
-		void Add(std::shared_ptr<RenderCommand> command_);
+		void Add(const RenderCommand& command_);
 		bool IsClosed();
 		void Reverse();
 		void Isolate();
@@ -42,15 +61,58 @@ private: // Specifically used by ConvertStrokesToFills()
 	Segment* segment_list_ = nullptr;
 	Segment* last_segment_ = nullptr;
 
+	// Ends are joined when closer than this in both x and y, in mm.
+	static constexpr double kJoinTolerance = 1e-3;
+
+	// The ends of the open segments, by cell of a kJoinTolerance grid, so
+	// that finding a neighbour only looks at the ends around it.
+	struct END {
+		Segment* segment_;
+		bool front_;
+	};
+	std::unordered_map<std::uint64_t, std::vector<END>> ends_;
+
+	static std::int64_t EndCell(double value);
+	static std::uint64_t EndKey(std::int64_t cell_x, std::int64_t cell_y);
+	void AddEnds(Segment* segment);
+	void RemoveEnds(Segment* segment);
 	Segment* FindNeighbour(Segment* Current);
 
 	void NewSegment();
 	void ExtractSegments();
 	void JoinSegments();
 	void AddSegments();
+	void ConvertStrokesToFills();
+
+	mutable std::once_flag fills_once_;
+	mutable std::shared_ptr<GerberLevel> fills_;
 
 	std::unique_ptr<Plotter> plotter_;
+
+private: // Used while parsing, a loaded level is only read
 	friend class Plotter;
+	friend class Gerber;
+	friend class GCodeParser;
+	friend class DCodeParser;
+	friend class MCodeParser;
+	friend class ParameterParser;
+	friend class GerberCache;
+
+	void SetName(const std::string& name);
+
+	// New level with the same state, but without render commands.
+	std::shared_ptr<GerberLevel> CopyState() const;
+
+	// The source file is only used to look up line numbers for warnings.
+	void ApertureSelect(std::shared_ptr<GerberAperture> aperture_, const GerberFile& file);
+	void OutlineBegin(const GerberFile& file);
+	void OutlineEnd(const GerberFile& file);
+	void Do(const GerberFile& file);
+
+	// See CommandStore::Pack.
+	void PackCommands(int x_decimals, int y_decimals, bool inches);
+	// Built once the commands are complete.
+	void BuildIndex();
 
 public: // Public interface
 	GerberLevel(std::shared_ptr<GerberLevel> PreviousLevel, GERBER_UNIT Units);
@@ -66,8 +128,6 @@ public: // Public interface
 	int    CountX, CountY;
 	double StepX, StepY;
 
-	void SetName(const std::string& name);
-
 	std::string name_; // null for default level
 	bool  negative_;
 	bool  relative_;
@@ -76,22 +136,36 @@ public: // Public interface
 
 	double X, Y, I, J;
 
+	// When false only the modal state is tracked, no render commands are
+	// created and the bounding box is left alone.
+	bool plot_{ true };
+	// When false render commands are only counted, not stored. The bounding
+	// box is computed either way.
+	bool store_commands_{ true };
+
+	// Number of render commands created, by kind.
+	std::array<std::size_t, RenderCommand::gcCount> command_counts_{};
+
 	GERBER_UNIT          units_;
 	GERBER_EXPOSURE      exposure_;
 	GERBER_INTERPOLATION interpolation_;
 
-	void ApertureSelect(std::shared_ptr<GerberAperture> aperture_, unsigned LineNumber);
-	void OutlineBegin(unsigned LineNumber);
-	void OutlineEnd(unsigned LineNumber);
-	void Do(unsigned LineNumber);
+	const CommandStore& RenderCommands() const;
 
-	// Linked list of render commands
-	// Memory freed automatically
-	std::vector<std::shared_ptr<RenderCommand>> RenderCommands() const;
+	// Primitives of the render commands by location, for rendering part of
+	// the level.
+	const SpatialIndex& Index() const;
 
-	// Forms a single area out of the various line and arc segments in the 
-	// layer, typically used to obtain a solid board from an outline.
-	void ConvertStrokesToFills();
+	// The coarsest simplified commands whose tolerance (in mm) is at most the
+	// given one, or nullptr if even the finest is too coarse. Tolerances are
+	// kDetailTolerance times powers of four.
+	static constexpr double kDetailTolerance = 0.01;
+	const LevelOfDetail* Detail(double tolerance) const;
+
+	// This level with its line and arc segments formed into a single area,
+	// typically used to obtain a solid board from an outline. Computed on
+	// first use, once, even when several threads render at the same time.
+	const GerberLevel& Fills() const;
 
-	bool IsCopyLayer();
+	bool IsCopyLayer() const;
 };
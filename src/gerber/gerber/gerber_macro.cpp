@@ -7,18 +7,12 @@ constexpr double kPi = 3.141592653589793238463;
 
 
 GerberMacro::GerberMacro() {
-	Primitives = 0;
-	PrimitivesLast = 0;
-	Modifiers = 0;
 	Inches = true;
-	exposure_ = true;
-	NewModifiers = false;
+	Quiet = false;
 }
 
 
 GerberMacro::~GerberMacro() {
-	if (Primitives) delete   Primitives;
-	if (NewModifiers) delete[] Modifiers;
 }
 
 
@@ -42,7 +36,6 @@ GerberMacro::PRIMITIVE_ITEM::PRIMITIVE_ITEM() {
 	Modifier = 0;
 	ModifierCount = 0;
 	Index = 0;
-	Next = 0;
 }
 
 
@@ -51,52 +44,127 @@ GerberMacro::PRIMITIVE_ITEM::~PRIMITIVE_ITEM() {
 	for (j = 0; j < ModifierCount; j++) {
 		if (Modifier[j]) delete Modifier[j];
 	}
+	delete[] Modifier;
+}
+
 
-	if (Next) delete Next; // Hopefully this is a short list :-)
+void GerberMacro::RENDER_STATE::Add(std::shared_ptr<RenderCommand> render) {
+	Output->push_back(std::move(render));
 }
 
 
-void GerberMacro::Add(std::shared_ptr<RenderCommand> Render) {
-	render_commands_.push_back(Render);
+void GerberMacro::Evaluate(const PRIMITIVE_PROGRAM* Primitive, const RENDER_STATE& state, double* Modifier, int count) const {
+	double stack[kMaxStack];
+	int    top = -1;
+
+	for (int j = 0; j < count; j++) {
+		Modifier[j] = 0.0;
+	}
+
+	const auto* end = program_.data() + Primitive->Last;
+	for (const auto* i = program_.data() + Primitive->First; i != end; ++i) {
+		switch (i->Operator) {
+		case opAdd:
+			top--;
+			stack[top] += stack[top + 1];
+			break;
+
+		case opSubtract:
+			top--;
+			stack[top] -= stack[top + 1];
+			break;
+
+		case opMultiply:
+			top--;
+			stack[top] *= stack[top + 1];
+			break;
+
+		case opDivide:
+			top--;
+			stack[top] /= stack[top + 1];
+			break;
+
+		case opVariable:
+			stack[++top] = (i->Index > 0 && i->Index <= state.ModifierCount) ? state.Modifiers[i->Index - 1] : 0.0;
+			break;
+
+		case opLiteral:
+			stack[++top] = i->Value;
+			break;
+
+		case opStore:
+			if (i->Index < count) {
+				Modifier[i->Index] = stack[top];
+			}
+			top--;
+			break;
+		}
+	}
 }
 
 
-double GerberMacro::Evaluate(OPERATOR_ITEM* Root) {
-	double left, right;
+// Replaces every subtree without variables by its value. The arithmetic is
+// done exactly as Evaluate would do it, so the results are unchanged.
+void GerberMacro::Fold(OPERATOR_ITEM* Root) {
+	if (!Root || Root->Operator == opVariable || Root->Operator == opLiteral) return;
 
-	if (!Root) return 0.0;
+	Fold(Root->left_);
+	Fold(Root->right_);
 
-	switch (Root->Operator) {
-	case opAdd:
-		return Evaluate(Root->left_) + Evaluate(Root->right_);
+	const auto* left = Root->left_;
+	const auto* right = Root->right_;
+	if (!left || !right || left->Operator != opLiteral || right->Operator != opLiteral) return;
 
-	case opSubtract:
-		return Evaluate(Root->left_) - Evaluate(Root->right_);
+	double value;
+	switch (Root->Operator) {
+	case opAdd:      value = left->Value + right->Value; break;
+	case opSubtract: value = left->Value - right->Value; break;
+	case opMultiply: value = left->Value * right->Value; break;
+	case opDivide:   value = left->Value / right->Value; break;
+	default: return;
+	}
+
+	delete Root->left_;
+	delete Root->right_;
+	Root->left_ = Root->right_ = 0;
+	Root->Operator = opLiteral;
+	Root->Value = value;
+}
 
-	case opMultiply:
-		return Evaluate(Root->left_) * Evaluate(Root->right_);
 
-	case opDivide:
-		return Evaluate(Root->left_) / Evaluate(Root->right_);
+// Appends the postfix form of the tree to program_
+bool GerberMacro::Compile(const OPERATOR_ITEM* Root, int depth) {
+	if (depth >= kMaxStack) {
+		LOG_IF(ERROR, !Quiet) << "Error: Macro expression too deeply nested";
+		return false;
+	}
 
+	switch (Root->Operator) {
 	case opVariable:
-		if (Root->Index > 0 && Root->Index <= ModifierCount) {
-			return Modifiers[Root->Index - 1];
-		}
-		else {
-			return 0.0;
-		}
+		program_.push_back({ opVariable, Root->Index, 0.0 });
+		return true;
 
 	case opLiteral:
-		return Root->Value;
+		program_.push_back({ opLiteral, 0, Root->Value });
+		return true;
 
 	default:
-		return 0.0;
+		break;
+	}
+
+	// A missing operand (a syntax error) evaluates to zero
+	OPERATOR_ITEM zero;
+	if (!Compile(Root->left_ ? Root->left_ : &zero, depth) ||
+		!Compile(Root->right_ ? Root->right_ : &zero, depth + 1)) {
+		return false;
 	}
+
+	program_.push_back({ Root->Operator, 0, 0.0 });
+	return true;
 }
 
 
-double GerberMacro::Get_mm(double number) {
+double GerberMacro::Get_mm(double number) const {
 	if (Inches)
 		number *= 25.4;
 
@@ -110,8 +178,9 @@ void GerberMacro::RenderLine(
 	double x3, double y3,
 	double x4, double y4,
 	double xR, double yR,
-	double A
-) {
+	double A,
+	RENDER_STATE& state
+) const {
 	double r, a;
 
 	// Translate to center
@@ -149,49 +218,42 @@ void GerberMacro::RenderLine(
 	auto render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
 	render->X = Get_mm(x1);
 	render->Y = Get_mm(y1);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 	render->X = Get_mm(x2);
 	render->Y = Get_mm(y2);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 	render->X = Get_mm(x3);
 	render->Y = Get_mm(y3);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 	render->X = Get_mm(x4);
 	render->Y = Get_mm(y4);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcClose);
-	Add(render);
+	state.Add(render);
 }
 
 
-bool GerberMacro::RenderCircle(PRIMITIVE_ITEM* Primitive) {
+bool GerberMacro::RenderCircle(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const {
 	constexpr int modifier_cnt = 5;
 	double modifier[modifier_cnt];
 
-	for (int j = 0; j < modifier_cnt; j++) {
-		if (j < Primitive->ModifierCount) {
-			modifier[j] = Evaluate(Primitive->Modifier[j]);
-		}
-		else {
-			modifier[j] = 0.0;
-		}
-	}
+	Evaluate(Primitive, state, modifier, modifier_cnt);
 
 	if (modifier[0] == 0.0) {
-		exposure_ = false;
+		state.exposure_ = false;
 	}
 	else if (modifier[0] == 1.0) {
-		exposure_ = true;
+		state.exposure_ = true;
 	}
 	else {
-		exposure_ = !exposure_;
+		state.exposure_ = !state.exposure_;
 	}
 
 	double d = modifier[1];
@@ -205,10 +267,10 @@ bool GerberMacro::RenderCircle(PRIMITIVE_ITEM* Primitive) {
 	render->X = Get_mm(c * x - s * y);
 	render->Y = Get_mm(s * x + c * y);
 	render->W = Get_mm(d);
-	Add(render);
+	state.Add(render);
 
 	RenderCommand::GerberCommand cmd;
-	if (exposure_) {
+	if (state.exposure_) {
 		cmd = RenderCommand::gcFill;
 	}
 	else {
@@ -216,33 +278,26 @@ bool GerberMacro::RenderCircle(PRIMITIVE_ITEM* Primitive) {
 	}
 	render = std::make_shared<RenderCommand>(cmd);
 
-	Add(render);
+	state.Add(render);
 
 	return true;
 }
 
 
-bool GerberMacro::RenderLineVector(PRIMITIVE_ITEM* Primitive) {
+bool GerberMacro::RenderLineVector(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const {
 	constexpr int modifier_count = 7;
 	double modifier[modifier_count];
 
-	for (int j = 0; j < modifier_count; j++) {
-		if (j < Primitive->ModifierCount) {
-			modifier[j] = Evaluate(Primitive->Modifier[j]);
-		}
-		else {
-			modifier[j] = 0.0;
-		}
-	}
+	Evaluate(Primitive, state, modifier, modifier_count);
 
 	if (modifier[0] == 0.0) {
-		exposure_ = false;
+		state.exposure_ = false;
 	}
 	else if (modifier[0] == 1.0) {
-		exposure_ = true;
+		state.exposure_ = true;
 	}
 	else {
-		exposure_ = !exposure_;
+		state.exposure_ = !state.exposure_;
 	}
 
 	double w, a; // Width; Angle
@@ -300,61 +355,54 @@ bool GerberMacro::RenderLineVector(PRIMITIVE_ITEM* Primitive) {
 	auto render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
 	render->X = Get_mm(x4);
 	render->Y = Get_mm(y4);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 	render->X = Get_mm(x5);
 	render->Y = Get_mm(y5);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 	render->X = Get_mm(x6);
 	render->Y = Get_mm(y6);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 	render->X = Get_mm(x7);
 	render->Y = Get_mm(y7);
-	Add(render);
+	state.Add(render);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcClose);
-	Add(render);
+	state.Add(render);
 
 	RenderCommand::GerberCommand cmd;
-	if (exposure_) {
+	if (state.exposure_) {
 		cmd = RenderCommand::gcFill;
 	}
 	else {
 		cmd = RenderCommand::gcErase;
 	}
 	render = std::make_shared<RenderCommand>(cmd);
-	Add(render);
+	state.Add(render);
 
 	return true;
 }
 
 
-bool GerberMacro::RenderLineCenter(PRIMITIVE_ITEM* Primitive) {
+bool GerberMacro::RenderLineCenter(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const {
 	constexpr int modifier_count = 6;
 	double modifier[modifier_count];
 
-	for (int j = 0; j < modifier_count; j++) {
-		if (j < Primitive->ModifierCount) {
-			modifier[j] = Evaluate(Primitive->Modifier[j]);
-		}
-		else {
-			modifier[j] = 0.0;
-		}
-	}
+	Evaluate(Primitive, state, modifier, modifier_count);
 
 	if (modifier[0] == 0.0) {
-		exposure_ = false;
+		state.exposure_ = false;
 	}
 	else if (modifier[0] == 1.0) {
-		exposure_ = true;
+		state.exposure_ = true;
 	}
 	else {
-		exposure_ = !exposure_;
+		state.exposure_ = !state.exposure_;
 	}
 
 	double a; // Rotation
@@ -385,43 +433,36 @@ bool GerberMacro::RenderLineCenter(PRIMITIVE_ITEM* Primitive) {
 	x4 = x0 - w;
 	y4 = y0 + h;
 
-	RenderLine(x1, y1, x2, y2, x3, y3, x4, y4, 0, 0, a);
+	RenderLine(x1, y1, x2, y2, x3, y3, x4, y4, 0, 0, a, state);
 
 	RenderCommand::GerberCommand cmd;
-	if (exposure_) {
+	if (state.exposure_) {
 		cmd = RenderCommand::gcFill;
 	}
 	else {
 		cmd = RenderCommand::gcErase;
 	}
 	auto render = std::make_shared<RenderCommand>(cmd);
-	Add(render);
+	state.Add(render);
 
 	return true;
 }
 
 
-bool GerberMacro::RenderLineLowerLeft(PRIMITIVE_ITEM* primitive) {
+bool GerberMacro::RenderLineLowerLeft(const PRIMITIVE_PROGRAM* primitive, RENDER_STATE& state) const {
 	constexpr int modifier_count = 6;
 	double modifier[modifier_count];
 
-	for (int j = 0; j < modifier_count; j++) {
-		if (j < primitive->ModifierCount) {
-			modifier[j] = Evaluate(primitive->Modifier[j]);
-		}
-		else {
-			modifier[j] = 0.0;
-		}
-	}
+	Evaluate(primitive, state, modifier, modifier_count);
 
 	if (modifier[0] == 0.0) {
-		exposure_ = false;
+		state.exposure_ = false;
 	}
 	else if (modifier[0] == 1.0) {
-		exposure_ = true;
+		state.exposure_ = true;
 	}
 	else {
-		exposure_ = !exposure_;
+		state.exposure_ = !state.exposure_;
 	}
 
 	double a; // Rotation
@@ -446,40 +487,38 @@ bool GerberMacro::RenderLineLowerLeft(PRIMITIVE_ITEM* primitive) {
 	x4 = x1;
 	y4 = y1 + h;
 
-	RenderLine(x1, y1, x2, y2, x3, y3, x4, y4, 0, 0, a);
+	RenderLine(x1, y1, x2, y2, x3, y3, x4, y4, 0, 0, a, state);
 
 	RenderCommand::GerberCommand cmd;
-	if (exposure_) {
+	if (state.exposure_) {
 		cmd = RenderCommand::gcFill;
 	}
 	else {
 		cmd = RenderCommand::gcErase;
 	}
 	auto render = std::make_shared<RenderCommand>(cmd);
-	Add(render);
+	state.Add(render);
 
 	return true;
 }
 
 
-bool GerberMacro::RenderOutline(PRIMITIVE_ITEM* Primitive) {
+bool GerberMacro::RenderOutline(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const {
 	std::shared_ptr<RenderCommand> render;
 
 	const int modifier_count = Primitive->ModifierCount;
 	double* modifier = new double[modifier_count];
 
-	for (int j = 0; j < modifier_count; j++) {
-		modifier[j] = Evaluate(Primitive->Modifier[j]);
-	}
+	Evaluate(Primitive, state, modifier, modifier_count);
 
 	if (modifier[0] == 0.0) {
-		exposure_ = false;
+		state.exposure_ = false;
 	}
 	else if (modifier[0] == 1.0) {
-		exposure_ = true;
+		state.exposure_ = true;
 	}
 	else {
-		exposure_ = !exposure_;
+		state.exposure_ = !state.exposure_;
 	}
 
 	int N = (modifier_count - 5.0) / 2.0 + 1.0; // Total number of points
@@ -526,13 +565,13 @@ bool GerberMacro::RenderOutline(PRIMITIVE_ITEM* Primitive) {
 		render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
 		render->X = Get_mm(x[0]);
 		render->Y = Get_mm(y[0]);
-		Add(render);
+		state.Add(render);
 
 		for (int j = 1; j < N - 1; j++) {
 			render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 			render->X = Get_mm(x[j]);
 			render->Y = Get_mm(y[j]);
-			Add(render);
+			state.Add(render);
 		}
 
 	}
@@ -540,28 +579,28 @@ bool GerberMacro::RenderOutline(PRIMITIVE_ITEM* Primitive) {
 		render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
 		render->X = Get_mm(x[N - 1]);
 		render->Y = Get_mm(y[N - 1]);
-		Add(render);
+		state.Add(render);
 
 		for (int j = N - 2; j > 0; j--) {
 			render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 			render->X = Get_mm(x[j]);
 			render->Y = Get_mm(y[j]);
-			Add(render);
+			state.Add(render);
 		}
 	}
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcClose);
-	Add(render);
+	state.Add(render);
 
 	RenderCommand::GerberCommand cmd;
-	if (exposure_) {
+	if (state.exposure_) {
 		cmd = RenderCommand::gcFill;
 	}
 	else {
 		cmd = RenderCommand::gcErase;
 	}
 	render = std::make_shared<RenderCommand>(cmd);
-	Add(render);
+	state.Add(render);
 
 	delete[] x;
 	delete[] y;
@@ -571,27 +610,20 @@ bool GerberMacro::RenderOutline(PRIMITIVE_ITEM* Primitive) {
 }
 
 
-bool GerberMacro::RenderPolygon(PRIMITIVE_ITEM* primitive) {
+bool GerberMacro::RenderPolygon(const PRIMITIVE_PROGRAM* primitive, RENDER_STATE& state) const {
 	const int modifier_count = 6;
 	double modifier[modifier_count];
 
-	for (int j = 0; j < modifier_count; j++) {
-		if (j < primitive->ModifierCount) {
-			modifier[j] = Evaluate(primitive->Modifier[j]);
-		}
-		else {
-			modifier[j] = 0.0;
-		}
-	}
+	Evaluate(primitive, state, modifier, modifier_count);
 
 	if (modifier[0] == 0.0) {
-		exposure_ = false;
+		state.exposure_ = false;
 	}
 	else if (modifier[0] == 1.0) {
-		exposure_ = true;
+		state.exposure_ = true;
 	}
 	else {
-		exposure_ = !exposure_;
+		state.exposure_ = !state.exposure_;
 	}
 
 	int     N;
@@ -624,27 +656,27 @@ bool GerberMacro::RenderPolygon(PRIMITIVE_ITEM* primitive) {
 	auto render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
 	render->X = Get_mm(x[0]);
 	render->Y = Get_mm(y[0]);
-	Add(render);
+	state.Add(render);
 
 	for (int j = 1; j < N; j++) {
 		render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 		render->X = Get_mm(x[j]);
 		render->Y = Get_mm(y[j]);
-		Add(render);
+		state.Add(render);
 	}
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcClose);
-	Add(render);
+	state.Add(render);
 
 	RenderCommand::GerberCommand cmd;
-	if (exposure_) {
+	if (state.exposure_) {
 		cmd = RenderCommand::gcFill;
 	}
 	else {
 		cmd = RenderCommand::gcErase;
 	}
 	render = std::make_shared<RenderCommand>(cmd);
-	Add(render);
+	state.Add(render);
 
 	delete[] x;
 	delete[] y;
@@ -653,20 +685,13 @@ bool GerberMacro::RenderPolygon(PRIMITIVE_ITEM* primitive) {
 }
 
 
-bool GerberMacro::RenderMoire(PRIMITIVE_ITEM* primitive) {
+bool GerberMacro::RenderMoire(const PRIMITIVE_PROGRAM* primitive, RENDER_STATE& state) const {
 	std::shared_ptr<RenderCommand> render;
 
 	const int modifier_count = 9;
 	double modifier[modifier_count];
 
-	for (int j = 0; j < modifier_count; j++) {
-		if (j < primitive->ModifierCount) {
-			modifier[j] = Evaluate(primitive->Modifier[j]);
-		}
-		else {
-			modifier[j] = 0.0;
-		}
-	}
+	Evaluate(primitive, state, modifier, modifier_count);
 
 	auto X = modifier[0];
 	auto Y = modifier[1];
@@ -687,19 +712,19 @@ bool GerberMacro::RenderMoire(PRIMITIVE_ITEM* primitive) {
 		render->X = Get_mm(X);
 		render->Y = Get_mm(Y);
 		render->W = Get_mm(d);
-		Add(render);
+		state.Add(render);
 
 		d -= thickness * 2.0;
 		if (d < width) break;
 		render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
 		render->X = Get_mm(X + d / 2.0);
 		render->Y = Get_mm(Y);
-		Add(render);
+		state.Add(render);
 		render = std::make_shared<RenderCommand>(RenderCommand::gcArc);
 		render->X = Get_mm(X);
 		render->Y = Get_mm(Y);
 		render->A = -360.0;
-		Add(render);
+		state.Add(render);
 
 		d -= gap * 2.0;
 	}
@@ -722,7 +747,8 @@ bool GerberMacro::RenderMoire(PRIMITIVE_ITEM* primitive) {
 		X + x3, Y + y3,
 		X + x4, Y + y4,
 		X, Y,
-		rotation
+		rotation,
+		state
 	);
 	RenderLine(
 		X + x1, Y + y1,
@@ -730,30 +756,24 @@ bool GerberMacro::RenderMoire(PRIMITIVE_ITEM* primitive) {
 		X + x3, Y + y3,
 		X + x4, Y + y4,
 		X, Y,
-		rotation + kPi / 2.0
+		rotation + kPi / 2.0,
+		state
 	);
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcFill);
-	Add(render);
+	state.Add(render);
 
 	return true;
 }
 
 
-bool GerberMacro::RenderThermal(PRIMITIVE_ITEM* Primitive) {
+bool GerberMacro::RenderThermal(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const {
 	std::shared_ptr<RenderCommand> render;
 
 	const int ModifierCount = 6;
 	double Modifier[ModifierCount];
 
-	for (int j = 0; j < ModifierCount; j++) {
-		if (j < Primitive->ModifierCount) {
-			Modifier[j] = Evaluate(Primitive->Modifier[j]);
-		}
-		else {
-			Modifier[j] = 0.0;
-		}
-	}
+	Evaluate(Primitive, state, Modifier, ModifierCount);
 
 	double X, Y;
 	double OD;
@@ -803,27 +823,27 @@ bool GerberMacro::RenderThermal(PRIMITIVE_ITEM* Primitive) {
 		render = std::make_shared<RenderCommand>(RenderCommand::gcBeginLine);
 		render->X = Get_mm(X + x1);
 		render->Y = Get_mm(Y + y1);
-		Add(render);
+		state.Add(render);
 
 		render = std::make_shared<RenderCommand>(RenderCommand::gcArc);
 		render->X = Get_mm(X);
 		render->Y = Get_mm(Y);
 		render->A = a1;
-		Add(render);
+		state.Add(render);
 
 		render = std::make_shared<RenderCommand>(RenderCommand::gcLine);
 		render->X = Get_mm(X + x2);
 		render->Y = Get_mm(Y + y2);
-		Add(render);
+		state.Add(render);
 
 		render = std::make_shared<RenderCommand>(RenderCommand::gcArc);
 		render->X = Get_mm(X);
 		render->Y = Get_mm(Y);
 		render->A = -a2;
-		Add(render);
+		state.Add(render);
 
 		render = std::make_shared<RenderCommand>(RenderCommand::gcClose);
-		Add(render);
+		state.Add(render);
 
 		// Rotate 90 deg
 		t = x1;
@@ -835,112 +855,128 @@ bool GerberMacro::RenderThermal(PRIMITIVE_ITEM* Primitive) {
 	}
 
 	render = std::make_shared<RenderCommand>(RenderCommand::gcFill);
-	Add(render);
+	state.Add(render);
 
 	return true;
 }
 
 
-bool GerberMacro::RenderAssignment(PRIMITIVE_ITEM* Primitive) {
-	int     j, t;
-	double* Temp;
-
+bool GerberMacro::RenderAssignment(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const {
 	if (Primitive->ModifierCount < 1) return false;
+	if (Primitive->Index < 1) return false;
 
-	if (Primitive->Index > ModifierCount) {
-		t = ModifierCount;
-		ModifierCount = Primitive->Index;
-
-		Temp = new double[ModifierCount];
-		for (j = 0; j < t; j++) {
-			Temp[j] = Modifiers[j];
-		}
-		for (; j < ModifierCount; j++) {
-			Temp[j] = 0.0;
-		}
+	double value;
+	Evaluate(Primitive, state, &value, 1);
 
-		if (NewModifiers) delete[] Modifiers;
-		Modifiers = Temp;
-		NewModifiers = true;
+	// The caller's modifiers are read-only, so assign into a copy
+	if (state.Modifiers != state.Variables.data()) {
+		state.Variables.assign(state.Modifiers, state.Modifiers + state.ModifierCount);
+	}
+	if (Primitive->Index > static_cast<int>(state.Variables.size())) {
+		state.Variables.resize(Primitive->Index, 0.0);
 	}
+	state.Variables[Primitive->Index - 1] = value;
 
-	Modifiers[Primitive->Index - 1] = Evaluate(Primitive->Modifier[0]);
+	state.Modifiers = state.Variables.data();
+	state.ModifierCount = static_cast<int>(state.Variables.size());
 
 	return true;
 }
 
 
-std::vector<std::shared_ptr<RenderCommand>> GerberMacro::Render(double* Modifiers, int ModifierCount) {
-	render_commands_.clear();
-	if (NewModifiers) delete[] GerberMacro::Modifiers;
-	NewModifiers = false;
-
-	exposure_ = true;
-
-	GerberMacro::Modifiers = Modifiers;
-	GerberMacro::ModifierCount = ModifierCount;
-
-	PRIMITIVE_ITEM* Primitive = Primitives;
-	while (Primitive) {
+bool GerberMacro::Render(
+	const double* modifiers,
+	int modifier_count,
+	std::vector<std::shared_ptr<RenderCommand>>& output
+) const {
+	RENDER_STATE state;
+	state.Output = &output;
+	state.Modifiers = modifiers;
+	state.ModifierCount = modifier_count;
+	state.exposure_ = true;
+
+	const auto size = output.size();
+	for (const auto& each : primitives_) {
+		const auto* Primitive = &each;
+		bool result = true;
 		switch (Primitive->Primitive) {
 		case pCircle:
-			if (!RenderCircle(Primitive)) return {};
+			result = RenderCircle(Primitive, state);
 			break;
 
 		case pLineVector:
 		case pLineVector2:
-			if (!RenderLineVector(Primitive)) return {};
+			result = RenderLineVector(Primitive, state);
 			break;
 
 		case pLineCenter:
-			if (!RenderLineCenter(Primitive)) return {};
+			result = RenderLineCenter(Primitive, state);
 			break;
 
 		case pLineLowerLeft:
-			if (!RenderLineLowerLeft(Primitive)) return {};
+			result = RenderLineLowerLeft(Primitive, state);
 			break;
 
 		case pOutline:
-			if (!RenderOutline(Primitive)) return {};
+			result = RenderOutline(Primitive, state);
 			break;
 
 		case pPolygon:
-			if (!RenderPolygon(Primitive)) return {};
+			result = RenderPolygon(Primitive, state);
 			break;
 
 		case pMoire:
-			if (!RenderMoire(Primitive)) return {};
+			result = RenderMoire(Primitive, state);
 			break;
 
 		case pThermal:
-			if (!RenderThermal(Primitive)) return {};
+			result = RenderThermal(Primitive, state);
 			break;
 
 		case pAssignment:
-			if (!RenderAssignment(Primitive)) return {};
+			result = RenderAssignment(Primitive, state);
 			break;
 
 		default:
 			break;
 		}
-		Primitive = Primitive->Next;
+
+		if (!result) {
+			output.resize(size);
+			return false;
+		}
 	}
 
-	return render_commands_;
+	return true;
 }
 
 
-void GerberMacro::Add(PRIMITIVE_ITEM* Primitive) {
-	if (!Primitive) return;
+bool GerberMacro::Add(PRIMITIVE_ITEM* Primitive) {
+	if (!Primitive) return false;
 
-	if (Primitives) {
-		PrimitivesLast->Next = Primitive;
-	}
-	else {
-		Primitives = Primitive;
+	PRIMITIVE_PROGRAM compiled;
+	compiled.Primitive = Primitive->Primitive;
+	compiled.ModifierCount = Primitive->ModifierCount;
+	compiled.Index = Primitive->Index;
+	compiled.First = static_cast<int>(program_.size());
+
+	for (int j = 0; j < Primitive->ModifierCount; j++) {
+		if (!Primitive->Modifier[j]) continue; // Missing modifiers are zero
+
+		Fold(Primitive->Modifier[j]);
+		if (!Compile(Primitive->Modifier[j], 0)) {
+			program_.resize(compiled.First);
+			delete Primitive;
+			return false;
+		}
+		program_.push_back({ opStore, j, 0.0 });
 	}
 
-	PrimitivesLast = Primitive;
+	compiled.Last = static_cast<int>(program_.size());
+	primitives_.push_back(compiled);
+
+	delete Primitive;
+	return true;
 }
 
 
@@ -1147,14 +1183,14 @@ GerberMacro::OPERATOR_ITEM* GerberMacro::Factor() {
 
 		Item = Modifier();
 		if (!Item) {
-			LOG(ERROR) << "Error: Expression expected";
+			LOG_IF(ERROR, !Quiet) << "Error: Expression expected";
 			return 0;
 		}
 
 		SkipWhiteSpace();
 
 		if (Buffer[Index] != ')') {
-			LOG(ERROR) << "Error: ')' expected";
+			LOG_IF(ERROR, !Quiet) << "Error: ')' expected";
 			delete Item;
 			return 0;
 		}
@@ -1165,7 +1201,7 @@ GerberMacro::OPERATOR_ITEM* GerberMacro::Factor() {
 		Item = Variable();
 		if (!Item) {
 			if (!Float(&d)) {
-				LOG(ERROR) << "Error: Float expected";
+				LOG_IF(ERROR, !Quiet) << "Error: Float expected";
 				return 0;
 			}
 			Item = new OPERATOR_ITEM;
@@ -1255,9 +1291,7 @@ bool GerberMacro::Circle() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1294,9 +1328,7 @@ bool GerberMacro::Line_Vector() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1333,9 +1365,7 @@ bool GerberMacro::Line_Center() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1372,9 +1402,7 @@ bool GerberMacro::Line_LowerLeft() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1397,7 +1425,7 @@ bool GerberMacro::Outline() {
 	SkipWhiteSpace();
 
 	if (!Integer(&exposure_)) {
-		LOG(ERROR) << "Error: Integer exposure expected";
+		LOG_IF(ERROR, !Quiet) << "Error: Integer exposure expected";
 		return false;
 	}
 
@@ -1410,7 +1438,7 @@ bool GerberMacro::Outline() {
 	SkipWhiteSpace();
 
 	if (!Integer(&N)) {
-		LOG(ERROR) << "Error: Integer number of outline points expected";
+		LOG_IF(ERROR, !Quiet) << "Error: Integer number of outline points expected";
 		return false;
 	}
 
@@ -1447,9 +1475,7 @@ bool GerberMacro::Outline() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1484,9 +1510,7 @@ bool GerberMacro::Polygon() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1521,9 +1545,7 @@ bool GerberMacro::Moire() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1558,9 +1580,7 @@ bool GerberMacro::Thermal() {
 		SkipWhiteSpace();
 	}
 
-	Add(Item);
-
-	return b;
+	return Add(Item) && b;
 }
 
 
@@ -1591,9 +1611,7 @@ bool GerberMacro::Assignment() {
 
 	SkipWhiteSpace();
 
-	Add(Item);
-
-	return true;
+	return Add(Item);
 }
 
 
@@ -1610,7 +1628,7 @@ bool GerberMacro::Primitive() {
 			Identifier = pAssignment;
 		}
 		else {
-			LOG(ERROR) << "Error: Macro primitive expected";
+			LOG_IF(ERROR, !Quiet) << "Error: Macro primitive expected";
 			return false;
 		}
 	};
@@ -1651,19 +1669,21 @@ bool GerberMacro::Primitive() {
 		return Assignment();
 
 	default:
-		LOG(ERROR) << "Error: Unknown Macro Primitive: " << Buffer[Index];
+		LOG_IF(ERROR, !Quiet) << "Error: Unknown Macro Primitive: " << Buffer[Index];
 		return false;
 	}
 
-	LOG(ERROR) << "Error: End of block expected";
+	LOG_IF(ERROR, !Quiet) << "Error: End of block expected";
 	return false;
 }
 
 
-bool GerberMacro::LoadMacro(const char* buffer, unsigned Length, bool Inches) {
-	GerberMacro::Buffer = buffer;
+bool GerberMacro::LoadMacro(const char* buffer, unsigned Length, bool Inches, bool Quiet) {
+	// The source is a view into the file and is not null-terminated.
+	GerberMacro::Buffer.assign(buffer, Length);
 	GerberMacro::Length = Length;
 	GerberMacro::Inches = Inches;
+	GerberMacro::Quiet = Quiet;
 	GerberMacro::Index = 0;
 
 	if (!Primitive())         return false;
@@ -31,7 +31,8 @@ private:
 		opDivide,
 
 		opVariable,
-		opLiteral
+		opLiteral,
+		opStore
 	};
 
 	struct OPERATOR_ITEM {
@@ -48,26 +49,57 @@ private:
 		~OPERATOR_ITEM();
 	};
 
+	// Parse tree of a primitive, compiled by Add and then discarded
 	struct PRIMITIVE_ITEM {
 		PRIMITIVE       Primitive;
 		OPERATOR_ITEM** Modifier; // Modifier Tree for each modifier in the array
 		int             ModifierCount;
 		int             Index;    // Used for assignment primitives
 
-		PRIMITIVE_ITEM* Next;
-
 		PRIMITIVE_ITEM();
 		~PRIMITIVE_ITEM();
 	};
-	PRIMITIVE_ITEM* Primitives;
-	PRIMITIVE_ITEM* PrimitivesLast;
-	void Add(PRIMITIVE_ITEM* Primitive);
 
-	std::vector<std::shared_ptr<RenderCommand>> render_commands_;
+	// One postfix step: literals and variables push, arithmetic pops two
+	// and pushes one, and a store pops into modifier Index of the primitive.
+	struct INSTRUCTION {
+		OPERATOR Operator;
+		int      Index;
+		double   Value;
+	};
+
+	// A primitive whose modifiers are computed by program_[First, Last)
+	struct PRIMITIVE_PROGRAM {
+		PRIMITIVE Primitive;
+		int       ModifierCount;
+		int       Index; // Used for assignment primitives
+		int       First;
+		int       Last;
+	};
+
+	// Deepest evaluation stack a compiled modifier may need
+	static constexpr int kMaxStack = 64;
+
+	std::vector<PRIMITIVE_PROGRAM> primitives_;
+	std::vector<INSTRUCTION> program_;
+	bool Add(PRIMITIVE_ITEM* Primitive);
 
-	void Add(std::shared_ptr<RenderCommand> Render);
+	static void Fold(OPERATOR_ITEM* Root);
+	bool Compile(const OPERATOR_ITEM* Root, int depth);
 
-	double Evaluate(OPERATOR_ITEM* Root);
+	// Everything a single Render call writes, so that the macro stays const
+	struct RENDER_STATE {
+		std::vector<std::shared_ptr<RenderCommand>>* Output;
+
+		const double*       Modifiers;
+		int                 ModifierCount;
+		std::vector<double> Variables; // Modifiers, once a primitive assigns one
+		bool                exposure_;
+
+		void Add(std::shared_ptr<RenderCommand> render);
+	};
+
+	void Evaluate(const PRIMITIVE_PROGRAM* Primitive, const RENDER_STATE& state, double* Modifier, int count) const;
 
 	void RenderLine(
 		double x1, double y1,
@@ -75,30 +107,27 @@ private:
 		double x3, double y3,
 		double x4, double y4,
 		double xR, double yR, // Rotation Center
-		double A
-	);
-
-	bool RenderCircle(PRIMITIVE_ITEM* Primitive);
-	bool RenderLineVector(PRIMITIVE_ITEM* Primitive);
-	bool RenderLineCenter(PRIMITIVE_ITEM* Primitive);
-	bool RenderLineLowerLeft(PRIMITIVE_ITEM* Primitive);
-	bool RenderOutline(PRIMITIVE_ITEM* Primitive);
-	bool RenderPolygon(PRIMITIVE_ITEM* Primitive);
-	bool RenderMoire(PRIMITIVE_ITEM* Primitive);
-	bool RenderThermal(PRIMITIVE_ITEM* Primitive);
-	bool RenderAssignment(PRIMITIVE_ITEM* Primitive);
-
-	double* Modifiers;
-	int     ModifierCount;
-	bool    NewModifiers;
-	bool    exposure_;
+		double A,
+		RENDER_STATE& state
+	) const;
+
+	bool RenderCircle(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderLineVector(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderLineCenter(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderLineLowerLeft(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderOutline(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderPolygon(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderMoire(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderThermal(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
+	bool RenderAssignment(const PRIMITIVE_PROGRAM* Primitive, RENDER_STATE& state) const;
 
 	std::string Buffer;
 	unsigned Length;
 	unsigned Index;
 	bool Inches;
+	bool Quiet; // No errors are logged
 
-	double Get_mm(double Number);
+	double Get_mm(double Number) const;
 
 	bool Float(double* Number);
 	bool Integer(int* Integer);
@@ -127,9 +156,15 @@ public:
 
 	std::string Name;
 
-	// Modifiers is a null-terminated array
-	// Returns a new list of render commands => The user must free the memory
-	std::vector<std::shared_ptr<RenderCommand>> Render(double* Modifiers, int ModifierCount);
-
-	bool LoadMacro(const char* buffer, unsigned Length, bool Inches);
+	// Appends the commands for the given modifiers to output. Rendering does
+	// not change the macro, so one macro may be rendered by several threads.
+	// Returns false, leaving output as it was, if a primitive is invalid.
+	bool Render(
+		const double* modifiers,
+		int modifier_count,
+		std::vector<std::shared_ptr<RenderCommand>>& output
+	) const;
+
+	// Quiet suppresses the errors, for a definition that has already been checked.
+	bool LoadMacro(const char* buffer, unsigned Length, bool Inches, bool Quiet = false);
 };
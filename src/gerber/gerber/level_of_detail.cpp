@@ -0,0 +1,254 @@
+#include "level_of_detail.h"
+#include "gerber_aperture.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+constexpr double kPi = 3.141592653589793238463;
+
+
+namespace {
+
+// Squared distance from p to the segment a-b
+template <typename POINT>
+double Distance2(const POINT& p, const POINT& a, const POINT& b) {
+	const auto dx = b.x_ - a.x_, dy = b.y_ - a.y_;
+	const auto length2 = dx * dx + dy * dy;
+	auto t = length2 > 0.0 ? ((p.x_ - a.x_) * dx + (p.y_ - a.y_) * dy) / length2 : 0.0;
+	t = std::clamp(t, 0.0, 1.0);
+
+	const auto x = a.x_ + t * dx - p.x_, y = a.y_ + t * dy - p.y_;
+	return x * x + y * y;
+}
+
+template <typename POINT>
+double Area(const std::vector<POINT>& contour) {
+	double area = 0.0;
+	for (std::size_t i = 0, j = contour.size() - 1; i < contour.size(); j = i++) {
+		area += (contour[j].x_ + contour[i].x_) * (contour[j].y_ - contour[i].y_);
+	}
+	return std::fabs(area) / 2.0;
+}
+
+}
+
+LevelOfDetail::LevelOfDetail(const CommandStore& commands, double tolerance) :
+	tolerance_(tolerance) {
+	double width = 0.0, height = 0.0; // Of the selected aperture
+	bool outline = false;
+
+	// The current path, and the contours of the current region before its fill
+	std::vector<POINT> path;
+	bool closed = false;
+	std::vector<std::vector<POINT>> contours;
+	std::vector<bool> closes;
+
+	auto end_contour = [&]() {
+		if (!path.empty()) {
+			contours.push_back(std::move(path));
+			closes.push_back(closed);
+			path.clear();
+		}
+		closed = false;
+	};
+
+	for (const auto& command : commands) {
+		switch (command.command_) {
+		case RenderCommand::gcApertureSelect:
+			width = height = 0.0;
+			if (command.aperture_) {
+				width = command.aperture_->right_ - command.aperture_->left_;
+				height = command.aperture_->top_ - command.aperture_->bottom_;
+			}
+			commands_.Add(command);
+			break;
+
+		case RenderCommand::gcBeginOutline:
+		case RenderCommand::gcEndOutline:
+			outline = command.command_ == RenderCommand::gcBeginOutline;
+			commands_.Add(command);
+			break;
+
+		case RenderCommand::gcBeginLine:
+			if (outline) {
+				end_contour();
+			}
+			path.clear();
+			path.push_back({ command.X, command.Y });
+			break;
+
+		case RenderCommand::gcLine:
+			path.push_back({ command.X, command.Y });
+			break;
+
+		case RenderCommand::gcArc:
+			Flatten(command, path);
+			break;
+
+		case RenderCommand::gcClose:
+			closed = true;
+			break;
+
+		case RenderCommand::gcStroke:
+			AddStroke(path, command, width, height);
+			path.clear();
+			closed = false;
+			break;
+
+		case RenderCommand::gcFill: {
+			end_contour();
+
+			std::vector<POINT> points;
+			for (const auto& contour : contours) {
+				points.insert(points.end(), contour.begin(), contour.end());
+			}
+
+			if (!AddDot(points, 0.0, 0.0)) {
+				bool filled = false;
+				for (std::size_t i = 0; i < contours.size(); i++) {
+					if (Area(contours[i]) < 4.0 * tolerance_ * tolerance_) {
+						continue;
+					}
+
+					Simplify(contours[i]);
+					AddPath(contours[i]);
+					if (closes[i]) {
+						commands_.Add(RenderCommand(RenderCommand::gcClose));
+					}
+					filled = true;
+				}
+
+				if (filled) {
+					commands_.Add(command);
+				}
+			}
+
+			contours.clear();
+			closes.clear();
+			break;
+		}
+
+		case RenderCommand::gcFlash:
+			if (!AddDot({ { command.X, command.Y } }, width, height)) {
+				commands_.Add(command);
+			}
+			break;
+
+		default:
+			commands_.Add(command);
+			break;
+		}
+	}
+
+	index_.Build(commands_);
+}
+
+void LevelOfDetail::Flatten(const RenderCommand& arc, std::vector<POINT>& path) const {
+	if (path.empty()) {
+		path.push_back({ arc.End.X, arc.End.Y });
+		return;
+	}
+
+	const auto start_x = path.back().x_ - arc.X;
+	const auto start_y = path.back().y_ - arc.Y;
+	const auto radius = std::hypot(start_x, start_y);
+	const auto sweep = arc.A * kPi / 180.0;
+
+	// Chords of this angle are within half the tolerance of the circle
+	if (radius > tolerance_ / 2.0) {
+		const auto step = 2.0 * std::acos(1.0 - tolerance_ / 2.0 / radius);
+		const auto segments = static_cast<int>(std::clamp(std::ceil(std::fabs(sweep) / step), 1.0, 1024.0));
+		const auto start = std::atan2(start_y, start_x);
+		for (int i = 1; i < segments; i++) {
+			const auto angle = start + sweep * i / segments;
+			path.push_back({ arc.X + radius * std::cos(angle), arc.Y + radius * std::sin(angle) });
+		}
+	}
+
+	path.push_back({ arc.End.X, arc.End.Y });
+}
+
+void LevelOfDetail::Simplify(std::vector<POINT>& path) const {
+	if (path.size() < 3) {
+		return;
+	}
+
+	const auto limit = tolerance_ * tolerance_ / 4.0;
+	std::vector<bool> keep(path.size(), false);
+	keep.front() = keep.back() = true;
+
+	std::vector<std::pair<std::size_t, std::size_t>> spans{ { 0, path.size() - 1 } };
+	while (!spans.empty()) {
+		const auto [first, last] = spans.back();
+		spans.pop_back();
+
+		double farthest = limit;
+		std::size_t split = 0;
+		for (auto i = first + 1; i < last; i++) {
+			const auto distance = Distance2(path[i], path[first], path[last]);
+			if (distance > farthest) {
+				farthest = distance;
+				split = i;
+			}
+		}
+
+		if (split) {
+			keep[split] = true;
+			spans.push_back({ first, split });
+			spans.push_back({ split, last });
+		}
+	}
+
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < path.size(); i++) {
+		if (keep[i]) {
+			path[kept++] = path[i];
+		}
+	}
+	path.resize(kept);
+}
+
+void LevelOfDetail::AddPath(const std::vector<POINT>& path) {
+	for (std::size_t i = 0; i < path.size(); i++) {
+		RenderCommand render(i ? RenderCommand::gcLine : RenderCommand::gcBeginLine);
+		render.End.X = render.X = path[i].x_;
+		render.End.Y = render.Y = path[i].y_;
+		commands_.Add(render);
+	}
+}
+
+void LevelOfDetail::AddStroke(std::vector<POINT>& path, const RenderCommand& stroke, double width, double height) {
+	if (AddDot(path, width, height)) {
+		return;
+	}
+
+	Simplify(path);
+	AddPath(path);
+	commands_.Add(stroke);
+}
+
+bool LevelOfDetail::AddDot(const std::vector<POINT>& points, double width, double height) {
+	if (points.empty()) {
+		return false;
+	}
+
+	auto left = points.front().x_, right = left;
+	auto bottom = points.front().y_, top = bottom;
+	for (const auto& point : points) {
+		left = std::min(left, point.x_);
+		right = std::max(right, point.x_);
+		bottom = std::min(bottom, point.y_);
+		top = std::max(top, point.y_);
+	}
+
+	if (right - left + width > 2.0 * tolerance_ || top - bottom + height > 2.0 * tolerance_) {
+		return false;
+	}
+
+	RenderCommand dot(RenderCommand::gcDot);
+	dot.End.X = dot.X = (left + right) / 2.0;
+	dot.End.Y = dot.Y = (bottom + top) / 2.0;
+	commands_.Add(dot);
+	return true;
+}
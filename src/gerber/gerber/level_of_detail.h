@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include "command_store.h"
+#include "spatial_index.h"
+
+
+// The render commands of a level simplified for display at a coarse scale,
+// where nothing within the tolerance (in mm) can be told apart:
+//  - arcs become polylines, and polylines drop points that are within the
+//    tolerance of the line between their neighbours
+//  - flashes and paths no larger than twice the tolerance become gcDot
+//  - region contours with less area than that are dropped
+// The commands come with their own spatial index.
+class LevelOfDetail {
+public:
+	LevelOfDetail(const CommandStore& commands, double tolerance);
+
+	double Tolerance() const { return tolerance_; }
+	const CommandStore& RenderCommands() const { return commands_; }
+	const SpatialIndex& Index() const { return index_; }
+
+private:
+	struct POINT {
+		double x_, y_;
+	};
+
+	// Adds the points of an arc from the last point in path.
+	void Flatten(const RenderCommand& arc, std::vector<POINT>& path) const;
+	// Douglas-Peucker, keeping the first and last point.
+	void Simplify(std::vector<POINT>& path) const;
+
+	void AddPath(const std::vector<POINT>& path);
+	void AddStroke(std::vector<POINT>& path, const RenderCommand& stroke, double width, double height);
+	// Adds a gcDot in the middle of the points, or returns false if they do
+	// not fit in a pixel.
+	bool AddDot(const std::vector<POINT>& points, double width, double height);
+
+	double tolerance_;
+	CommandStore commands_;
+	SpatialIndex index_;
+};
@@ -1,41 +1,59 @@
 #include "plotter.h"
 #include "gerber/gerber_level.h"
 #include "gerber/gerber_aperture.h"
+#include "gerber_file.h"
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <cmath>
+
 constexpr double kPi = 3.141592653589793238463;
 
 Plotter::Plotter(GerberLevel& level) :level_(level) {
 
 }
 
+void Plotter::CopyState(const Plotter& other) {
+	outline_fill_ = other.outline_fill_;
+	in_path_ = other.in_path_;
+	preX = other.preX;
+	preY = other.preY;
+	firstX = other.firstX;
+	firstY = other.firstY;
+	current_aperture = other.current_aperture;
+}
+
 
-void Plotter::OutlineBegin(unsigned line_number) {
+void Plotter::OutlineBegin(const GerberFile& file) {
 	level_.exposure_ = geOff;
-	Move(line_number);
-	level_.AddNew(RenderCommand::gcBeginOutline);
+	Move(file);
+	if (level_.plot_) {
+		level_.AddNew(RenderCommand::gcBeginOutline);
+	}
 	outline_fill_ = true;
 }
 
-void Plotter::OutlineEnd(unsigned line_number) {
+void Plotter::OutlineEnd(const GerberFile& file) {
 	level_.exposure_ = geOff;
-	Move(line_number);
-	level_.AddNew(RenderCommand::gcEndOutline);
+	Move(file);
+	if (level_.plot_) {
+		level_.AddNew(RenderCommand::gcEndOutline);
+	}
 	outline_fill_ = false;
 }
 
-void Plotter::Do(unsigned line_number) {
+void Plotter::Do(const GerberFile& file) {
 	switch (level_.exposure_) {
 	case geOn:
 		Line();
 		break;
 
 	case geOff:
-		Move(line_number);
+		Move(file);
 		break;
 
 	case geFlash:
-		Move(line_number);
+		Move(file);
 		Flash();
 		level_.exposure_ = geOff;
 		break;
@@ -47,34 +65,42 @@ void Plotter::Do(unsigned line_number) {
 	level_.I = level_.J = 0.0;
 }
 
-void Plotter::ApertureSelect(std::shared_ptr<GerberAperture> aperture, unsigned line_number) {
+void Plotter::ApertureSelect(std::shared_ptr<GerberAperture> aperture, const GerberFile& file) {
 	level_.exposure_ = geOff;
-	Move(line_number);
+	Move(file);
 
-	auto tmp = level_.AddNew(RenderCommand::gcApertureSelect);
-	tmp->aperture_ = aperture;
+	if (level_.plot_) {
+		RenderCommand tmp(RenderCommand::gcApertureSelect);
+		tmp.aperture_ = aperture;
+		level_.Add(tmp);
+	}
 	current_aperture = aperture;
 }
 
 
-void Plotter::Move(unsigned line_number) {
-	if (in_path_) {
+void Plotter::Move(const GerberFile& file) {
+	// Also found while only scanning, which tracks the path as well
+	const auto open = in_path_ && outline_fill_ && (firstX != preX || firstY != preY);
+	if (open && gerber_warnings && !file.quiet_) {
+		LOG(WARNING) << "Line " << file.LineNumber() << " - Warning: Deprecated feature: Open contours";
+	}
+
+	if (in_path_ && level_.plot_) {
 		if (outline_fill_) {
-			if (firstX != preX || firstY != preY) {
-				if (gerber_warnings) {
-					LOG(WARNING) << "Line " << line_number << " - Warning: Deprecated feature: Open contours";
-				}
+			if (open) {
 				level_.AddNew(RenderCommand::gcClose);
 			}
-			auto tmp = level_.AddNew(RenderCommand::gcFill);
-			tmp->End.X = preX;
-			tmp->End.Y = preY;
+			RenderCommand tmp(RenderCommand::gcFill);
+			tmp.End.X = preX;
+			tmp.End.Y = preY;
+			level_.Add(tmp);
 
 		}
 		else {
-			auto tmp = level_.AddNew(RenderCommand::gcStroke);
-			tmp->End.X = preX;
-			tmp->End.Y = preY;
+			RenderCommand tmp(RenderCommand::gcStroke);
+			tmp.End.X = preX;
+			tmp.End.Y = preY;
+			level_.Add(tmp);
 		}
 	}
 
@@ -87,6 +113,13 @@ void Plotter::Move(unsigned line_number) {
 }
 
 void Plotter::Line() {
+	if (!level_.plot_) {
+		in_path_ = true;
+		preX = Get_mm(level_.X);
+		preY = Get_mm(level_.Y);
+		return;
+	}
+
 	if (!in_path_) {
 		if (current_aperture && !outline_fill_) {
 			level_.bound_box_.UpdateBox(
@@ -99,9 +132,10 @@ void Plotter::Line() {
 			level_.bound_box_.UpdateBox(preX, preX, preY, preY);
 		}
 
-		auto tmp = level_.AddNew(RenderCommand::gcBeginLine);
-		tmp->End.X = tmp->X = preX;
-		tmp->End.Y = tmp->Y = preY;
+		RenderCommand tmp(RenderCommand::gcBeginLine);
+		tmp.End.X = tmp.X = preX;
+		tmp.End.Y = tmp.Y = preY;
+		level_.Add(tmp);
 	}
 	else {
 		if (
@@ -113,27 +147,31 @@ void Plotter::Line() {
 
 	switch (level_.interpolation_) {
 	case giLinear: {
-		auto tmp = level_.AddNew(RenderCommand::gcLine);
-		tmp->End.X = tmp->X = Get_mm(level_.X);
-		tmp->End.Y = tmp->Y = Get_mm(level_.Y);
+		RenderCommand tmp(RenderCommand::gcLine);
+		tmp.End.X = tmp.X = Get_mm(level_.X);
+		tmp.End.Y = tmp.Y = Get_mm(level_.Y);
+		level_.Add(tmp);
 		break;
 	}
 	case giLinear10X: {
-		auto tmp = level_.AddNew(RenderCommand::gcLine);
-		tmp->End.X = tmp->X = Get_mm(level_.X) * 10.0;
-		tmp->End.Y = tmp->Y = Get_mm(level_.Y) * 10.0;
+		RenderCommand tmp(RenderCommand::gcLine);
+		tmp.End.X = tmp.X = Get_mm(level_.X) * 10.0;
+		tmp.End.Y = tmp.Y = Get_mm(level_.Y) * 10.0;
+		level_.Add(tmp);
 		break;
 	}
 	case giLinear0_1X: {
-		auto tmp = level_.AddNew(RenderCommand::gcLine);
-		tmp->End.X = tmp->X = Get_mm(level_.X) * 0.1;
-		tmp->End.Y = tmp->Y = Get_mm(level_.Y) * 0.1;
+		RenderCommand tmp(RenderCommand::gcLine);
+		tmp.End.X = tmp.X = Get_mm(level_.X) * 0.1;
+		tmp.End.Y = tmp.Y = Get_mm(level_.Y) * 0.1;
+		level_.Add(tmp);
 		break;
 	}
 	case giLinear0_01X: {
-		auto tmp = level_.AddNew(RenderCommand::gcLine);
-		tmp->End.X = tmp->X = Get_mm(level_.X) * 0.01;
-		tmp->End.Y = tmp->Y = Get_mm(level_.Y) * 0.01;
+		RenderCommand tmp(RenderCommand::gcLine);
+		tmp.End.X = tmp.X = Get_mm(level_.X) * 0.01;
+		tmp.End.Y = tmp.Y = Get_mm(level_.Y) * 0.01;
+		level_.Add(tmp);
 		break;
 	}
 	case giClockwiseCircular:
@@ -221,41 +259,61 @@ void Plotter::Arc() {
 
 	const auto angle = GetAngle(x1, y1, x2, y2);
 
-	auto tmp = level_.AddNew(RenderCommand::gcArc);
-	tmp->X = x3;
-	tmp->Y = y3;
-	tmp->A = angle;
-	tmp->End.X = preX = Get_mm(level_.X);
-	tmp->End.Y = preY = Get_mm(level_.Y);
+	RenderCommand tmp(RenderCommand::gcArc);
+	tmp.X = x3;
+	tmp.Y = y3;
+	tmp.A = angle;
+	tmp.End.X = preX = Get_mm(level_.X);
+	tmp.End.Y = preY = Get_mm(level_.Y);
+	level_.Add(tmp);
 
 	auto r = x3 + x1;
 	auto t = y3 + y1;
 	auto l = r;
 	auto b = t;
 
-	auto d = atan2(y1, x1);
+	// The extent is that of kArcSamples points stepped along the arc. Every
+	// sample angle is accumulated the same way, but since x and y only peak
+	// where the circle crosses an axis, the points themselves are evaluated
+	// at both ends and next to those crossings only.
+	constexpr int kArcSamples = 1000;
+
 	const auto rad = sqrt(x1 * x1 + y1 * y1); // Radius
 	const auto dd = angle * kPi / 180e3;
-	for (int j = 0; j < 1000; ++j) {
-		const auto x = x3 + rad * cos(d);
-		const auto y = y3 + rad * sin(d);
-		if (l > x)
-		{
-			l = x;
-		}
 
-		if (b > y) {
-			b = y;
-		}
+	double angles[kArcSamples];
+	auto d = atan2(y1, x1);
+	for (auto& a : angles) {
+		a = d;
+		d += dd;
+	}
 
-		if (r < x) {
-			r = x;
+	auto sample = [&](int j) {
+		const auto x = x3 + rad * cos(angles[j]);
+		const auto y = y3 + rad * sin(angles[j]);
+		if (l > x) l = x;
+		if (b > y) b = y;
+		if (r < x) r = x;
+		if (t < y) t = y;
+	};
+
+	if (fabs(dd) < 1e-9) { // Too short to locate the crossings by index
+		for (int j = 0; j < kArcSamples; ++j) {
+			sample(j);
 		}
-		if (t < y) {
-			t = y;
+	}
+	else {
+		sample(0);
+		sample(kArcSamples - 1);
+
+		const auto low = std::min(angles[0], angles[kArcSamples - 1]);
+		const auto high = std::max(angles[0], angles[kArcSamples - 1]);
+		for (auto axis = std::ceil(low / (kPi / 2.0)) * (kPi / 2.0); axis <= high; axis += kPi / 2.0) {
+			const auto index = static_cast<int>(std::floor((axis - angles[0]) / dd));
+			for (int j = std::max(index - 2, 0); j <= std::min(index + 3, kArcSamples - 1); ++j) {
+				sample(j);
+			}
 		}
-
-		d += dd;
 	}
 
 	if (current_aperture && !outline_fill_) {
@@ -269,9 +327,14 @@ void Plotter::Arc() {
 }
 
 void Plotter::Flash() {
-	auto tmp = level_.AddNew(RenderCommand::gcFlash);
-	tmp->X = preX;
-	tmp->Y = preY;
+	if (!level_.plot_) {
+		return;
+	}
+
+	RenderCommand tmp(RenderCommand::gcFlash);
+	tmp.X = preX;
+	tmp.Y = preY;
+	level_.Add(tmp);
 
 	if (current_aperture) {
 		level_.bound_box_.UpdateBox(
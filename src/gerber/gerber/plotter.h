@@ -3,15 +3,18 @@
 
 class GerberLevel;
 class GerberAperture;
+class GerberFile;
 
 class Plotter {
 public:
 	Plotter(GerberLevel& level);
 
-	void OutlineBegin(unsigned line_number);
-	void OutlineEnd(unsigned line_number);
-	void Do(unsigned LineNumber);
-	void ApertureSelect(std::shared_ptr<GerberAperture> aperture_, unsigned LineNumber);
+	void CopyState(const Plotter& other);
+
+	void OutlineBegin(const GerberFile& file);
+	void OutlineEnd(const GerberFile& file);
+	void Do(const GerberFile& file);
+	void ApertureSelect(std::shared_ptr<GerberAperture> aperture_, const GerberFile& file);
 
 	void SetInPath(bool in_path) {
 		in_path_ = in_path;
@@ -46,7 +49,7 @@ public:
 	}
 
 private:
-	void Move(unsigned LineNumber);
+	void Move(const GerberFile& file);
 	void Line();
 	void Arc();
 	void Flash();
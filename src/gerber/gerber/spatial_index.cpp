@@ -0,0 +1,359 @@
+#include "spatial_index.h"
+#include "command_store.h"
+#include "gerber_aperture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+constexpr double kPi = 3.141592653589793238463;
+
+
+namespace {
+
+// Rounded outwards, so that the float box still holds the double one
+float Down(double value) {
+	auto result = static_cast<float>(value);
+	return result > value ? std::nextafter(result, -std::numeric_limits<float>::infinity()) : result;
+}
+
+float Up(double value) {
+	auto result = static_cast<float>(value);
+	return result < value ? std::nextafter(result, std::numeric_limits<float>::infinity()) : result;
+}
+
+struct EXTENT {
+	double left_ = INFINITY, bottom_ = INFINITY, right_ = -INFINITY, top_ = -INFINITY;
+
+	void Add(double x, double y) {
+		left_ = std::min(left_, x);
+		bottom_ = std::min(bottom_, y);
+		right_ = std::max(right_, x);
+		top_ = std::max(top_, y);
+	}
+
+	// From (x, y) around the center by the given angle, counterclockwise if
+	// positive. The end point is added as well, in case it is a little off
+	// the circle.
+	void AddArc(double x, double y, const RenderCommand& arc) {
+		Add(x, y);
+		Add(arc.End.X, arc.End.Y);
+
+		const auto radius = std::hypot(x - arc.X, y - arc.Y);
+		const auto start = std::atan2(y - arc.Y, x - arc.X);
+		const auto end = start + arc.A * kPi / 180.0;
+		const auto low = std::min(start, end);
+		const auto high = std::max(start, end);
+
+		// The extremes are where the circle crosses an axis
+		for (auto quarter = std::ceil(low / (kPi / 2.0)); quarter * (kPi / 2.0) <= high; quarter++) {
+			switch (static_cast<int>(quarter) & 3) {
+			case 0: Add(arc.X + radius, arc.Y); break;
+			case 1: Add(arc.X, arc.Y + radius); break;
+			case 2: Add(arc.X - radius, arc.Y); break;
+			default: Add(arc.X, arc.Y - radius); break;
+			}
+		}
+	}
+};
+
+}
+
+bool SpatialIndex::Build(const CommandStore& commands) {
+	Clear();
+	if (commands.size() >= kNone) {
+		return false;
+	}
+
+	auto select = kNone;
+	auto outline = kNone;
+	const GerberAperture* aperture = nullptr;
+
+	bool open = false;
+	PRIMITIVE primitive{};
+	EXTENT extent;
+	double x = 0.0, y = 0.0;
+
+	auto begin = [&](std::uint32_t index) {
+		if (!open) {
+			open = true;
+			primitive = PRIMITIVE{};
+			primitive.first_ = index;
+			primitive.last_ = index;
+			primitive.select_ = select;
+			primitive.outline_ = outline;
+			extent = EXTENT();
+		}
+	};
+
+	auto end = [&](std::uint32_t last) {
+		if (extent.left_ > extent.right_) { // Nothing drawn, keep it somewhere
+			extent.Add(x, y);
+		}
+		if (aperture && outline == kNone) {
+			extent.left_ += aperture->left_;
+			extent.bottom_ += aperture->bottom_;
+			extent.right_ += aperture->right_;
+			extent.top_ += aperture->top_;
+		}
+
+		primitive.last_ = last;
+		primitive.left_ = Down(extent.left_);
+		primitive.bottom_ = Down(extent.bottom_);
+		primitive.right_ = Up(extent.right_);
+		primitive.top_ = Up(extent.top_);
+		primitives_.push_back(primitive);
+		open = false;
+	};
+
+	std::uint32_t index = 0;
+	for (const auto& command : commands) {
+		switch (command.command_) {
+		case RenderCommand::gcApertureSelect:
+		case RenderCommand::gcBeginOutline:
+		case RenderCommand::gcEndOutline:
+			if (open) {
+				Clear();
+				return false;
+			}
+
+			if (command.command_ == RenderCommand::gcApertureSelect) {
+				select = index;
+				aperture = command.aperture_.get();
+			}
+			else {
+				outline = command.command_ == RenderCommand::gcBeginOutline ? index : kNone;
+			}
+			break;
+
+		case RenderCommand::gcBeginLine:
+		case RenderCommand::gcLine:
+			begin(index);
+			x = command.X;
+			y = command.Y;
+			extent.Add(x, y);
+			break;
+
+		case RenderCommand::gcArc:
+			begin(index);
+			extent.AddArc(x, y, command);
+			x = command.End.X;
+			y = command.End.Y;
+			break;
+
+		case RenderCommand::gcClose:
+			begin(index);
+			break;
+
+		case RenderCommand::gcStroke:
+		case RenderCommand::gcFill:
+			begin(index);
+			end(index + 1);
+			break;
+
+		case RenderCommand::gcFlash:
+		case RenderCommand::gcDot:
+			begin(index);
+			x = command.X;
+			y = command.Y;
+			extent.Add(x, y);
+			end(index + 1);
+			break;
+
+		default: // Aperture primitives, not expected in a level
+			Clear();
+			return false;
+		}
+		index++;
+	}
+
+	if (open) {
+		end(index);
+	}
+
+	BuildGrid();
+	valid_ = true;
+	return true;
+}
+
+void SpatialIndex::Clear() {
+	valid_ = false;
+	primitives_.clear();
+	columns_ = rows_ = 0;
+	cell_start_.clear();
+	cell_items_.clear();
+	large_.clear();
+
+	mapping_.reset();
+	view_ = VIEW{};
+}
+
+int SpatialIndex::CellX(double x) const {
+	const auto cell = std::floor((x - left_) / cell_width_);
+	return cell < 0.0 ? 0 : cell >= columns_ ? columns_ - 1 : static_cast<int>(cell);
+}
+
+int SpatialIndex::CellY(double y) const {
+	const auto cell = std::floor((y - bottom_) / cell_height_);
+	return cell < 0.0 ? 0 : cell >= rows_ ? rows_ - 1 : static_cast<int>(cell);
+}
+
+void SpatialIndex::BuildGrid() {
+	if (primitives_.empty()) {
+		return;
+	}
+
+	left_ = bottom_ = INFINITY;
+	right_ = top_ = -INFINITY;
+	for (const auto& primitive : primitives_) {
+		left_ = std::min<double>(left_, primitive.left_);
+		bottom_ = std::min<double>(bottom_, primitive.bottom_);
+		right_ = std::max<double>(right_, primitive.right_);
+		top_ = std::max<double>(top_, primitive.top_);
+	}
+
+	// About two primitives per cell, in cells that are roughly square
+	constexpr int kMaxSide = 4096;
+	const auto cells = std::max<double>(1.0, primitives_.size() / 2.0);
+	const auto width = std::max(right_ - left_, 1e-6);
+	const auto height = std::max(top_ - bottom_, 1e-6);
+	columns_ = static_cast<int>(std::clamp(std::round(std::sqrt(cells * width / height)), 1.0, double(kMaxSide)));
+	rows_ = static_cast<int>(std::clamp(std::round(cells / columns_), 1.0, double(kMaxSide)));
+	cell_width_ = width / columns_;
+	cell_height_ = height / rows_;
+
+	// Counted first, so that every cell is a slice of one array
+	cell_start_.assign(static_cast<std::size_t>(columns_) * rows_ + 1, 0);
+	auto each_cell = [&](const PRIMITIVE& primitive, auto&& action) {
+		const auto x0 = CellX(primitive.left_), x1 = CellX(primitive.right_);
+		const auto y0 = CellY(primitive.bottom_), y1 = CellY(primitive.top_);
+		if ((x1 - x0 + 1) * (y1 - y0 + 1) > kMaxCells) {
+			return false;
+		}
+		for (auto cy = y0; cy <= y1; cy++) {
+			for (auto cx = x0; cx <= x1; cx++) {
+				action(static_cast<std::size_t>(cy) * columns_ + cx);
+			}
+		}
+		return true;
+	};
+
+	for (std::uint32_t i = 0; i < primitives_.size(); i++) {
+		if (!each_cell(primitives_[i], [&](std::size_t cell) { cell_start_[cell + 1]++; })) {
+			large_.push_back(i);
+		}
+	}
+	for (std::size_t cell = 1; cell < cell_start_.size(); cell++) {
+		cell_start_[cell] += cell_start_[cell - 1];
+	}
+
+	cell_items_.resize(cell_start_.back());
+	auto fill = cell_start_;
+	for (std::uint32_t i = 0; i < primitives_.size(); i++) {
+		each_cell(primitives_[i], [&](std::size_t cell) { cell_items_[fill[cell]++] = i; });
+	}
+}
+
+SpatialIndex::VIEW SpatialIndex::View() const {
+	if (mapping_) {
+		return view_;
+	}
+
+	return { primitives_.data(), cell_start_.data(), cell_items_.data(), large_.data(),
+		primitives_.size(), cell_start_.size(), cell_items_.size(), large_.size() };
+}
+
+bool SpatialIndex::Consistent(std::size_t command_count) const {
+	const auto view = View();
+	for (std::size_t i = 0; i < view.primitive_count_; i++) {
+		const auto& primitive = view.primitives_[i];
+		if (primitive.first_ > primitive.last_ || primitive.last_ > command_count ||
+			(primitive.select_ != kNone && primitive.select_ >= command_count) ||
+			(primitive.outline_ != kNone && primitive.outline_ >= command_count)) {
+			return false;
+		}
+	}
+
+	if (!view.primitive_count_) {
+		return true; // Queries stop before the grid
+	}
+
+	// CellX and CellY divide by the cell size and convert the result to int
+	if (columns_ <= 0 || rows_ <= 0 ||
+		!std::isfinite(left_) || !std::isfinite(bottom_) ||
+		!(cell_width_ > 0.0) || !(cell_height_ > 0.0) || !std::isfinite(cell_width_) || !std::isfinite(cell_height_) ||
+		view.cell_start_count_ != static_cast<std::size_t>(columns_) * rows_ + 1) {
+		return false;
+	}
+
+	for (std::size_t cell = 0; cell + 1 < view.cell_start_count_; cell++) {
+		if (view.cell_start_[cell] > view.cell_start_[cell + 1]) {
+			return false;
+		}
+	}
+	if (view.cell_start_[view.cell_start_count_ - 1] > view.cell_item_count_) {
+		return false;
+	}
+
+	for (std::size_t i = 0; i < view.cell_item_count_; i++) {
+		if (view.cell_items_[i] >= view.primitive_count_) {
+			return false;
+		}
+	}
+	for (std::size_t i = 0; i < view.large_count_; i++) {
+		if (view.large_[i] >= view.primitive_count_) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void SpatialIndex::Query(const BoundBox& region, std::vector<std::uint32_t>& result) const {
+	const auto view = View();
+	if (!view.primitive_count_ ||
+		region.Left() > right_ || region.Right() < left_ ||
+		region.Bottom() > top_ || region.Top() < bottom_) {
+		return;
+	}
+
+	auto intersects = [&](const PRIMITIVE& primitive) {
+		return primitive.left_ <= region.Right() && primitive.right_ >= region.Left() &&
+			primitive.bottom_ <= region.Top() && primitive.top_ >= region.Bottom();
+	};
+
+	const auto first = result.size();
+	if (region.Left() <= left_ && region.Right() >= right_ && region.Bottom() <= bottom_ && region.Top() >= top_) {
+		for (std::uint32_t i = 0; i < view.primitive_count_; i++) {
+			result.push_back(i);
+		}
+		return;
+	}
+
+	// A primitive in several cells is only reported by the cell holding the
+	// bottom left corner of its overlap with the region.
+	const auto x0 = CellX(region.Left()), x1 = CellX(region.Right());
+	const auto y0 = CellY(region.Bottom()), y1 = CellY(region.Top());
+	for (auto cy = y0; cy <= y1; cy++) {
+		for (auto cx = x0; cx <= x1; cx++) {
+			const auto cell = static_cast<std::size_t>(cy) * columns_ + cx;
+			for (auto item = view.cell_start_[cell]; item < view.cell_start_[cell + 1]; item++) {
+				const auto& primitive = view.primitives_[view.cell_items_[item]];
+				if (intersects(primitive) &&
+					CellX(std::max<double>(primitive.left_, region.Left())) == cx &&
+					CellY(std::max<double>(primitive.bottom_, region.Bottom())) == cy) {
+					result.push_back(view.cell_items_[item]);
+				}
+			}
+		}
+	}
+
+	for (std::size_t i = 0; i < view.large_count_; i++) {
+		if (intersects(view.primitives_[view.large_[i]])) {
+			result.push_back(view.large_[i]);
+		}
+	}
+
+	std::sort(result.begin() + first, result.end());
+}
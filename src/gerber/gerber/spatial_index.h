@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bound_box.h"
+
+class CommandStore;
+
+
+// Splits the render commands of a level into primitives, each a flash or a
+// path up to its stroke or fill, and keeps their bounding boxes, including
+// the aperture, in a uniform grid. A query returns the primitives that may
+// be visible in a region in painting order, along with the aperture select
+// and outline each of them is drawn in.
+// An index loaded from a cache file views its arrays in the mapping of the
+// file.
+class SpatialIndex {
+public:
+	static constexpr std::uint32_t kNone = UINT32_MAX;
+
+	struct PRIMITIVE {
+		std::uint32_t first_, last_; // Command range, last exclusive
+		std::uint32_t select_;       // The aperture select in effect, or kNone
+		std::uint32_t outline_;      // The gcBeginOutline in effect, or kNone
+		float left_, bottom_, right_, top_;
+	};
+
+	// False, leaving the index empty, if the commands do not split into
+	// primitives, such as when an aperture is selected in the middle of a
+	// path. Every command then has to be rendered.
+	bool Build(const CommandStore& commands);
+	void Clear();
+	bool Valid() const { return valid_; }
+
+	// Appends the primitives whose box intersects the region, in increasing
+	// order, which is the order they are painted in.
+	void Query(const BoundBox& region, std::vector<std::uint32_t>& result) const;
+
+	std::size_t size() const { return mapping_ ? view_.primitive_count_ : primitives_.size(); }
+	const PRIMITIVE& operator[](std::size_t index) const { return Primitives()[index]; }
+
+private:
+	friend class GerberCache;
+
+	// Primitives spanning more cells than this are kept in large_ instead.
+	static constexpr int kMaxCells = 16;
+
+	void BuildGrid();
+	int CellX(double x) const;
+	int CellY(double y) const;
+
+	bool valid_{ false };
+	std::vector<PRIMITIVE> primitives_;
+
+	// Cell (x, y) holds cell_items_[cell_start_[i]] up to cell_start_[i + 1],
+	// where i = y * columns_ + x.
+	double left_{ 0.0 }, bottom_{ 0.0 }, right_{ 0.0 }, top_{ 0.0 };
+	double cell_width_{ 1.0 }, cell_height_{ 1.0 };
+	int columns_{ 0 }, rows_{ 0 };
+	std::vector<std::uint32_t> cell_start_;
+	std::vector<std::uint32_t> cell_items_;
+	std::vector<std::uint32_t> large_;
+
+	// Set when the arrays are a view into a mapped cache file, which this
+	// keeps open; the vectors are empty then.
+	struct VIEW {
+		const PRIMITIVE* primitives_;
+		const std::uint32_t* cell_start_;
+		const std::uint32_t* cell_items_;
+		const std::uint32_t* large_;
+		std::size_t primitive_count_, cell_start_count_, cell_item_count_, large_count_;
+	};
+	std::shared_ptr<const void> mapping_;
+	VIEW view_{};
+
+	const PRIMITIVE* Primitives() const { return mapping_ ? view_.primitives_ : primitives_.data(); }
+	// The arrays in use, whether viewed or in the vectors
+	VIEW View() const;
+	// Whether arrays read from elsewhere stay within themselves and within
+	// command_count commands; queries and rendering trust them.
+	bool Consistent(std::size_t command_count) const;
+};
@@ -0,0 +1,587 @@
+#include "gerber_cache.h"
+#include "gerber.h"
+#include "mapped_file.h"
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+// "GBRC" in the byte order of the machine that wrote the file.
+constexpr std::uint32_t kMagic = 0x43524247;
+
+constexpr std::uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+constexpr std::uint64_t kFnvPrime = 0x100000001b3ull;
+
+// All records are multiples of 8 bytes, so every record and every double in
+// a mapped cache file is naturally aligned.
+struct HEADER {
+	std::uint32_t magic_;
+	std::uint32_t version_;
+	std::uint64_t source_hash_;
+	std::uint32_t units_;
+	std::uint32_t negative_;
+	// Coordinate format, which PackCommands needs again
+	std::uint8_t x_integer_, x_decimal_, y_integer_, y_decimal_;
+	std::uint32_t omit_trailing_zeroes_;
+	std::uint32_t aperture_count_;
+	std::uint32_t level_count_;
+	std::uint64_t name_size_;
+};
+
+struct APERTURE {
+	std::int32_t code_;
+	std::int32_t type_;
+	std::int32_t side_count_;
+	std::uint32_t command_count_; // Macro apertures only, the others are rendered on demand
+	double dimension_x_, dimension_y_;
+	double hole_x_, hole_y_;
+	double rotation_;
+	double left_, bottom_, right_, top_;
+};
+
+struct LEVEL {
+	std::int32_t count_x_, count_y_;
+	double step_x_, step_y_;
+	double left_, right_, top_, bottom_;
+	double x_, y_, i_, j_;
+	std::uint8_t negative_, relative_, incremental_, multi_quadrant_;
+	std::uint32_t units_;
+	std::uint32_t exposure_;
+	std::uint32_t interpolation_;
+	std::uint64_t name_size_;
+};
+
+// The render commands of a level in the packed form of CommandStore.
+// Followed by the codes of the apertures they select, the byte stream, its
+// checkpoints and the extras, which are used in place once loaded.
+struct COMMANDS {
+	std::uint64_t size_;
+	std::uint64_t aperture_count_;
+	std::uint64_t byte_count_;
+	std::uint64_t checkpoint_count_;
+	std::uint64_t extra_count_;
+	double x_divisor_, y_divisor_, scale_;
+	std::int64_t last_x_, last_y_;
+};
+
+// The spatial index of a level. Followed by its primitives, cell starts,
+// cell items and large primitives, which are used in place once loaded.
+struct INDEX {
+	std::uint32_t valid_;
+	std::int32_t columns_, rows_;
+	std::uint32_t padding_;
+	double left_, bottom_, right_, top_;
+	double cell_width_, cell_height_;
+	std::uint64_t primitive_count_;
+	std::uint64_t cell_start_count_;
+	std::uint64_t cell_item_count_;
+	std::uint64_t large_count_;
+};
+
+// A render command of a macro aperture
+struct COMMAND {
+	std::int32_t command_;
+	std::int32_t aperture_; // Code of the selected aperture, -1 for none
+	double x_, y_, w_, h_, a_;
+	double end_x_, end_y_;
+};
+
+static_assert(sizeof(HEADER) % 8 == 0 && sizeof(APERTURE) % 8 == 0 && sizeof(LEVEL) % 8 == 0 &&
+	sizeof(COMMANDS) % 8 == 0 && sizeof(INDEX) % 8 == 0 && sizeof(COMMAND) % 8 == 0, "Cache records must keep 8-byte alignment");
+
+std::size_t Padded(std::size_t size) {
+	return (size + 7) & ~std::size_t(7);
+}
+
+class Writer {
+public:
+	template <typename Record>
+	void Add(const Record& record) {
+		auto bytes = reinterpret_cast<const char*>(&record);
+		data_.insert(data_.end(), bytes, bytes + sizeof(record));
+	}
+
+	void Add(const std::string& text) {
+		data_.insert(data_.end(), text.begin(), text.end());
+		data_.resize(Padded(data_.size()));
+	}
+
+	template <typename Item>
+	void Add(const Item* items, std::size_t count) {
+		auto bytes = reinterpret_cast<const char*>(items);
+		data_.insert(data_.end(), bytes, bytes + count * sizeof(Item));
+		data_.resize(Padded(data_.size()));
+	}
+
+	void Add(const RenderCommand& render) {
+		COMMAND command{};
+		command.command_ = render.command_;
+		command.aperture_ = render.aperture_ ? render.aperture_->code_ : -1;
+		command.x_ = render.X;
+		command.y_ = render.Y;
+		command.w_ = render.W;
+		command.h_ = render.H;
+		command.a_ = render.A;
+		command.end_x_ = render.End.X;
+		command.end_y_ = render.End.Y;
+		Add(command);
+	}
+
+	const std::vector<char>& Data() const {
+		return data_;
+	}
+
+private:
+	std::vector<char> data_;
+};
+
+// Walks the records of a mapped cache file, checking every read against its end.
+class Reader {
+public:
+	Reader(const char* data, std::size_t size) : data_(data), size_(size) {
+	}
+
+	template <typename Record>
+	bool Next(Record& record) {
+		if (size_ - index_ < sizeof(record)) {
+			return false;
+		}
+
+		std::memcpy(&record, data_ + index_, sizeof(record));
+		index_ += sizeof(record);
+		return true;
+	}
+
+	bool Next(std::string& text, std::uint64_t size) {
+		if (size_ - index_ < Padded(size)) {
+			return false;
+		}
+
+		text.assign(data_ + index_, size);
+		index_ += Padded(size);
+		return true;
+	}
+
+	// Points items at the next count items of the mapping, without copying.
+	template <typename Item>
+	bool View(const Item*& items, std::uint64_t count) {
+		if (count > (size_ - index_) / sizeof(Item) || size_ - index_ < Padded(count * sizeof(Item))) {
+			return false;
+		}
+
+		items = reinterpret_cast<const Item*>(data_ + index_);
+		index_ += Padded(count * sizeof(Item));
+		return true;
+	}
+
+	bool Next(RenderCommand& render, const ApertureTable& apertures) {
+		COMMAND command;
+		if (!Next(command) || command.command_ < RenderCommand::gcRectangle || command.command_ > RenderCommand::gcFlash) {
+			return false;
+		}
+
+		render = RenderCommand(static_cast<RenderCommand::GerberCommand>(command.command_));
+		render.X = command.x_;
+		render.Y = command.y_;
+		render.W = command.w_;
+		render.H = command.h_;
+		render.A = command.a_;
+		render.End.X = command.end_x_;
+		render.End.Y = command.end_y_;
+
+		if (command.aperture_ >= 0) {
+			render.aperture_ = apertures.Find(command.aperture_);
+			if (!render.aperture_) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool End() const {
+		return index_ == size_;
+	}
+
+private:
+	const char* data_;
+	std::size_t size_;
+	std::size_t index_{ 0 };
+};
+
+}
+
+std::uint64_t GerberCache::Hash(std::string_view text)
+{
+	auto hash = kFnvOffset;
+	for (auto c : text) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * kFnvPrime;
+	}
+
+	return hash;
+}
+
+std::uint64_t GerberCache::HashFile(const std::string& file_name)
+{
+	MappedFile file;
+	if (!file.Open(file_name)) {
+		return 0;
+	}
+
+	return Hash(std::string_view(file.Data(), file.Size()));
+}
+
+bool GerberCache::Save(const Gerber& gerber, std::uint64_t source_hash, const std::string& cache_file)
+{
+	Writer writer;
+
+	HEADER header{};
+	header.magic_ = kMagic;
+	header.version_ = kVersion;
+	header.source_hash_ = source_hash;
+	header.units_ = gerber.units_;
+	header.negative_ = gerber.negative_;
+	header.x_integer_ = static_cast<std::uint8_t>(gerber.format_.XInteger);
+	header.x_decimal_ = static_cast<std::uint8_t>(gerber.format_.XDecimal);
+	header.y_integer_ = static_cast<std::uint8_t>(gerber.format_.YInteger);
+	header.y_decimal_ = static_cast<std::uint8_t>(gerber.format_.YDecimal);
+	header.omit_trailing_zeroes_ = gerber.format_.omit_trailing_zeroes_;
+	header.aperture_count_ = static_cast<std::uint32_t>(gerber.apertures_.Size());
+	header.level_count_ = static_cast<std::uint32_t>(gerber.levels_.size());
+	header.name_size_ = gerber.name_.size();
+	writer.Add(header);
+	writer.Add(gerber.name_);
+
+	for (const auto& aperture : gerber.apertures_) {
+		APERTURE record{};
+		record.code_ = aperture->code_;
+		record.type_ = aperture->type_;
+		record.side_count_ = aperture->side_count_;
+		record.command_count_ = aperture->type_ == GerberAperture::tMacro ? static_cast<std::uint32_t>(aperture->render_commands_.size()) : 0;
+		record.dimension_x_ = aperture->dimension_x_;
+		record.dimension_y_ = aperture->dimension_y_;
+		record.hole_x_ = aperture->hole_x_;
+		record.hole_y_ = aperture->hole_y_;
+		record.rotation_ = aperture->rotation_;
+		record.left_ = aperture->left_;
+		record.bottom_ = aperture->bottom_;
+		record.right_ = aperture->right_;
+		record.top_ = aperture->top_;
+		writer.Add(record);
+
+		for (std::uint32_t i = 0; i < record.command_count_; i++) {
+			writer.Add(*aperture->render_commands_[i]);
+		}
+	}
+
+	for (const auto& level : gerber.levels_) {
+		LEVEL record{};
+		record.count_x_ = level->CountX;
+		record.count_y_ = level->CountY;
+		record.step_x_ = level->StepX;
+		record.step_y_ = level->StepY;
+		record.left_ = level->bound_box_.Left();
+		record.right_ = level->bound_box_.Right();
+		record.top_ = level->bound_box_.Top();
+		record.bottom_ = level->bound_box_.Bottom();
+		record.x_ = level->X;
+		record.y_ = level->Y;
+		record.i_ = level->I;
+		record.j_ = level->J;
+		record.negative_ = level->negative_;
+		record.relative_ = level->relative_;
+		record.incremental_ = level->incremental_;
+		record.multi_quadrant_ = level->multi_quadrant_;
+		record.units_ = level->units_;
+		record.exposure_ = level->exposure_;
+		record.interpolation_ = level->interpolation_;
+		record.name_size_ = level->name_.size();
+		writer.Add(record);
+		writer.Add(level->name_);
+
+		// Packed with the coordinate format of the file if not already
+		const auto* store = &level->render_commands_;
+		CommandStore packed;
+		if (!store->Packed()) {
+			packed = *store;
+			packed.Pack(gerber.format_.XDecimal, gerber.format_.YDecimal, gerber.units_ == guInches);
+			store = &packed;
+		}
+
+		const auto commands_view = store->View();
+		COMMANDS commands{};
+		commands.size_ = store->size_;
+		commands.aperture_count_ = store->apertures_.size();
+		commands.byte_count_ = commands_view.byte_count_;
+		commands.checkpoint_count_ = commands_view.checkpoint_count_;
+		commands.extra_count_ = commands_view.extra_count_;
+		commands.x_divisor_ = store->x_divisor_;
+		commands.y_divisor_ = store->y_divisor_;
+		commands.scale_ = store->scale_;
+		commands.last_x_ = store->last_x_;
+		commands.last_y_ = store->last_y_;
+		writer.Add(commands);
+
+		std::vector<std::int32_t> codes;
+		for (const auto& aperture : store->apertures_) {
+			codes.push_back(aperture->code_);
+		}
+		writer.Add(codes.data(), codes.size());
+		writer.Add(commands_view.bytes_, commands_view.byte_count_);
+		writer.Add(commands_view.checkpoints_, commands_view.checkpoint_count_);
+		writer.Add(commands_view.extras_, commands_view.extra_count_);
+
+		const auto& index = level->index_;
+		const auto index_view = index.View();
+		INDEX index_record{};
+		index_record.valid_ = index.valid_;
+		index_record.columns_ = index.columns_;
+		index_record.rows_ = index.rows_;
+		index_record.left_ = index.left_;
+		index_record.bottom_ = index.bottom_;
+		index_record.right_ = index.right_;
+		index_record.top_ = index.top_;
+		index_record.cell_width_ = index.cell_width_;
+		index_record.cell_height_ = index.cell_height_;
+		index_record.primitive_count_ = index_view.primitive_count_;
+		index_record.cell_start_count_ = index_view.cell_start_count_;
+		index_record.cell_item_count_ = index_view.cell_item_count_;
+		index_record.large_count_ = index_view.large_count_;
+		writer.Add(index_record);
+
+		writer.Add(index_view.primitives_, index_view.primitive_count_);
+		writer.Add(index_view.cell_start_, index_view.cell_start_count_);
+		writer.Add(index_view.cell_items_, index_view.cell_item_count_);
+		writer.Add(index_view.large_, index_view.large_count_);
+	}
+
+	// Written under a unique name and renamed, so that readers never see a
+	// partial entry, even with several processes filling the same cache.
+	auto temp_file = cache_file + '.' + std::to_string(std::random_device()()) + ".tmp";
+	{
+		std::ofstream file(temp_file, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(writer.Data().data(), writer.Data().size());
+		if (!file) {
+			LOG(ERROR) << "Error: Failed to write gerber cache " << temp_file;
+			file.close();
+			std::remove(temp_file.c_str());
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temp_file, cache_file, error);
+	if (error) {
+		LOG(ERROR) << "Error: Failed to write gerber cache " << cache_file << ": " << error.message();
+		std::remove(temp_file.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+std::shared_ptr<Gerber> GerberCache::Load(const std::string& cache_file, std::uint64_t source_hash)
+{
+	// Kept open by the levels, whose commands and index stay in the mapping
+	auto file = std::make_shared<MappedFile>();
+	if (!file->Open(cache_file)) {
+		return nullptr;
+	}
+	std::shared_ptr<const void> mapping(file, file->Data());
+
+	Reader reader(file->Data(), file->Size());
+
+	HEADER header;
+	if (!reader.Next(header) || header.magic_ != kMagic || header.version_ != kVersion || header.source_hash_ != source_hash) {
+		return nullptr;
+	}
+
+	std::shared_ptr<Gerber> gerber(new Gerber());
+	gerber->units_ = static_cast<GERBER_UNIT>(header.units_);
+	gerber->negative_ = header.negative_ != 0;
+	gerber->format_.XInteger = header.x_integer_;
+	gerber->format_.XDecimal = header.x_decimal_;
+	gerber->format_.YInteger = header.y_integer_;
+	gerber->format_.YDecimal = header.y_decimal_;
+	gerber->format_.omit_trailing_zeroes_ = header.omit_trailing_zeroes_ != 0;
+	if (!reader.Next(gerber->name_, header.name_size_)) {
+		return nullptr;
+	}
+
+	for (std::uint32_t i = 0; i < header.aperture_count_; i++) {
+		APERTURE record;
+		if (!reader.Next(record) || record.code_ < 0 ||
+			record.type_ < GerberAperture::tCircle || record.type_ > GerberAperture::tMacro) {
+			return nullptr;
+		}
+
+		auto aperture = std::make_shared<GerberAperture>();
+		aperture->code_ = record.code_;
+		aperture->type_ = static_cast<GerberAperture::TYPE>(record.type_);
+		aperture->side_count_ = record.side_count_;
+		aperture->dimension_x_ = record.dimension_x_;
+		aperture->dimension_y_ = record.dimension_y_;
+		aperture->hole_x_ = record.hole_x_;
+		aperture->hole_y_ = record.hole_y_;
+		aperture->rotation_ = record.rotation_;
+		aperture->left_ = record.left_;
+		aperture->bottom_ = record.bottom_;
+		aperture->right_ = record.right_;
+		aperture->top_ = record.top_;
+
+		for (std::uint32_t j = 0; j < record.command_count_; j++) {
+			RenderCommand render(RenderCommand::gcClose);
+			if (!reader.Next(render, gerber->apertures_)) {
+				return nullptr;
+			}
+			aperture->Add(std::make_shared<RenderCommand>(render));
+		}
+
+		if (!gerber->apertures_.Add(aperture)) {
+			return nullptr;
+		}
+	}
+
+	for (std::uint32_t i = 0; i < header.level_count_; i++) {
+		LEVEL record;
+		if (!reader.Next(record)) {
+			return nullptr;
+		}
+
+		auto level = std::make_shared<GerberLevel>(nullptr, static_cast<GERBER_UNIT>(record.units_));
+		level->CountX = record.count_x_;
+		level->CountY = record.count_y_;
+		level->StepX = record.step_x_;
+		level->StepY = record.step_y_;
+		level->bound_box_ = BoundBox(record.left_, record.right_, record.top_, record.bottom_);
+		level->X = record.x_;
+		level->Y = record.y_;
+		level->I = record.i_;
+		level->J = record.j_;
+		level->negative_ = record.negative_ != 0;
+		level->relative_ = record.relative_ != 0;
+		level->incremental_ = record.incremental_ != 0;
+		level->multi_quadrant_ = record.multi_quadrant_ != 0;
+		level->exposure_ = static_cast<GERBER_EXPOSURE>(record.exposure_);
+		level->interpolation_ = static_cast<GERBER_INTERPOLATION>(record.interpolation_);
+		if (!reader.Next(level->name_, record.name_size_)) {
+			return nullptr;
+		}
+
+		// The arrays are used in place, so their contents are checked as well
+		// as their sizes; only the values of coordinates are taken on trust.
+		COMMANDS commands;
+		const std::int32_t* codes = nullptr;
+		CommandStore::VIEW commands_view{};
+		if (!reader.Next(commands) ||
+			!reader.View(codes, commands.aperture_count_) ||
+			!reader.View(commands_view.bytes_, commands.byte_count_) ||
+			!reader.View(commands_view.checkpoints_, commands.checkpoint_count_) ||
+			!reader.View(commands_view.extras_, commands.extra_count_) ||
+			commands.size_ > commands.byte_count_ ||
+			commands.checkpoint_count_ != (commands.size_ + CommandStore::kCheckpoint - 1) / CommandStore::kCheckpoint) {
+			return nullptr;
+		}
+		commands_view.byte_count_ = commands.byte_count_;
+		commands_view.checkpoint_count_ = commands.checkpoint_count_;
+		commands_view.extra_count_ = commands.extra_count_;
+
+		auto& store = level->render_commands_;
+		store.packed_ = true;
+		store.size_ = commands.size_;
+		store.x_divisor_ = commands.x_divisor_;
+		store.y_divisor_ = commands.y_divisor_;
+		store.scale_ = commands.scale_;
+		store.last_x_ = commands.last_x_;
+		store.last_y_ = commands.last_y_;
+		store.apertures_.reserve(commands.aperture_count_);
+		for (std::uint64_t j = 0; j < commands.aperture_count_; j++) {
+			const auto& aperture = gerber->apertures_.Find(codes[j]);
+			if (!aperture) {
+				return nullptr;
+			}
+			store.aperture_index_.emplace(aperture.get(), static_cast<std::uint32_t>(j));
+			store.apertures_.push_back(aperture);
+		}
+		store.mapping_ = mapping;
+		store.view_ = commands_view;
+		if (!store.Consistent()) {
+			return nullptr;
+		}
+
+		INDEX index_record;
+		SpatialIndex::VIEW index_view{};
+		if (!reader.Next(index_record) ||
+			!reader.View(index_view.primitives_, index_record.primitive_count_) ||
+			!reader.View(index_view.cell_start_, index_record.cell_start_count_) ||
+			!reader.View(index_view.cell_items_, index_record.cell_item_count_) ||
+			!reader.View(index_view.large_, index_record.large_count_)) {
+			return nullptr;
+		}
+		index_view.primitive_count_ = index_record.primitive_count_;
+		index_view.cell_start_count_ = index_record.cell_start_count_;
+		index_view.cell_item_count_ = index_record.cell_item_count_;
+		index_view.large_count_ = index_record.large_count_;
+
+		auto& index = level->index_;
+		index.valid_ = index_record.valid_ != 0;
+		index.columns_ = index_record.columns_;
+		index.rows_ = index_record.rows_;
+		index.left_ = index_record.left_;
+		index.bottom_ = index_record.bottom_;
+		index.right_ = index_record.right_;
+		index.top_ = index_record.top_;
+		index.cell_width_ = index_record.cell_width_;
+		index.cell_height_ = index_record.cell_height_;
+		index.mapping_ = mapping;
+		index.view_ = index_view;
+		if (!index.Consistent(store.size())) {
+			return nullptr;
+		}
+
+		gerber->levels_.push_back(level);
+		gerber->current_level_ = level;
+	}
+
+	if (!reader.End()) {
+		return nullptr;
+	}
+
+	return gerber;
+}
+
+std::shared_ptr<Gerber> GerberCache::Open(const std::string& file_name, const std::string& cache_directory)
+{
+	auto source_hash = HashFile(file_name);
+	if (!source_hash) {
+		return std::make_shared<Gerber>(file_name);
+	}
+
+	char key[17];
+	std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(source_hash));
+	auto cache_file = (std::filesystem::path(cache_directory) / (std::string(key) + ".gbc")).string();
+
+	if (auto gerber = Load(cache_file, source_hash)) {
+		gerber->file_name_ = file_name;
+		return gerber;
+	}
+
+	std::shared_ptr<Gerber> gerber(new Gerber());
+	gerber->file_name_ = file_name;
+	if (!gerber->gerber_file_.Load(file_name, glMapped) || !gerber->LoadGerber(1)) {
+		return gerber; // Whatever was parsed, but not kept: the next Open reports the errors again
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(cache_directory, error);
+	Save(*gerber, source_hash, cache_file);
+
+	return gerber;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class Gerber;
+
+
+// Binary snapshot of a parsed Gerber: levels and apertures stored as
+// fixed-size, 8-byte aligned records, and for every level the packed render
+// commands and the spatial index. Loading one maps the file and rebuilds the
+// levels and apertures without parsing any text; the commands and indices
+// are used in place in the mapping, which the levels keep open.
+// Entries are keyed by a hash of the source text; an entry written by
+// another format version, a machine of different byte order or for
+// different source text is rejected.
+class GerberCache {
+public:
+	static constexpr std::uint32_t kVersion = 3;
+
+	// FNV-1a hash of the source text.
+	static std::uint64_t Hash(std::string_view text);
+	// Hash of the file contents, 0 if it cannot be read.
+	static std::uint64_t HashFile(const std::string& file_name);
+
+	static bool Save(const Gerber& gerber, std::uint64_t source_hash, const std::string& cache_file);
+	// nullptr if cache_file is missing, damaged or not for source_hash.
+	static std::shared_ptr<Gerber> Load(const std::string& cache_file, std::uint64_t source_hash);
+
+	// Loads file_name from the entry for its contents in cache_directory, or
+	// parses it and adds the entry if it parsed without errors.
+	static std::shared_ptr<Gerber> Open(const std::string& file_name, const std::string& cache_directory);
+};
@@ -1,23 +1,246 @@
 #include "gerber_file.h"
+#include "text_scan.h"
+#include "inflate_chunk_reader.h"
 #include <fstream>
 #include <iostream>
-#include <iterator>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <glog/logging.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
-bool GerberFile::Load(const std::string& file_name)
+// The digit scanner below reads eight characters as one little-endian word.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define GERBER_SWAR_DIGITS 0
+#else
+#define GERBER_SWAR_DIGITS 1
+#endif
+
+
+namespace {
+
+// Doubles represent integers of up to 15 decimal digits exactly.
+constexpr int kMaxExactDigits = 15;
+
+constexpr std::uint64_t kPowersOf10[] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+	100000000ull, 1000000000ull, 10000000000ull, 100000000000ull,
+	1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull
+};
+
+inline int CountTrailingZeros(std::uint64_t value)
 {
-	std::ifstream file(file_name, std::ios::in);
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+// Number of ASCII digits at the start of an eight character chunk.
+inline int LeadingDigits(std::uint64_t chunk)
+{
+	// The top bit of a byte ends up set when it is below '0' or above '9'.
+	auto non_digits = ((chunk + 0x4646464646464646ull) | (chunk - 0x3030303030303030ull)) & 0x8080808080808080ull;
+	return non_digits ? CountTrailingZeros(non_digits) / 8 : 8;
+}
+
+// Value of the first count (1 to 8) digits of a chunk.
+inline std::uint64_t ParseDigits(std::uint64_t chunk, int count)
+{
+	// Shift the digits to the top so that the unused bytes become leading zeroes,
+	// then combine pairs, quads and finally both halves with three multiplies.
+	chunk = (chunk - 0x3030303030303030ull) << (8 * (8 - count));
+	chunk = chunk * 10 + (chunk >> 8);
+	chunk = ((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+	        ((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+	return static_cast<std::uint32_t>(chunk);
+}
+
+#ifdef GERBER_WITH_ZLIB
+bool IsGzipFile(const std::string& file_name)
+{
+	char magic[2] = {};
+	std::ifstream file(file_name, std::ios::in | std::ios::binary);
+	return file.read(magic, sizeof(magic)) && magic[0] == '\x1f' && magic[1] == '\x8b';
+}
+#endif
+
+}
+
+
+bool GerberFile::Load(const std::string& file_name, GERBER_LOAD_MODE mode)
+{
+	Close();
+
+#ifdef GERBER_WITH_ZLIB
+	// Compressed files are always streamed, inflating one chunk at a time.
+	if (file_name != "-" && IsGzipFile(file_name)) {
+		auto file = std::make_unique<std::ifstream>(file_name, std::ios::in | std::ios::binary);
+		return Load(std::make_unique<InflateChunkReader>(std::make_unique<StreamChunkReader>(std::move(file))));
+	}
+#endif
+
+	if (mode == glMapped && mapped_file_.Open(file_name)) {
+		buffer_ = std::string_view(mapped_file_.Data(), mapped_file_.Size());
+		return true;
+	}
+
+	if (mode == glStreamed) {
+		auto file = std::make_unique<std::ifstream>(file_name, std::ios::in | std::ios::binary);
+		if (!*file) {
+			std::cout << "failed to open gerber file." << std::endl;
+			return false;
+		}
+
+		return Load(std::make_unique<StreamChunkReader>(std::move(file)));
+	}
+
+	// Buffered mode, or a pipe/stdin/empty file that cannot be mapped.
+	if (file_name == "-") {
+		return Read(std::cin);
+	}
+
+	std::ifstream file(file_name, std::ios::in | std::ios::binary);
 	if (!file) {
 		std::cout << "failed to open gerber file." << std::endl;
 		return false;
 	}
 
-	buffer_ = { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	return Read(file);
+}
+
+bool GerberFile::Load(std::unique_ptr<ChunkReader> reader, std::size_t chunk_size)
+{
+	Close();
+
+	reader_ = std::move(reader);
+	chunk_size_ = chunk_size;
+	return true;
+}
+
+bool GerberFile::Load(std::string_view text)
+{
+	Close();
+
+	buffer_ = text;
+	return true;
+}
+
+bool GerberFile::Load(std::istream& stream, GERBER_LOAD_MODE mode)
+{
+	Close();
+
+	if (mode == glStreamed) {
+		return Load(std::make_unique<StreamChunkReader>(stream));
+	}
+
+	return Read(stream);
+}
+
+void GerberFile::Close()
+{
+	buffer_ = {};
 	index_ = 0;
-	line_number_ = 0;
+	statement_end_ = 0;
+
+	newlines_.clear();
+	newlines_end_ = 0;
+	dropped_lines_ = 0;
+
+	mapped_file_.Close();
+	std::vector<char>().swap(storage_);
+	reader_ = nullptr;
+}
+
+bool GerberFile::Prefetch()
+{
+	if (reader_) {
+		while (!StatementResident() && Refill());
+	}
+
+	return !EndOfFile();
+}
+
+bool GerberFile::StatementBuffered()
+{
+	return !reader_ || StatementResident();
+}
+
+bool GerberFile::Streamed() const
+{
+	return reader_ != nullptr;
+}
 
+bool GerberFile::StatementResident()
+{
+	if (index_ < statement_end_ && statement_end_ + 1 < buffer_.size()) {
+		return true;
+	}
+
+	auto begin = FindNonWhiteSpace(buffer_.data(), index_, buffer_.size());
+	if (begin >= buffer_.size()) {
+		return false;
+	}
+
+	// Extended commands run up to the closing '%', everything else up to the
+	// next '*'. One more character must be available behind the terminator,
+	// since some parsers step over it.
+	auto end = buffer_[begin] == '%' ?
+		FindChar(buffer_.data(), begin + 1, buffer_.size(), '%') :
+		FindChar(buffer_.data(), begin, buffer_.size(), '*');
+	if (end + 1 >= buffer_.size()) {
+		return false;
+	}
+
+	statement_end_ = end;
+	return true;
+}
+
+bool GerberFile::Refill()
+{
+	// Drop the text the parser has already consumed, then append the next chunk.
+	auto consumed = std::min<std::size_t>(index_, storage_.size());
+	dropped_lines_ += static_cast<unsigned>(CountChar(storage_.data(), 0, consumed, '\n'));
+	newlines_.clear();
+	newlines_end_ = 0;
+
+	storage_.erase(storage_.begin(), storage_.begin() + consumed);
+	index_ -= consumed;
+	statement_end_ = 0;
+
+	auto size = storage_.size();
+	storage_.resize(size + chunk_size_);
+	auto read = reader_->Read(storage_.data() + size, chunk_size_);
+	storage_.resize(size + read);
+
+	buffer_ = std::string_view(storage_.data(), storage_.size());
+	return read > 0;
+}
+
+bool GerberFile::Read(std::istream& stream)
+{
+	constexpr std::size_t kBlockSize = 1 << 20;
+
+	std::size_t size = 0;
+	while (stream) {
+		storage_.resize(size + kBlockSize);
+		stream.read(storage_.data() + size, kBlockSize);
+		size += static_cast<std::size_t>(stream.gcount());
+	}
+	storage_.resize(size);
+
+	if (stream.bad()) {
+		std::cout << "failed to read gerber file." << std::endl;
+		return false;
+	}
+
+	buffer_ = std::string_view(storage_.data(), storage_.size());
 	return true;
 }
 
@@ -26,23 +249,30 @@ bool GerberFile::EndOfFile()
 	return index_ >= buffer_.size();
 }
 
-bool GerberFile::SkipWhiteSpace() {
-	while (!EndOfFile()) {
-		switch (buffer_[index_]) {
-		case '\n':
-			line_number_++;
-		case ' ':
-		case '\t':
-		case '\r':
-			index_++;
+unsigned GerberFile::LineNumber() const
+{
+	auto end = std::min(index_, buffer_.size());
+	while (newlines_end_ < end) {
+		auto newline = FindChar(buffer_.data(), newlines_end_, end, '\n');
+		if (newline == end) {
+			newlines_end_ = end;
 			break;
-
-		default:
-			return false;
 		}
+
+		newlines_.push_back(newline);
+		newlines_end_ = newline + 1;
 	}
 
-	return true;
+	auto before = std::lower_bound(newlines_.begin(), newlines_.end(), index_) - newlines_.begin();
+	return dropped_lines_ + static_cast<unsigned>(before) + 1;
+}
+
+bool GerberFile::SkipWhiteSpace() {
+	if (!EndOfFile()) {
+		index_ = FindNonWhiteSpace(buffer_.data(), index_, buffer_.size());
+	}
+
+	return EndOfFile();
 }
 
 char GerberFile::GetChar()
@@ -70,20 +300,16 @@ bool GerberFile::QueryCharUntilNotWhiteSpace(char c)
 
 bool GerberFile::QueryCharUntilEnd(char c)
 {
-	while (!EndOfFile()) {
-		if (PeekChar() == c) {
-			return true;
-		}
-
-		++index_;
+	if (!EndOfFile()) {
+		index_ = FindChar(buffer_.data(), index_, buffer_.size(), c);
 	}
 
-	return false;
+	return !EndOfFile();
 }
 
 bool GerberFile::GetInteger(int& integer) {
 	bool     sign = false;
-	unsigned i = index_;
+	auto i = index_;
 
 	SkipWhiteSpace();
 
@@ -117,7 +343,7 @@ bool GerberFile::GetFloat(double& number) {
 	int       integer = 0;
 	bool      sign = false;
 	double    scale = 0.1;
-	unsigned i = index_;
+	auto i = index_;
 
 	SkipWhiteSpace();
 
@@ -167,10 +393,63 @@ bool GerberFile::GetFloat(double& number) {
 }
 
 bool GerberFile::GetCoordinate(double& number, int integer, int decimal, bool omit_trailing_zeroes) {
+#if GERBER_SWAR_DIGITS
+	SkipWhiteSpace();
+
+	auto start = index_;
+	bool sign = false;
+	if (!EndOfFile() && (buffer_[index_] == '-' || buffer_[index_] == '+')) {
+		sign = buffer_[index_] == '-';
+		index_++;
+	}
+
+	// Eight digits per step. Anything unusual (decimal points, more digits than
+	// a double holds exactly, the last few bytes of the buffer) is left to the
+	// scalar path, which starts over from the same position.
+	std::uint64_t value = 0;
+	int n = 0;
+	while (index_ + 8 <= buffer_.size()) {
+		std::uint64_t chunk;
+		std::memcpy(&chunk, buffer_.data() + index_, sizeof(chunk));
+
+		auto count = LeadingDigits(chunk);
+		if (count) {
+			value = value * kPowersOf10[count] + ParseDigits(chunk, count);
+			index_ += count;
+			n += count;
+		}
+
+		if (n > kMaxExactDigits) {
+			break;
+		}
+
+		if (count < 8) {
+			auto scale = omit_trailing_zeroes ? integer + decimal - n : 0;
+			if (buffer_[index_] == '.' || !n || (omit_trailing_zeroes && integer + decimal > kMaxExactDigits)) {
+				break;
+			}
+
+			// Every step below is exact or identical to the scalar path, so the
+			// result is bit for bit the same.
+			number = static_cast<double>(value);
+			if (sign) number *= -1;
+			if (scale > 0) number *= static_cast<double>(kPowersOf10[scale]);
+			for (int j = 0; j < decimal; j++) number /= 10;
+			return true;
+		}
+	}
+
+	index_ = start;
+#endif
+
+	return GetCoordinateScalar(number, integer, decimal, omit_trailing_zeroes);
+}
+
+bool GerberFile::GetCoordinateScalar(double& number, int integer, int decimal, bool omit_trailing_zeroes) {
 	int      j;
 	int      n = 0;
 	bool     sign = false;
-	unsigned i = index_;
+	auto i = index_;
 
 	SkipWhiteSpace();
 
@@ -204,7 +483,7 @@ bool GerberFile::GetCoordinate(double& number, int integer, int decimal, bool om
 			}
 			for (j = 0; j < decimal; j++) number /= 10;
 			if (!n) {
-				LOG(WARNING) << "Line " << line_number_ << " - Warning: Ignoring ill-formed coordinate";
+				LOG_IF(WARNING, !quiet_) << "Line " << LineNumber() << " - Warning: Ignoring ill-formed coordinate";
 			}
 			return true;
 		}
@@ -213,21 +492,43 @@ bool GerberFile::GetCoordinate(double& number, int integer, int decimal, bool om
 	return false;
 }
 
-bool GerberFile::GetString(std::string& str) {
-	while (!EndOfFile()) {
-		SkipWhiteSpace();
+bool GerberFile::GetString(std::string_view& str) {
+	SkipWhiteSpace();
 
-		switch (PeekChar()) {
+	auto begin = index_;
+	auto end = index_;
+	auto copied = false;
+	while (!EndOfFile()) {
+		const auto c = PeekChar();
+		switch (c) {
 		case 0:
-			LOG(ERROR) << "Line " << line_number_ << " - Error: Null in name not allowed";
+			LOG_IF(ERROR, !quiet_) << "Line " << LineNumber() << " - Error: Null in name not allowed";
 			return false;
 		case '*':
 		case ',':
+			str = copied ? std::string_view(name_) : buffer_.substr(begin, end - begin);
 			return true;
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			break;
 		default:
-			str.push_back(GetChar());
+			// White space inside the name is dropped, which needs a copy
+			if (!copied && end != index_) {
+				name_.assign(buffer_.substr(begin, end - begin));
+				copied = true;
+			}
+			if (copied) {
+				name_.push_back(c);
+			}
+			else {
+				end = index_ + 1;
+			}
 			break;
 		}
+
+		index_++;
 	}
 
 	return false;
@@ -1,16 +1,53 @@
 #pragma once
+#include <cstddef>
+#include <istream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "gerber/gerber_enums.h"
+#include "chunk_reader.h"
+#include "mapped_file.h"
+
 class GerberFile {
 public:
-	std::vector<char> buffer_;
+	static constexpr std::size_t kChunkSize = 1 << 20;
+
+	// The text being parsed. Points either into the read-only mapping of the
+	// file or into storage_, never owns the characters itself.
+	// In streaming mode this is only a window of the file and index_ is
+	// relative to the start of the window.
+	std::string_view buffer_;
+
+	std::size_t index_{ 0 };
+
+	// Suppresses warnings while text that has already been checked is parsed again.
+	bool quiet_{ false };
 
-	unsigned index_{ 0 };
-	unsigned line_number_{ 1 };
+	bool Load(const std::string& file_name, GERBER_LOAD_MODE mode = glMapped);
+	bool Load(std::unique_ptr<ChunkReader> reader, std::size_t chunk_size = kChunkSize);
+	// Parses text in place, it has to stay valid until Close.
+	bool Load(std::string_view text);
+	// glStreamed reads the stream chunk by chunk while parsing, any other mode
+	// reads it completely first.
+	bool Load(std::istream& stream, GERBER_LOAD_MODE mode);
+	void Close();
+
+	// Makes sure the statement starting at index_ is completely in buffer_,
+	// reading more chunks in streaming mode. Returns false at end of file.
+	bool Prefetch();
+	// True if the statement at index_ can be read without another Prefetch,
+	// which is always the case unless streaming.
+	bool StatementBuffered();
+	// True if only a window of the file is held in memory.
+	bool Streamed() const;
 
-	bool Load(const std::string& file_name);
 	bool EndOfFile();
+
+	// Line of the character at index_, counted on demand for diagnostics.
+	unsigned LineNumber() const;
+
 	bool SkipWhiteSpace();
 
 	char GetChar();
@@ -20,9 +57,38 @@ public:
 	bool QueryCharUntilNotWhiteSpace(char c);
 	bool QueryCharUntilEnd(char c);
 
-	bool GetString(std::string& str);
+	// Name or other text up to the next '*' or ',', without white space.
+	// Points into buffer_, or into a copy the next call reuses if there was
+	// white space inside the name.
+	bool GetString(std::string_view& str);
 
 	bool GetInteger(int& integer);
 	bool GetFloat(double& number);
 	bool GetCoordinate(double& number, int integer, int decimal, bool omit_trailing_zeroes);
+	// Digit by digit reference for GetCoordinate, also used for the cases its
+	// fast path does not handle.
+	bool GetCoordinateScalar(double& number, int integer, int decimal, bool omit_trailing_zeroes);
+
+private:
+	bool Read(std::istream& stream);
+
+	bool StatementResident();
+	bool Refill();
+
+	MappedFile mapped_file_;
+	std::vector<char> storage_;
+
+	std::unique_ptr<ChunkReader> reader_;
+	std::size_t chunk_size_{ kChunkSize };
+	std::size_t statement_end_{ 0 };
+
+	// Of GetString, kept to reuse the allocation
+	std::string name_;
+
+	// Offsets of the line feeds in buffer_ before newlines_end_, extended as
+	// far as needed whenever a line number is asked for.
+	mutable std::vector<std::size_t> newlines_;
+	mutable std::size_t newlines_end_{ 0 };
+	// Lines already dropped from the front of the buffer in streaming mode.
+	unsigned dropped_lines_{ 0 };
 };
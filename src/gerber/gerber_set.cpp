@@ -0,0 +1,129 @@
+#include "gerber_set.h"
+#include "zip_archive.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+
+
+GerberSet::GerberSet(unsigned threads) : pool_(threads)
+{
+}
+
+GerberSet::~GerberSet()
+{
+}
+
+GerberSet::Future GerberSet::Load(const std::string& file_name, GERBER_LOAD_MODE mode, Callback callback)
+{
+	return Submit([file_name, mode]() {
+		return std::make_shared<Gerber>(file_name, mode);
+	}, callback);
+}
+
+std::vector<GerberSet::Future> GerberSet::Load(const std::vector<std::string>& file_names, GERBER_LOAD_MODE mode, Callback callback)
+{
+	std::vector<Loader> loaders;
+	std::vector<std::uintmax_t> sizes;
+	for (const auto& file_name : file_names) {
+		loaders.push_back([file_name, mode]() {
+			return std::make_shared<Gerber>(file_name, mode);
+		});
+
+		std::error_code error;
+		auto size = std::filesystem::file_size(file_name, error);
+		sizes.push_back(error ? 0 : size);
+	}
+
+	return Submit(loaders, sizes, callback);
+}
+
+std::vector<GerberSet::Future> GerberSet::LoadArchive(const std::string& archive_name, Callback callback)
+{
+	// Shared by the loaders, the mapping has to outlive all of them.
+	auto archive = std::make_shared<ZipArchive>();
+	if (!archive->Open(archive_name)) {
+		return {};
+	}
+
+	std::vector<Loader> loaders;
+	std::vector<std::uintmax_t> sizes;
+	for (const auto& name : archive->Names()) {
+		loaders.push_back([archive, name]() {
+			return Gerber::FromReader(archive->OpenMember(name), name);
+		});
+		sizes.push_back(archive->Size(name));
+	}
+
+	return Submit(loaders, sizes, callback);
+}
+
+GerberSet::Future GerberSet::Start(Loader loader, Callback callback)
+{
+	return pool_.Submit([loader, callback]() {
+		auto gerber = loader();
+		if (callback) {
+			callback(gerber);
+		}
+		return gerber;
+	}).share();
+}
+
+GerberSet::Future GerberSet::Submit(Loader loader, Callback callback)
+{
+	auto gerber = Start(loader, callback);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	gerbers_.push_back(gerber);
+	return gerber;
+}
+
+std::vector<GerberSet::Future> GerberSet::Submit(const std::vector<Loader>& loaders, const std::vector<std::uintmax_t>& sizes, Callback callback)
+{
+	std::vector<std::size_t> order(loaders.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sizes](std::size_t a, std::size_t b) {
+		return sizes[a] > sizes[b];
+	});
+
+	std::vector<Future> gerbers(loaders.size());
+	for (auto i : order) {
+		gerbers[i] = Start(loaders[i], callback);
+	}
+
+	// Keep the order of the caller rather than the loading order.
+	std::lock_guard<std::mutex> lock(mutex_);
+	gerbers_.insert(gerbers_.end(), gerbers.begin(), gerbers.end());
+
+	return gerbers;
+}
+
+std::vector<GerberSet::Future> GerberSet::Futures() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return gerbers_;
+}
+
+std::vector<std::shared_ptr<Gerber>> GerberSet::Gerbers() const
+{
+	std::vector<std::shared_ptr<Gerber>> gerbers;
+	for (const auto& gerber : Futures()) {
+		gerbers.push_back(gerber.get());
+	}
+
+	return gerbers;
+}
+
+BoundBox GerberSet::GetBBox() const
+{
+	BoundBox bound_box;
+	for (const auto& future : Futures()) {
+		// Nothing was drawn, its box would only stretch to the origin
+		const auto& gerber = future.get();
+		if (!gerber->Levels().empty()) {
+			bound_box.UpdateBox(gerber->GetBBox());
+		}
+	}
+
+	return bound_box;
+}
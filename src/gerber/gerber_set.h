@@ -0,0 +1,61 @@
+#pragma once
+#include <functional>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gerber.h"
+#include "thread_pool.h"
+#include "bound_box.h"
+
+
+// Loads the layers of a fabrication job concurrently, one file per thread.
+// Files may be added and the set read from several threads at once, but
+// not from a callback, which would wait for its own file.
+class GerberSet {
+public:
+	using Callback = std::function<void(std::shared_ptr<Gerber>)>;
+	using Future = std::shared_future<std::shared_ptr<Gerber>>;
+
+	// 0 starts one thread per hardware thread.
+	explicit GerberSet(unsigned threads = 0);
+	// Waits for the files still being loaded.
+	~GerberSet();
+
+	GerberSet(const GerberSet&) = delete;
+	GerberSet& operator=(const GerberSet&) = delete;
+
+	// Starts loading the file. callback, if given, is called on the loading
+	// thread as soon as the file is parsed.
+	Future Load(const std::string& file_name, GERBER_LOAD_MODE mode = glMapped, Callback callback = nullptr);
+	// Starts loading all files, largest first so that the job finishes about
+	// when its largest layer does. The futures are in the order of file_names.
+	std::vector<Future> Load(const std::vector<std::string>& file_names, GERBER_LOAD_MODE mode = glMapped, Callback callback = nullptr);
+	// Same for every file in a zip archive, parsed straight from the archive.
+	// The futures are in the order of ZipArchive::Names, empty if the
+	// archive cannot be opened.
+	std::vector<Future> LoadArchive(const std::string& archive_name, Callback callback = nullptr);
+
+	// Waits for all files and returns them in the order they were added.
+	std::vector<std::shared_ptr<Gerber>> Gerbers() const;
+	// Waits for all files and returns the union of their bounding boxes,
+	// leaving out those without any level, such as files that failed to load.
+	BoundBox GetBBox() const;
+
+private:
+	using Loader = std::function<std::shared_ptr<Gerber>()>;
+
+	// Starts the loader, without adding it to gerbers_.
+	Future Start(Loader loader, Callback callback);
+	Future Submit(Loader loader, Callback callback);
+	std::vector<Future> Submit(const std::vector<Loader>& loaders, const std::vector<std::uintmax_t>& sizes, Callback callback);
+	// A copy, so that waiting for the files does not hold the lock.
+	std::vector<Future> Futures() const;
+
+	mutable std::mutex mutex_; // Guards gerbers_
+	std::vector<Future> gerbers_;
+	ThreadPool pool_;
+};
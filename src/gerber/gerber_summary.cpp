@@ -0,0 +1,80 @@
+#include "gerber_summary.h"
+#include "gerber.h"
+
+#include <algorithm>
+
+
+GerberSummary::GerberSummary(const std::string& file_name, GERBER_LOAD_MODE mode)
+{
+	std::unique_ptr<Gerber> gerber(new Gerber());
+	gerber->file_name_ = file_name;
+	gerber->store_commands_ = false;
+
+	valid_ = gerber->gerber_file_.Load(file_name, mode) && gerber->LoadGerber(1);
+
+	units_ = gerber->units_;
+	format_ = { gerber->format_.omit_trailing_zeroes_, gerber->format_.XInteger, gerber->format_.XDecimal, gerber->format_.YInteger, gerber->format_.YDecimal };
+	bound_box_ = gerber->GetBBox();
+	negative_ = gerber->negative_;
+	name_ = gerber->name_;
+
+	level_count_ = gerber->levels_.size();
+	for (const auto& level : gerber->levels_) {
+		for (std::size_t i = 0; i < command_counts_.size(); i++) {
+			command_counts_[i] += level->command_counts_[i];
+		}
+	}
+
+	apertures_.assign(gerber->apertures_.begin(), gerber->apertures_.end());
+	std::sort(apertures_.begin(), apertures_.end(), [](const std::shared_ptr<GerberAperture>& a, const std::shared_ptr<GerberAperture>& b) {
+		return a->code_ < b->code_;
+	});
+}
+
+bool GerberSummary::IsValid() const
+{
+	return valid_;
+}
+
+GERBER_UNIT GerberSummary::Unit() const
+{
+	return units_;
+}
+
+GerberSummary::FORMAT GerberSummary::Format() const
+{
+	return format_;
+}
+
+BoundBox GerberSummary::GetBBox() const
+{
+	return bound_box_;
+}
+
+bool GerberSummary::IsNegative() const
+{
+	return negative_;
+}
+
+std::string GerberSummary::Name() const
+{
+	return name_;
+}
+
+std::size_t GerberSummary::LevelCount() const
+{
+	return level_count_;
+}
+
+std::size_t GerberSummary::CommandCount(RenderCommand::GerberCommand command) const
+{
+	if (command < 0 || command >= RenderCommand::gcCount) {
+		return 0;
+	}
+	return command_counts_[command];
+}
+
+std::vector<std::shared_ptr<GerberAperture>> GerberSummary::Apertures() const
+{
+	return apertures_;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gerber/gerber_enums.h"
+#include "gerber/gerber_command.h"
+#include "bound_box.h"
+
+class GerberAperture;
+
+
+// Metadata of a Gerber file: units, coordinate format, apertures, command
+// counts and bounding box. The file is run through the full parser and
+// plotter, but the render commands are only counted, never stored.
+class GerberSummary {
+public:
+	struct FORMAT {
+		bool omit_trailing_zeroes_;
+		int  XInteger;
+		int  XDecimal;
+		int  YInteger;
+		int  YDecimal;
+	};
+
+	explicit GerberSummary(const std::string& file_name, GERBER_LOAD_MODE mode = glMapped);
+
+	// False if the file could not be read or parsed completely.
+	bool IsValid() const;
+
+	GERBER_UNIT Unit() const;
+	FORMAT Format() const;
+	BoundBox GetBBox() const;
+	bool IsNegative() const;
+	std::string Name() const;
+
+	std::size_t LevelCount() const;
+	// Number of commands of that kind over all levels, e.g. gcFlash for pads.
+	// Always 0 for gcDot, which only level of detail makes.
+	std::size_t CommandCount(RenderCommand::GerberCommand command) const;
+	// Defined apertures, ordered by D code.
+	std::vector<std::shared_ptr<GerberAperture>> Apertures() const;
+
+private:
+	bool valid_{ false };
+	GERBER_UNIT units_{ guInches };
+	FORMAT format_{};
+	BoundBox bound_box_;
+	bool negative_{ false };
+	std::string name_;
+
+	std::size_t level_count_{ 0 };
+	std::array<std::size_t, RenderCommand::gcCount> command_counts_{};
+	std::vector<std::shared_ptr<GerberAperture>> apertures_;
+};
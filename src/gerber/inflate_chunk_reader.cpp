@@ -0,0 +1,74 @@
+#ifdef GERBER_WITH_ZLIB
+#include "inflate_chunk_reader.h"
+#include <glog/logging.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+
+namespace {
+
+constexpr std::size_t kInputSize = 1 << 16;
+
+}
+
+InflateChunkReader::InflateChunkReader(std::unique_ptr<ChunkReader> source, INFLATE_FORMAT format) :
+	source_(std::move(source)),
+	stream_(std::make_unique<z_stream_s>()),
+	input_(kInputSize),
+	format_(format)
+{
+	// 32 detects a gzip or zlib header, a negative size means raw deflate.
+	if (inflateInit2(stream_.get(), format == ifRaw ? -MAX_WBITS : MAX_WBITS + 32) != Z_OK) {
+		LOG(ERROR) << "Error: Failed to initialise decompression";
+		end_ = true;
+	}
+}
+
+InflateChunkReader::~InflateChunkReader()
+{
+	inflateEnd(stream_.get());
+}
+
+bool InflateChunkReader::Fill()
+{
+	auto read = source_->Read(input_.data(), input_.size());
+	stream_->next_in = reinterpret_cast<Bytef*>(input_.data());
+	stream_->avail_in = static_cast<uInt>(read);
+	return read != 0;
+}
+
+std::size_t InflateChunkReader::Read(char* buffer, std::size_t size)
+{
+	size = std::min<std::size_t>(size, std::numeric_limits<uInt>::max());
+	stream_->next_out = reinterpret_cast<Bytef*>(buffer);
+	stream_->avail_out = static_cast<uInt>(size);
+
+	while (stream_->avail_out && !end_) {
+		if (!stream_->avail_in && !Fill()) {
+			LOG(ERROR) << "Error: Compressed data is truncated";
+			end_ = true;
+			break;
+		}
+
+		auto result = inflate(stream_.get(), Z_NO_FLUSH);
+		if (result == Z_STREAM_END) {
+			// A gzip file can hold several members one after the other.
+			if (format_ == ifGzip && (stream_->avail_in || Fill())) {
+				inflateReset(stream_.get());
+				continue;
+			}
+
+			end_ = true;
+		}
+		else if (result != Z_OK) {
+			LOG(ERROR) << "Error: Invalid compressed data" << (stream_->msg ? std::string(": ") + stream_->msg : std::string());
+			end_ = true;
+		}
+	}
+
+	return size - stream_->avail_out;
+}
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "chunk_reader.h"
+
+struct z_stream_s;
+
+
+// Decompresses deflate data from another reader while it is being parsed,
+// holding only one chunk of the compressed input at a time.
+// Only available when built with GERBER_WITH_ZLIB.
+class InflateChunkReader : public ChunkReader {
+public:
+	enum INFLATE_FORMAT {
+		ifGzip, // gzip or zlib header, detected automatically
+		ifRaw   // no header, as stored in zip archives
+	};
+
+	InflateChunkReader(std::unique_ptr<ChunkReader> source, INFLATE_FORMAT format = ifGzip);
+	~InflateChunkReader();
+
+	InflateChunkReader(const InflateChunkReader&) = delete;
+	InflateChunkReader& operator=(const InflateChunkReader&) = delete;
+
+	std::size_t Read(char* buffer, std::size_t size) override;
+
+private:
+	bool Fill();
+
+	std::unique_ptr<ChunkReader> source_;
+	std::unique_ptr<z_stream_s> stream_;
+	std::vector<char> input_;
+	INFLATE_FORMAT format_;
+	bool end_{ false };
+};
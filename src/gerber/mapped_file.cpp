@@ -0,0 +1,129 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& file_name)
+{
+	Close();
+
+	auto file = CreateFileA(
+		file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) {
+		return false;
+	}
+
+	// The view keeps the mapping object alive, so the handle can be closed right away.
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view) {
+		return false;
+	}
+
+	data_ = static_cast<const char*>(view);
+	size_ = static_cast<std::size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data_) {
+		UnmapViewOfFile(data_);
+	}
+
+	data_ = nullptr;
+	size_ = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& file_name)
+{
+	Close();
+
+	auto fd = open(file_name.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	auto size = static_cast<std::size_t>(info.st_size);
+	auto view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	// The parser walks the file once from front to back: let the kernel read ahead
+	// aggressively and drop pages behind us early.
+#ifdef MADV_SEQUENTIAL
+	madvise(view, size, MADV_SEQUENTIAL);
+#endif
+
+	data_ = static_cast<const char*>(view);
+	size_ = size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data_) {
+		munmap(const_cast<char*>(data_), size_);
+	}
+
+	data_ = nullptr;
+	size_ = 0;
+}
+
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return data_ != nullptr;
+}
+
+const char* MappedFile::Data() const
+{
+	return data_;
+}
+
+std::size_t MappedFile::Size() const
+{
+	return size_;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+
+// Read-only memory mapping of a whole file.
+// Only regular, non-empty files can be mapped; pipes, devices and stdin fail
+// to open, so the caller has to fall back to reading the data into memory.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& file_name);
+	void Close();
+
+	bool IsOpen() const;
+	const char* Data() const;
+	std::size_t Size() const;
+
+private:
+	const char* data_{ nullptr };
+	std::size_t size_{ 0 };
+};
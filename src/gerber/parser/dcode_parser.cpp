@@ -9,7 +9,7 @@ DCodeParser::DCodeParser(Gerber& gerber) :gerber_(gerber) {
 
 }
 
-bool DCodeParser::Run() {
+bool DCodeParser::Run(int code) {
 	if (!gerber_.current_level_) {
 		auto level = std::make_shared<GerberLevel>(gerber_.current_level_, gerber_.units_);
 		gerber_.Add(level);
@@ -17,10 +17,6 @@ bool DCodeParser::Run() {
 
 	gerber_.start_of_level_ = false;
 
-	int code;
-	if (!gerber_.gerber_file_.GetInteger(code))
-		return false;
-
 	switch (code) {
 	case 1: // Draw line, exposure on
 		gerber_.current_level_->exposure_ = geOn;
@@ -35,24 +31,14 @@ bool DCodeParser::Run() {
 		return true;
 
 	default: // Select aperture
-		if (code >= 1000) {
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Aperture code out of range: D" << code;
-			return false;
-		}
-
-		auto aperture = gerber_.apertures_[code];
+		const auto& aperture = gerber_.apertures_.Find(code);
 		if (!aperture) {
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Aperture not defined: D" << code;
+			LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Aperture not defined: D" << code;
 			return false;
 		}
-		gerber_.current_level_->ApertureSelect(aperture, gerber_.gerber_file_.line_number_);
+		gerber_.current_level_->ApertureSelect(aperture, gerber_.gerber_file_);
 		return true;
 	}
 
 	return false;
 }
-
-bool DCodeParser::EndOfFile()
-{
-	return false;
-}
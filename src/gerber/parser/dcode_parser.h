@@ -1,14 +1,12 @@
 #pragma once
-#include "parser.h"
 
 class Gerber;
 
-class DCodeParser : public Parser {
+class DCodeParser {
 public:
 	DCodeParser(Gerber& gerber);
 
-	bool Run() override;
-	bool EndOfFile() override;
+	bool Run(int code);
 
 private:
 	Gerber& gerber_;
@@ -8,16 +8,11 @@
 GCodeParser::GCodeParser(Gerber& gerber) :gerber_(gerber) {
 }
 
-bool GCodeParser::Run() {
+bool GCodeParser::Run(int code) {
 	std::shared_ptr<GerberLevel> level;
 
 	gerber_.start_of_level_ = false;
 
-	int code;
-	if (!gerber_.gerber_file_.GetInteger(code)) {
-		return false;
-	}
-
 	if (!gerber_.current_level_ && code != 4) {
 		level = std::make_shared<GerberLevel>(gerber_.current_level_, gerber_.units_);
 		gerber_.Add(level);
@@ -41,9 +36,7 @@ bool GCodeParser::Run() {
 		gerber_.current_level_->interpolation_ = giCounterclockwiseCircular;
 		return true;
 
-	case 4: // Ignore block
-		while (!gerber_.gerber_file_.EndOfFile() && gerber_.gerber_file_.GetChar() != '*');
-		gerber_.gerber_file_.index_++;
+	case 4: // Ignore block, the tokenizer has already skipped the comment
 		return !gerber_.gerber_file_.EndOfFile();
 
 	case 10: // Linear interpolation 10X scale
@@ -59,38 +52,38 @@ bool GCodeParser::Run() {
 		return true;
 
 	case 36: // Turn on Outline Area Fill
-		gerber_.current_level_->OutlineBegin(gerber_.gerber_file_.line_number_);
+		gerber_.current_level_->OutlineBegin(gerber_.gerber_file_);
 		return true;
 
 	case 37: // Turn off Outline Area Fill
-		gerber_.current_level_->OutlineEnd(gerber_.gerber_file_.line_number_);
+		gerber_.current_level_->OutlineEnd(gerber_.gerber_file_);
 		return true;
 
 	case 54: // Tool prepare
-		if (gerber_warnings) {
-			LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated code: G54";
+		if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+			LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated code: G54";
 		}
 		gerber_.current_level_->exposure_ = geOff;
 		return true;
 
 	case 55: // Flash prepare
-		if (gerber_warnings) {
-			LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated code: G55";
+		if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+			LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated code: G55";
 		}
 		gerber_.current_level_->exposure_ = geOff;
 		return true;
 
 	case 70: // Specify inches
-		if (gerber_warnings) {
-			LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated code: G70";
+		if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+			LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated code: G70";
 		}
 		gerber_.units_ = guInches;
 		gerber_.current_level_->units_ = guInches;
 		return true;
 
 	case 71: // Specify millimeters
-		if (gerber_warnings) {
-			LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated code: G71";
+		if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+			LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated code: G71";
 		}
 		gerber_.units_ = guMillimeters;
 		gerber_.current_level_->units_ = guMillimeters;
@@ -105,28 +98,24 @@ bool GCodeParser::Run() {
 		return true;
 
 	case 90: // Specify absolute format
-		if (gerber_warnings) {
-			LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated code: G90";
+		if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+			LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated code: G90";
 		}
 		gerber_.current_level_->incremental_ = false;
 		return true;
 
 	case 91: // Specify incremental format
-		if (gerber_warnings) {
-			LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated code: G91";
+		if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+			LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated code: G91";
 		}
 
 		return true;
 
 	default:
-		LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unknown G Code: " << code;
+		LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unknown G Code: " << code;
 		break;
 	}
 
 	return false;
 }
 
-bool GCodeParser::EndOfFile()
-{
-	return false;
-}
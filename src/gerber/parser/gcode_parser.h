@@ -1,15 +1,13 @@
 #pragma once
-#include "parser.h"
 
 
 class Gerber;
 
-class GCodeParser : public Parser {
+class GCodeParser {
 public:
 	GCodeParser(Gerber& gerber);
 
-	bool Run() override;
-	bool EndOfFile() override;
+	bool Run(int code);
 
 private:
 	Gerber& gerber_;
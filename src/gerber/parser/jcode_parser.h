@@ -1,15 +0,0 @@
-#pragma once
-#include "parser.h"
-
-class Gerber;
-
-class JCodeParser : public Parser {
-public:
-	JCodeParser(Gerber& gerber);
-
-	bool Run() override;
-	bool EndOfFile() override;
-
-private:
-	Gerber& gerber_;
-};
\ No newline at end of file
@@ -7,30 +7,26 @@ MCodeParser::MCodeParser(Gerber& gerber) : gerber_(gerber)
 {
 }
 
-bool MCodeParser::Run()
+bool MCodeParser::Run(int code)
 {
 	gerber_.start_of_level_ = false;
 
-	int code = 0;
-	if (!gerber_.gerber_file_.GetInteger(code))
-		return false;
-
 	switch (code) {
 	case 0: // Program stop
 	case 1: // Optional stop
-		if (gerber_warnings) {
-			LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated code: M" << code;
+		if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+			LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated code: M" << code;
 		}
 	case 2: // End of program
 		if (gerber_.current_level_) {
 			gerber_.current_level_->exposure_ = geOff;
-			gerber_.current_level_->Do(gerber_.gerber_file_.line_number_);
+			gerber_.current_level_->Do(gerber_.gerber_file_);
 		}
 		end_of_file_ = true;
 		return true;
 
 	default: // Select aperture
-		LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unknown M Code: " << code;
+		LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unknown M Code: " << code;
 		return false;
 	}
 }
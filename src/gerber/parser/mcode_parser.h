@@ -1,14 +1,13 @@
 #pragma once
-#include "parser.h"
 
 class Gerber;
 
-class MCodeParser : public Parser {
+class MCodeParser {
 public:
 	MCodeParser(Gerber& gerber);
 
-	bool Run() override;
-	bool EndOfFile() override;
+	bool Run(int code);
+	bool EndOfFile();
 
 private:
 	Gerber& gerber_;
@@ -3,6 +3,15 @@
 #include <glog/logging.h>
 
 
+namespace {
+
+// Two-letter parameter code packed into an integer, usable as a case label.
+constexpr int Code(char first, char second) {
+	return static_cast<unsigned char>(first) << 8 | static_cast<unsigned char>(second);
+}
+
+}
+
 ParameterParser::ParameterParser(Gerber& gerber) :gerber_(gerber) {
 
 }
@@ -24,187 +33,71 @@ bool ParameterParser::Run() {
 		}
 
 		auto second = gerber_.gerber_file_.PeekNextChar();
-		std::string code;
-		code += first;
-		code += second;
-
-		if (code == "AD") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!ApertureDefinition()) {
-				return false;
-			}
-		}
-		else if (code == "AM") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!ApertureMacro()) {
-				return false;
-			}
-		}
-		else if (code == "AS") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: AS";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!AxisSelect()) {
-				return false;
-			}
-		}
-		else if (code == "FS") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!FormatStatement()) {
-				return false;
-			}
-		}
-		else if (code == "IC") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!IC()) {
-				return false;
-			}
-		}
-		else if (code == "IF") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!IncludeFile()) {
-				return false;
-			}
-		}
-		else if (code == "IJ") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!ImageJustify()) {
-				return false;
-			}
-		}
-		else if (code == "IN") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: IN";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!ImageName()) {
-				return false;
-			}
-		}
-		else if (code == "IO") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!ImageOffset()) {
-				return false;
-			}
-		}
-		else if (code == "IP") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: IP";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!ImagePolarity()) {
-				return false;
-			}
-		}
-		else if (code == "IR") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: IR";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!ImageRotation()) {
-				return false;
-			}
-		}
-		else if (code == "KO") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!Knockout()) {
-				return false;
-			}
-		}
-		else if (code == "LN") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: LN";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!LevelName()) {
-				return false;
-			}
-		}
-		else if (code == "LP") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!LevelPolarity()) {
-				return false;
-			}
-		}
-		else if (code == "MI") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: MI";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!MirrorImage()) {
-				return false;
-			}
-		}
-		else if (code == "MO") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!Mode()) {
-				return false;
-			}
-		}
-		else if (code == "OF") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: OF";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!Offset()) {
-				return false;
-			}
-		}
-		else if (code == "PF") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!PlotFilm()) {
-				return false;
-			}
-		}
-		else if (code == "SF") {
-			if (gerber_warnings) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Deprecated command: SF";
-			}
-			gerber_.gerber_file_.index_ += 2;
-			if (!ScaleFactor()) {
-				return false;
-			}
-		}
-		else if (code == "SR") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!StepAndRepeat()) {
-				return false;
-			}
-		}
-		else if (code == "IA") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!Attribute()) {
-				return false; // Aperture Attribute
-			}
-		}
-		else if (code == "TD") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!Attribute()) {
-				return false; // Delete Attribute
-			}
-		}
-		else if (code == "TF") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!Attribute()) {
-				return false; // File Attribute
+		auto code = Code(first, second);
+
+		switch (code) {
+		case Code('A', 'S'):
+		case Code('I', 'N'):
+		case Code('I', 'P'):
+		case Code('I', 'R'):
+		case Code('L', 'N'):
+		case Code('M', 'I'):
+		case Code('O', 'F'):
+		case Code('S', 'F'):
+			if (gerber_warnings && !gerber_.gerber_file_.quiet_) {
+				LOG(WARNING) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Deprecated command: " << first << second;
 			}
+			break;
+
+		default:
+			break;
 		}
-		else if (code == "TO") {
-			gerber_.gerber_file_.index_ += 2;
-			if (!Attribute()) {
-				return false; // Object Attribute
-			}
+
+		gerber_.gerber_file_.index_ += 2;
+
+		bool result = false;
+		switch (code) {
+		case Code('A', 'D'): result = ApertureDefinition(); break;
+		case Code('A', 'M'): result = ApertureMacro(); break;
+		case Code('A', 'S'): result = AxisSelect(); break;
+		case Code('F', 'S'): result = FormatStatement(); break;
+		case Code('I', 'C'): result = IC(); break;
+		case Code('I', 'F'): result = IncludeFile(); break;
+		case Code('I', 'J'): result = ImageJustify(); break;
+		case Code('I', 'N'): result = ImageName(); break;
+		case Code('I', 'O'): result = ImageOffset(); break;
+		case Code('I', 'P'): result = ImagePolarity(); break;
+		case Code('I', 'R'): result = ImageRotation(); break;
+		case Code('K', 'O'): result = Knockout(); break;
+		case Code('L', 'N'): result = LevelName(); break;
+		case Code('L', 'P'): result = LevelPolarity(); break;
+		case Code('M', 'I'): result = MirrorImage(); break;
+		case Code('M', 'O'): result = Mode(); break;
+		case Code('O', 'F'): result = Offset(); break;
+		case Code('P', 'F'): result = PlotFilm(); break;
+		case Code('S', 'F'): result = ScaleFactor(); break;
+		case Code('S', 'R'): result = StepAndRepeat(); break;
+		case Code('I', 'A'): // Aperture Attribute, old name
+		case Code('T', 'A'): // Aperture Attribute
+		case Code('T', 'D'): // Delete Attribute
+		case Code('T', 'F'): // File Attribute
+		case Code('T', 'O'): // Object Attribute
+			result = Attribute();
+			break;
+
+		default:
+			LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unknown parameter: " << first << second;
+			return false;
 		}
-		else {
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unknown parameter: " << code;
+
+		if (!result) {
 			return false;
 		}
 
 		gerber_.gerber_file_.SkipWhiteSpace();
 	}
 
-	LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Parameter Block without end-delimiter";
+	LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Parameter Block without end-delimiter";
 
 	return false;
 }
@@ -217,6 +110,14 @@ bool ParameterParser::EndOfFile()
 bool ParameterParser::ApertureDefinition() {
 	gerber_.start_of_level_ = false;
 
+	if (gerber_.pass_ == Gerber::ppSegment) { // Already defined by the scan
+		if (!gerber_.gerber_file_.QueryCharUntilEnd('*')) {
+			return false;
+		}
+		gerber_.gerber_file_.index_++;
+		return true;
+	}
+
 	if (!gerber_.gerber_file_.QueryCharUntilNotWhiteSpace('D')) {
 		return false;
 	}
@@ -226,12 +127,12 @@ bool ParameterParser::ApertureDefinition() {
 		return false;
 	}
 
-	std::string aperture_type;
+	std::string_view aperture_type;
 	if (!gerber_.gerber_file_.GetString(aperture_type)) {
 		return false;
 	}
 
-	if (aperture_type.size() > 1) {
+	if (aperture_type.size() != 1) {
 		return ApertureMacro(code, aperture_type);
 	}
 
@@ -501,95 +402,69 @@ bool ParameterParser::AperturePolygon(int code) {
 	return Add(aperture);
 }
 
-bool ParameterParser::ApertureMacro(int code, const std::string& name) {
-	// Variable length array; Null terminated
-	double* modifiers = new double[16];
-	int     modifiers_size = 16;
-	int     modifiers_length_ = 0;
-
-	auto macro = FindMacro(name.c_str());
+bool ParameterParser::ApertureMacro(int code, std::string_view name) {
+	auto macro = FindMacro(name);
 	if (!macro) {
-		LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Macro not defined: " << name;
-		delete[] modifiers;
+		LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Macro not defined: " << name;
 		return false;
 	}
 
 	if (gerber_.gerber_file_.EndOfFile()) {
-		delete[] modifiers;
 		return false;
 	}
 
 	gerber_.gerber_file_.SkipWhiteSpace();
 
-	if (gerber_.gerber_file_.PeekChar() != ',') {
-		auto aperture = std::make_shared<GerberAperture>();
-		aperture->code_ = code;
-		aperture->UseMacro(macro, modifiers, 0);
-		delete[] modifiers;
+	// Reused for every macro aperture, so it only grows on the first few.
+	modifiers_.clear();
 
-		if (!gerber_.gerber_file_.QueryCharUntilNotWhiteSpace('*')) {
+	if (gerber_.gerber_file_.PeekChar() == ',') {
+		gerber_.gerber_file_.index_++;
+
+		double modifier;
+		if (!gerber_.gerber_file_.GetFloat(modifier)) {
 			return false;
 		}
+		modifiers_.push_back(modifier);
 
-		return Add(aperture);
-	}
-	gerber_.gerber_file_.index_++;
-
-	if (!gerber_.gerber_file_.GetFloat(*modifiers)) {
-		delete[] modifiers;
-		return false;
-	}
-	modifiers_length_++;
-
-	gerber_.gerber_file_.SkipWhiteSpace();
+		gerber_.gerber_file_.SkipWhiteSpace();
 
-	while (!gerber_.gerber_file_.EndOfFile()) {
-		if (gerber_.gerber_file_.PeekChar() == 'X') {
+		while (!gerber_.gerber_file_.EndOfFile() && gerber_.gerber_file_.PeekChar() == 'X') {
 			gerber_.gerber_file_.index_++;
 
-			if (modifiers_length_ == modifiers_size) {
-				modifiers_size <<= 1;
-				auto temp_modifiers = new double[modifiers_size];
-				for (int j = 0; j < modifiers_length_; j++) {
-					temp_modifiers[j] = modifiers[j];
-				}
-				delete[] modifiers;
-				modifiers = temp_modifiers;
-			}
-
-			if (!gerber_.gerber_file_.GetFloat(*(modifiers + modifiers_length_))) {
-				delete[] modifiers;
+			if (!gerber_.gerber_file_.GetFloat(modifier)) {
 				return false;
 			}
-			modifiers_length_++;
-		}
-		else {
-			break;
+			modifiers_.push_back(modifier);
+
+			gerber_.gerber_file_.SkipWhiteSpace();
 		}
-		gerber_.gerber_file_.SkipWhiteSpace();
 	}
 
 	if (!gerber_.gerber_file_.QueryCharUntilNotWhiteSpace('*')) {
-		delete[] modifiers;
 		return false;
 	}
 
 	auto aperture = std::make_shared<GerberAperture>();
 	aperture->code_ = code;
-	aperture->UseMacro(macro, modifiers, modifiers_length_);
+	aperture->UseMacro(macro, modifiers_.data(), static_cast<int>(modifiers_.size()));
 	return Add(aperture);
 }
 
 bool ParameterParser::ApertureMacro() {
 	gerber_.start_of_level_ = false;
 
-	std::string name;
+	if (gerber_.pass_ == Gerber::ppSegment) { // Only used by apertures defined by the scan
+		return gerber_.gerber_file_.QueryCharUntilEnd('%');
+	}
+
+	std::string_view name;
 	if (!gerber_.gerber_file_.GetString(name)) {
 		return false;
 	}
 
 	auto macro = std::make_shared<GerberMacro>();
-	macro->Name = name;
+	macro->Name.assign(name);
 
 	if (!gerber_.gerber_file_.QueryCharUntilNotWhiteSpace('*')) {
 		return false;
@@ -600,11 +475,11 @@ bool ParameterParser::ApertureMacro() {
 	auto j = gerber_.gerber_file_.index_;
 	while (!gerber_.gerber_file_.EndOfFile()) {
 		if (gerber_.gerber_file_.PeekChar() == '%') {
-			if (macro->LoadMacro(gerber_.gerber_file_.buffer_.data() + j, gerber_.gerber_file_.index_ - j, gerber_.units_ == guInches)) {
+			if (macro->LoadMacro(gerber_.gerber_file_.buffer_.data() + j, gerber_.gerber_file_.index_ - j, gerber_.units_ == guInches, gerber_.gerber_file_.quiet_)) {
 				Add(macro);
 			}
 			else {
-				LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Invalid aperture macro";
+				LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Invalid aperture macro";
 			}
 			return true;
 		}
@@ -616,7 +491,7 @@ bool ParameterParser::ApertureMacro() {
 }
 
 bool ParameterParser::AxisSelect() {
-	LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: AxisSelect ignored";
+	LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: AxisSelect ignored";
 
 	gerber_.start_of_level_ = false;
 	return gerber_.gerber_file_.QueryCharUntilEnd('%');
@@ -669,7 +544,7 @@ bool ParameterParser::FormatStatement() {
 			return true;
 
 		default:
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unrecognised FS modifier: " << gerber_.gerber_file_.PeekChar();
+			LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unrecognised FS modifier: " << gerber_.gerber_file_.PeekChar();
 			return false;
 		}
 		gerber_.gerber_file_.index_++;
@@ -680,14 +555,14 @@ bool ParameterParser::FormatStatement() {
 }
 
 bool ParameterParser::IC() {
-	LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: IC Parameter ignored";
+	LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: IC Parameter ignored";
 
 	gerber_.start_of_level_ = false;
 	return gerber_.gerber_file_.QueryCharUntilEnd('%');
 }
 
 bool ParameterParser::MirrorImage() {
-	LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: MirrorImage not implemented";
+	LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: MirrorImage not implemented";
 
 	gerber_.start_of_level_ = false;
 
@@ -726,7 +601,7 @@ bool ParameterParser::Mode() {
 
 		}
 		else {
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unrecognised MO modifier: " << gerber_.gerber_file_.PeekChar();
+			LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unrecognised MO modifier: " << gerber_.gerber_file_.PeekChar();
 			return false;
 		}
 		gerber_.gerber_file_.SkipWhiteSpace();
@@ -759,12 +634,12 @@ bool ParameterParser::Offset() {
 
 		case '*':
 			if (offset_a_ != 0.0 || offset_b_ != 0.0) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Offsets ignored";
+				LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Offsets ignored";
 			}
 			return true;
 
 		default:
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unrecognised Offset Modifier: " << gerber_.gerber_file_.PeekChar();
+			LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unrecognised Offset Modifier: " << gerber_.gerber_file_.PeekChar();
 			return false;
 		}
 		gerber_.gerber_file_.SkipWhiteSpace();
@@ -798,12 +673,12 @@ bool ParameterParser::ScaleFactor() {
 
 		case '*':
 			if (scale_b_ != 1.0 || scale_b_ != 1.0) {
-				LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: Scale Factor ignored";
+				LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: Scale Factor ignored";
 			}
 			return true;
 
 		default:
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unrecognised Scale Factor Modifier: " << gerber_.gerber_file_.PeekChar();
+			LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unrecognised Scale Factor Modifier: " << gerber_.gerber_file_.PeekChar();
 			return false;
 		}
 		gerber_.gerber_file_.SkipWhiteSpace();
@@ -813,28 +688,27 @@ bool ParameterParser::ScaleFactor() {
 }
 
 bool ParameterParser::Add(std::shared_ptr<GerberAperture> aperture) {
-	if (aperture->code_ >= 1000) {
-		LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Aperture code out of range: D" << aperture->code_;
+	if (aperture->code_ < 0) {
+		LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Aperture code out of range: D" << aperture->code_;
 		return false;
 	}
-	if (gerber_.apertures_[aperture->code_]) {
-		LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Overloading of apertures not supported: D" << aperture->code_;
+	if (!gerber_.apertures_.Add(aperture)) {
+		LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Overloading of apertures not supported: D" << aperture->code_;
 		return false;
 	}
 
-	gerber_.apertures_[aperture->code_] = aperture;
 	return true;
 }
 
 bool ParameterParser::IncludeFile() {
-	LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: IncludeFile not implemented";
+	LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: IncludeFile not implemented";
 
 	gerber_.start_of_level_ = false;
 	return gerber_.gerber_file_.QueryCharUntilEnd('%');
 }
 
 bool ParameterParser::ImageJustify() {
-	LOG(WARNING) << "Line " << " - Warning: ImageJustify ignored" << gerber_.gerber_file_.line_number_;
+	LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << " - Warning: ImageJustify ignored" << gerber_.gerber_file_.LineNumber();
 
 	gerber_.start_of_level_ = false;
 	return gerber_.gerber_file_.QueryCharUntilEnd('%');
@@ -843,9 +717,11 @@ bool ParameterParser::ImageJustify() {
 bool ParameterParser::ImageName() {
 	gerber_.start_of_level_ = false;
 
-	if (!gerber_.gerber_file_.GetString(gerber_.name_)) {
+	std::string_view name;
+	if (!gerber_.gerber_file_.GetString(name)) {
 		return false;
 	}
+	gerber_.name_.append(name);
 
 	gerber_.gerber_file_.SkipWhiteSpace();
 	if (!gerber_.gerber_file_.QueryCharUntilNotWhiteSpace('*')) {
@@ -856,7 +732,7 @@ bool ParameterParser::ImageName() {
 }
 
 bool ParameterParser::ImageOffset() {
-	LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: ImageOffset not implemented";
+	LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: ImageOffset not implemented";
 	gerber_.start_of_level_ = false;
 	return gerber_.gerber_file_.QueryCharUntilEnd('%');
 }
@@ -880,7 +756,7 @@ bool ParameterParser::ImagePolarity() {
 		gerber_.negative_ = true;
 	}
 	else {
-		LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unknown Image Polarity";
+		LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unknown Image Polarity";
 		return false;
 	}
 	gerber_.gerber_file_.index_ += 3;
@@ -893,19 +769,19 @@ bool ParameterParser::ImagePolarity() {
 }
 
 bool ParameterParser::ImageRotation() {
-	LOG(WARNING) << "Line " << gerber_.gerber_file_.line_number_ << " - Warning: ImageRotation not implemented";
+	LOG_IF(WARNING, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Warning: ImageRotation not implemented";
 
 	gerber_.start_of_level_ = false;
 	return gerber_.gerber_file_.QueryCharUntilEnd('*');
 }
 
 bool ParameterParser::Knockout() {
-	LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Knockout not implemented";
+	LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Knockout not implemented";
 	return false;
 }
 
 bool ParameterParser::LevelName() {
-	std::string name;
+	std::string_view name;
 	if (!gerber_.gerber_file_.GetString(name)) {
 		return false;
 	}
@@ -916,11 +792,11 @@ bool ParameterParser::LevelName() {
 
 	if (!gerber_.start_of_level_) {
 		auto level = std::make_shared<GerberLevel>(gerber_.current_level_, gerber_.units_);
-		level->SetName(name);
+		level->SetName(std::string(name));
 		gerber_.Add(level);
 	}
 	else {
-		gerber_.current_level_->SetName(name);
+		gerber_.current_level_->SetName(std::string(name));
 	}
 
 	gerber_.start_of_level_ = true;
@@ -949,7 +825,7 @@ bool ParameterParser::LevelPolarity() {
 		break;
 
 	default:
-		LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unknown level polarity: " << gerber_.gerber_file_.PeekChar();
+		LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unknown level polarity: " << gerber_.gerber_file_.PeekChar();
 		return false;
 	}
 
@@ -961,7 +837,7 @@ bool ParameterParser::LevelPolarity() {
 }
 
 bool ParameterParser::PlotFilm() {
-	LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: PlotFilm not implemented";
+	LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: PlotFilm not implemented";
 	gerber_.start_of_level_ = false;
 	return gerber_.gerber_file_.QueryCharUntilEnd('%');
 }
@@ -1018,7 +894,7 @@ bool ParameterParser::StepAndRepeat() {
 			return true;
 
 		default:
-			LOG(ERROR) << "Line " << gerber_.gerber_file_.line_number_ << " - Error: Unrecognised Step-and-Repeat Modifier: " << gerber_.gerber_file_.PeekChar();
+			LOG_IF(ERROR, !gerber_.gerber_file_.quiet_) << "Line " << gerber_.gerber_file_.LineNumber() << " - Error: Unrecognised Step-and-Repeat Modifier: " << gerber_.gerber_file_.PeekChar();
 			return false;
 		}
 
@@ -1042,7 +918,7 @@ void ParameterParser::Add(std::shared_ptr<GerberMacro> Macro) {
 	macros_.push_back(Macro);
 }
 
-std::shared_ptr<GerberMacro> ParameterParser::FindMacro(const std::string& Name) {
+std::shared_ptr<GerberMacro> ParameterParser::FindMacro(std::string_view Name) {
 	for (const auto& macro : macros_) {
 		if (macro->Name == Name) {
 			return macro;
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include "parser.h"
@@ -23,7 +24,7 @@ private:
 	bool ApertureRectangle(int code);
 	bool ApertureObround(int code);
 	bool AperturePolygon(int code);
-	bool ApertureMacro(int code, const std::string& name);
+	bool ApertureMacro(int code, std::string_view name);
 
 	bool ApertureMacro();
 
@@ -61,7 +62,7 @@ private:
 	bool PlotFilm();
 
 	void Add(std::shared_ptr<GerberMacro> macro);
-	std::shared_ptr<GerberMacro> FindMacro(const std::string& name);
+	std::shared_ptr<GerberMacro> FindMacro(std::string_view name);
 
 	double Get_mm(double  number);
 
@@ -72,4 +73,5 @@ private:
 	double scale_a_{ 1.0 }, scale_b_{ 1.0 };
 
 	std::vector<std::shared_ptr<GerberMacro>> macros_;
+	std::vector<double> modifiers_;
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "tokenizer.h"
+#include "gerber.h"
+
+#include <array>
+
+
+namespace {
+
+constexpr std::array<GERBER_WORD, 256> MakeWordTable() {
+	std::array<GERBER_WORD, 256> table{};
+	for (auto& kind : table) {
+		kind = gwParameter;
+	}
+
+	table['X'] = gwX;
+	table['Y'] = gwY;
+	table['I'] = gwI;
+	table['J'] = gwJ;
+	table['D'] = gwD;
+	table['G'] = gwG;
+	table['M'] = gwM;
+	table['N'] = gwN;
+	table['*'] = gwEndOfBlock;
+	return table;
+}
+
+// Word kind by its first character. Anything that is not a known code starts
+// an extended command, which ParameterParser reads up to the matching delimiter.
+constexpr auto kWordTable = MakeWordTable();
+
+}
+
+Tokenizer::Tokenizer(Gerber& gerber) :gerber_(gerber)
+{
+}
+
+void Tokenizer::Next(std::vector<GerberWord>& words)
+{
+	auto& file = gerber_.gerber_file_;
+	const auto& format = gerber_.format_;
+
+	words.clear();
+
+	while (words.size() < kBatchSize) {
+		// Prefetch has made the first statement resident, only the following
+		// ones have to be checked.
+		if (!words.empty() && !file.StatementBuffered()) {
+			break;
+		}
+
+		if (file.SkipWhiteSpace()) {
+			break;
+		}
+
+		GerberWord word{ kWordTable[static_cast<unsigned char>(file.GetChar())], 0, 0.0, 0 };
+
+		bool valid = true;
+		switch (word.kind_) {
+		case gwX:
+		case gwI:
+			valid = file.GetCoordinate(word.value_, format.XInteger, format.XDecimal, format.omit_trailing_zeroes_);
+			break;
+
+		case gwY:
+		case gwJ:
+			valid = file.GetCoordinate(word.value_, format.YInteger, format.YDecimal, format.omit_trailing_zeroes_);
+			break;
+
+		case gwD:
+		case gwM:
+			valid = file.GetInteger(word.code_);
+			break;
+
+		case gwG:
+			valid = file.GetInteger(word.code_);
+			if (valid && word.code_ == 4) { // Comment, skip the block and the character after it
+				file.QueryCharUntilEnd('*');
+				file.index_ += 2;
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (!valid) {
+			word.kind_ = gwInvalid;
+		}
+
+		word.end_ = file.index_;
+		words.push_back(word);
+
+		switch (word.kind_) {
+		case gwM:
+		case gwN:
+		case gwParameter:
+		case gwInvalid:
+			return;
+
+		default:
+			break;
+		}
+	}
+}
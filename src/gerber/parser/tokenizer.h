@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class Gerber;
+
+enum GERBER_WORD {
+	gwX,
+	gwY,
+	gwI,
+	gwJ,
+	gwD,
+	gwG,
+	gwM,
+	gwN,
+	gwEndOfBlock, // '*'
+	gwParameter,  // Extended command, the text is parsed by ParameterParser
+	gwInvalid     // The word could not be decoded
+};
+
+struct GerberWord {
+	GERBER_WORD kind_;
+	int code_;          // D, G and M words
+	double value_;      // X, Y, I and J words, already scaled by the coordinate format
+	std::size_t end_;   // Offset in the source text just behind the word
+};
+
+// First stage of the parser: turns the source text into a flat list of
+// decoded words, which Gerber then applies to the level and plotter state.
+class Tokenizer {
+public:
+	static constexpr std::size_t kBatchSize = 4096;
+
+	Tokenizer(Gerber& gerber);
+
+	// Replaces words with the next batch, starting at the current position.
+	// A batch ends after an extended command, an M or N code or an invalid word,
+	// since those can change how the following text has to be read. In
+	// streaming mode it also ends where the resident text runs out.
+	void Next(std::vector<GerberWord>& words);
+
+private:
+	Gerber& gerber_;
+};
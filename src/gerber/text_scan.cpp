@@ -0,0 +1,162 @@
+#include "text_scan.h"
+#include <bitset>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GERBER_SCAN_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GERBER_SCAN_SSE2 1
+#endif
+
+
+namespace {
+
+inline int CountTrailingZeros(unsigned mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+inline int PopCount(unsigned mask)
+{
+	return static_cast<int>(std::bitset<32>(mask).count());
+}
+
+// Each matcher tests single characters as well as whole blocks, where bit n
+// of the result belongs to byte n of the block.
+
+struct NonWhiteSpace {
+	static bool Match(char c) {
+		return c != ' ' && c != '\t' && c != '\r' && c != '\n';
+	}
+
+#ifdef GERBER_SCAN_SSE2
+	static unsigned Match(__m128i block) {
+		auto space = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')))
+		);
+		return ~static_cast<unsigned>(_mm_movemask_epi8(space)) & 0xFFFF;
+	}
+#endif
+
+#ifdef GERBER_SCAN_AVX2
+	static unsigned Match(__m256i block) {
+		auto space = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')))
+		);
+		return ~static_cast<unsigned>(_mm256_movemask_epi8(space));
+	}
+#endif
+};
+
+struct Character {
+	char c_;
+
+	bool Match(char c) const {
+		return c == c_;
+	}
+
+#ifdef GERBER_SCAN_SSE2
+	unsigned Match(__m128i block) const {
+		return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c_))));
+	}
+#endif
+
+#ifdef GERBER_SCAN_AVX2
+	unsigned Match(__m256i block) const {
+		return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c_))));
+	}
+#endif
+};
+
+template <typename Matcher>
+std::size_t Find(const char* data, std::size_t begin, std::size_t end, const Matcher& matcher) {
+	auto i = begin;
+
+	// Runs of white space between statements are usually short, so test the
+	// first character before going block-wise.
+	if (i < end && matcher.Match(data[i])) {
+		return i;
+	}
+
+#ifdef GERBER_SCAN_AVX2
+	for (; i + 32 <= end; i += 32) {
+		auto mask = matcher.Match(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+		if (mask) {
+			return i + CountTrailingZeros(mask);
+		}
+	}
+#endif
+
+#ifdef GERBER_SCAN_SSE2
+	for (; i + 16 <= end; i += 16) {
+		auto mask = matcher.Match(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+		if (mask) {
+			return i + CountTrailingZeros(mask);
+		}
+	}
+#endif
+
+	for (; i < end; i++) {
+		if (matcher.Match(data[i])) {
+			return i;
+		}
+	}
+
+	return end;
+}
+
+template <typename Matcher>
+std::size_t Count(const char* data, std::size_t begin, std::size_t end, const Matcher& matcher) {
+	std::size_t count = 0;
+	auto i = begin;
+
+#ifdef GERBER_SCAN_AVX2
+	for (; i + 32 <= end; i += 32) {
+		count += PopCount(matcher.Match(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))));
+	}
+#endif
+
+#ifdef GERBER_SCAN_SSE2
+	for (; i + 16 <= end; i += 16) {
+		count += PopCount(matcher.Match(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))));
+	}
+#endif
+
+	for (; i < end; i++) {
+		count += matcher.Match(data[i]);
+	}
+
+	return count;
+}
+
+}
+
+std::size_t FindNonWhiteSpace(const char* data, std::size_t begin, std::size_t end)
+{
+	return Find(data, begin, end, NonWhiteSpace());
+}
+
+std::size_t FindChar(const char* data, std::size_t begin, std::size_t end, char c)
+{
+	return Find(data, begin, end, Character{ c });
+}
+
+std::size_t CountChar(const char* data, std::size_t begin, std::size_t end, char c)
+{
+	return Count(data, begin, end, Character{ c });
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+
+// Block-wise scanning of Gerber source text. Each function looks at
+// [begin, end) of data and returns an offset into data, end if nothing matched.
+// Uses AVX2 when the compiler targets it, SSE2 on x86 and a plain loop elsewhere.
+
+// First character that is not a space, tab, carriage return or line feed.
+std::size_t FindNonWhiteSpace(const char* data, std::size_t begin, std::size_t end);
+
+std::size_t FindChar(const char* data, std::size_t begin, std::size_t end, char c);
+
+std::size_t CountChar(const char* data, std::size_t begin, std::size_t end, char c);
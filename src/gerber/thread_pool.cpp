@@ -0,0 +1,51 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		threads_.emplace_back(&ThreadPool::Work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	condition_.notify_all();
+
+	for (auto& thread : threads_) {
+		thread.join();
+	}
+}
+
+unsigned ThreadPool::Size() const
+{
+	return static_cast<unsigned>(threads_.size());
+}
+
+void ThreadPool::Work()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+			if (tasks_.empty()) {
+				return;
+			}
+
+			task = std::move(tasks_.front());
+			tasks_.pop();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of worker threads running queued tasks in submission order.
+class ThreadPool {
+public:
+	// 0 starts one thread per hardware thread.
+	explicit ThreadPool(unsigned threads = 0);
+	// Finishes the queued tasks before joining the threads.
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned Size() const;
+
+	template <typename Function>
+	auto Submit(Function function) -> std::future<decltype(function())> {
+		using Result = decltype(function());
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+		auto future = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.emplace([task]() { (*task)(); });
+		}
+		condition_.notify_one();
+
+		return future;
+	}
+
+private:
+	void Work();
+
+	std::vector<std::thread> threads_;
+	std::queue<std::function<void()>> tasks_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	bool stop_{ false };
+};
@@ -0,0 +1,174 @@
+#include "zip_archive.h"
+#include "inflate_chunk_reader.h"
+#include <glog/logging.h>
+
+#include <algorithm>
+
+
+namespace {
+
+constexpr std::uint32_t kEndOfCentralDirectory = 0x06054b50;
+constexpr std::uint32_t kCentralDirectoryHeader = 0x02014b50;
+constexpr std::uint32_t kLocalFileHeader = 0x04034b50;
+
+constexpr std::size_t kEndOfCentralDirectorySize = 22;
+constexpr std::size_t kCentralDirectoryHeaderSize = 46;
+constexpr std::size_t kLocalFileHeaderSize = 30;
+
+constexpr std::uint16_t kStored = 0;
+constexpr std::uint16_t kDeflated = 8;
+
+// Zip fields are little-endian and not aligned.
+std::uint16_t Read16(const char* data) {
+	auto bytes = reinterpret_cast<const unsigned char*>(data);
+	return static_cast<std::uint16_t>(bytes[0] | bytes[1] << 8);
+}
+
+std::uint32_t Read32(const char* data) {
+	return Read16(data) | static_cast<std::uint32_t>(Read16(data + 2)) << 16;
+}
+
+}
+
+bool ZipArchive::Open(const std::string& file_name)
+{
+	Close();
+
+	if (!mapped_file_.Open(file_name)) {
+		LOG(ERROR) << "Error: Failed to open zip archive " << file_name;
+		return false;
+	}
+
+	auto data = mapped_file_.Data();
+	auto size = mapped_file_.Size();
+
+	// The end record is followed by a comment of at most 64 KB.
+	std::size_t end = size;
+	for (std::size_t i = size >= kEndOfCentralDirectorySize ? size - kEndOfCentralDirectorySize + 1 : 0; i-- > 0;) {
+		if (Read32(data + i) == kEndOfCentralDirectory) {
+			end = i;
+			break;
+		}
+		if (size - i > kEndOfCentralDirectorySize + 0xffff) {
+			break;
+		}
+	}
+
+	if (end == size) {
+		LOG(ERROR) << "Error: Not a zip archive: " << file_name;
+		Close();
+		return false;
+	}
+
+	std::size_t count = Read16(data + end + 10);
+	std::size_t offset = Read32(data + end + 16);
+
+	for (std::size_t i = 0; i < count; i++) {
+		if (offset + kCentralDirectoryHeaderSize > end || Read32(data + offset) != kCentralDirectoryHeader) {
+			LOG(ERROR) << "Error: Invalid central directory in " << file_name;
+			Close();
+			return false;
+		}
+
+		ENTRY entry;
+		auto flags = Read16(data + offset + 8);
+		entry.method_ = Read16(data + offset + 10);
+		entry.compressed_size_ = Read32(data + offset + 20);
+		entry.size_ = Read32(data + offset + 24);
+		entry.offset_ = Read32(data + offset + 42);
+
+		std::size_t name_size = Read16(data + offset + 28);
+		std::size_t extra_size = Read16(data + offset + 30);
+		std::size_t comment_size = Read16(data + offset + 32);
+		entry.name_.assign(data + offset + kCentralDirectoryHeaderSize, std::min(name_size, end - offset - kCentralDirectoryHeaderSize));
+		offset += kCentralDirectoryHeaderSize + name_size + extra_size + comment_size;
+
+		if (flags & 1) {
+			LOG(ERROR) << "Error: Encrypted zip member not supported: " << entry.name_;
+			continue;
+		}
+
+		if (entry.compressed_size_ == 0xffffffff || entry.size_ == 0xffffffff || entry.offset_ == 0xffffffff) {
+			LOG(ERROR) << "Error: ZIP64 member not supported: " << entry.name_;
+			continue;
+		}
+
+		entries_.push_back(entry);
+	}
+
+	return true;
+}
+
+void ZipArchive::Close()
+{
+	entries_.clear();
+	mapped_file_.Close();
+}
+
+std::vector<std::string> ZipArchive::Names() const
+{
+	std::vector<std::string> names;
+	for (const auto& entry : entries_) {
+		if (!entry.name_.empty() && entry.name_.back() != '/') {
+			names.push_back(entry.name_);
+		}
+	}
+
+	return names;
+}
+
+std::size_t ZipArchive::Size(const std::string& name) const
+{
+	auto entry = Find(name);
+	return entry ? entry->size_ : 0;
+}
+
+std::unique_ptr<ChunkReader> ZipArchive::OpenMember(const std::string& name) const
+{
+	auto entry = Find(name);
+	if (!entry) {
+		LOG(ERROR) << "Error: No zip member named " << name;
+		return nullptr;
+	}
+
+	auto data = mapped_file_.Data();
+	auto size = mapped_file_.Size();
+
+	// The local header repeats the name, but its extra field can differ from
+	// the one in the central directory.
+	auto offset = entry->offset_;
+	if (offset + kLocalFileHeaderSize > size || Read32(data + offset) != kLocalFileHeader) {
+		LOG(ERROR) << "Error: Invalid local header of zip member " << name;
+		return nullptr;
+	}
+
+	offset += kLocalFileHeaderSize + Read16(data + offset + 26) + Read16(data + offset + 28);
+	if (offset > size || entry->compressed_size_ > size - offset) {
+		LOG(ERROR) << "Error: Zip member " << name << " is truncated";
+		return nullptr;
+	}
+
+	auto reader = std::make_unique<MemoryChunkReader>(data + offset, entry->compressed_size_);
+	switch (entry->method_) {
+	case kStored:
+		return reader;
+
+#ifdef GERBER_WITH_ZLIB
+	case kDeflated:
+		return std::make_unique<InflateChunkReader>(std::move(reader), InflateChunkReader::ifRaw);
+#endif
+
+	default:
+		LOG(ERROR) << "Error: Unsupported compression method " << entry->method_ << " of zip member " << name;
+		return nullptr;
+	}
+}
+
+const ZipArchive::ENTRY* ZipArchive::Find(const std::string& name) const
+{
+	auto entry = std::find_if(entries_.begin(), entries_.end(), [&name](const ENTRY& entry) {
+		return entry.name_ == name;
+	});
+
+	return entry != entries_.end() ? &*entry : nullptr;
+}
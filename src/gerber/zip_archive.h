@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "chunk_reader.h"
+#include "mapped_file.h"
+
+
+// Read-only access to the members of a zip archive, without extracting them.
+// The archive is memory mapped and has to outlive the readers it opens.
+// Stored and deflated members are supported, ZIP64 and encryption are not.
+class ZipArchive {
+public:
+	bool Open(const std::string& file_name);
+	void Close();
+
+	// Names of the file members, directories are left out.
+	std::vector<std::string> Names() const;
+	// Uncompressed size of the member, 0 if there is none with that name.
+	std::size_t Size(const std::string& name) const;
+
+	// Reader of the uncompressed member, nullptr if it cannot be read.
+	std::unique_ptr<ChunkReader> OpenMember(const std::string& name) const;
+
+private:
+	struct ENTRY {
+		std::string name_;
+		std::uint16_t method_;
+		std::size_t compressed_size_;
+		std::size_t size_;
+		std::size_t offset_; // Of the local file header
+	};
+
+	const ENTRY* Find(const std::string& name) const;
+
+	MappedFile mapped_file_;
+	std::vector<ENTRY> entries_;
+};
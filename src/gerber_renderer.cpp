@@ -3,6 +3,8 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+
 
 GerberRender::GerberRender(Engine* engine) :
 	engine_(engine)
@@ -13,16 +15,24 @@ GerberRender::~GerberRender() {
 }
 
 
-int GerberRender::RenderLayer(std::shared_ptr<GerberLevel> level) {
-	engine_->BeginDraw(level->negative_);
+int GerberRender::RenderLayer(CONTEXT& context, const GerberLevel& level, const BoundBox* region) const {
+	engine_->BeginDraw(level.negative_);
 
-	if (engine_->convert_strokes2fills_) {
-		level->ConvertStrokesToFills();
+	const auto& source = Source(level);
+
+	// Half a pixel of error cannot be seen
+	const auto detail = context.pixel_ > 0.0 ? source.Detail(context.pixel_ / 2.0) : nullptr;
+	const auto& commands = detail ? detail->RenderCommands() : source.RenderCommands();
+	const auto& index = detail ? detail->Index() : source.Index();
+
+	if (region && index.Valid()) {
+		auto ret = RenderVisible(context, commands, index, *region);
+		engine_->EndDraw();
+		return ret;
 	}
 
-	auto renders = level->RenderCommands();
-	for (const auto& render : renders) {
-		if (auto ret = Draw(render)) {
+	for (const auto& render : commands) {
+		if (auto ret = Draw(context, render)) {
 			engine_->EndDraw();
 			return ret;
 		}
@@ -32,27 +42,106 @@ int GerberRender::RenderLayer(std::shared_ptr<GerberLevel> level) {
 	return 0;
 }
 
-int GerberRender::Draw(std::shared_ptr<RenderCommand> render)
+const GerberLevel& GerberRender::Source(const GerberLevel& level) const {
+	return engine_->convert_strokes2fills_ ? level.Fills() : level;
+}
+
+void GerberRender::Query(const GerberLevel& level, const SpatialIndex& index, const BoundBox& region, std::vector<std::uint32_t>& result) {
+	// A copy is visible where the region, moved back by its step, is.
+	const auto first = result.size();
+	for (int y = 0; y < level.CountY; y++) {
+		for (int x = 0; x < level.CountX; x++) {
+			index.Query(BoundBox(
+				region.Left() - x * level.StepX,
+				region.Right() - x * level.StepX,
+				region.Top() - y * level.StepY,
+				region.Bottom() - y * level.StepY
+			), result);
+		}
+	}
+	if (level.CountX * level.CountY > 1) {
+		std::sort(result.begin() + first, result.end());
+		result.erase(std::unique(result.begin() + first, result.end()), result.end());
+	}
+}
+
+int GerberRender::RenderVisible(CONTEXT& context, const CommandStore& commands, const SpatialIndex& index, const BoundBox& region) const {
+	context.visible_.clear();
+	index.Query(region, context.visible_);
+
+	// The aperture and outline of each primitive are restored before it,
+	// since the commands that set them may have been skipped.
+	auto select = SpatialIndex::kNone;
+	auto outline = SpatialIndex::kNone;
+	// Both only move forward, as primitives come in increasing order
+	auto render = commands.begin();
+	auto selected = commands.begin();
+	for (auto i : context.visible_) {
+		const auto& primitive = index[i];
+
+		const auto reselect = primitive.select_ != select && primitive.select_ != SpatialIndex::kNone;
+		auto begin_outline = false;
+		if (primitive.outline_ != outline) {
+			if (outline != SpatialIndex::kNone) {
+				Draw(context, RenderCommand(RenderCommand::gcEndOutline));
+			}
+			outline = primitive.outline_;
+			begin_outline = outline != SpatialIndex::kNone;
+		}
+
+		// In the order they came in, if both were skipped
+		if (begin_outline && (!reselect || outline < primitive.select_)) {
+			Draw(context, RenderCommand(RenderCommand::gcBeginOutline));
+			begin_outline = false;
+		}
+		if (reselect) {
+			select = primitive.select_;
+			selected.SkipTo(select);
+			if (auto ret = Draw(context, *selected)) {
+				return ret;
+			}
+		}
+		if (begin_outline) {
+			Draw(context, RenderCommand(RenderCommand::gcBeginOutline));
+		}
+
+		render.SkipTo(primitive.first_);
+		for (auto command = primitive.first_; command < primitive.last_; command++, ++render) {
+			if (auto ret = Draw(context, *render)) {
+				return ret;
+			}
+		}
+	}
+
+	if (outline != SpatialIndex::kNone) {
+		Draw(context, RenderCommand(RenderCommand::gcEndOutline));
+	}
+
+	return 0;
+}
+
+int GerberRender::Draw(CONTEXT& context, const RenderCommand& render) const
 {
-	switch (render->command_) {
+	switch (render.command_) {
 	case RenderCommand::gcRectangle:
-		engine_->DrawRectangle(render->X, render->Y, render->W, render->H);
+		engine_->DrawRectangle(render.X, render.Y, render.W, render.H);
 		break;
 
 	case RenderCommand::gcCircle:
-		engine_->DrawCircle(render->X, render->Y, render->W / 2.0);
+		engine_->DrawCircle(render.X, render.Y, render.W / 2.0);
 		break;
 
 	case RenderCommand::gcBeginLine:
-		if (outline_path_) {
-			engine_->BeginLine(render->X, render->Y);
+		if (context.outline_path_) {
+			engine_->BeginLine(render.X, render.Y);
 		}
-		else if (solid_circle_) {
-			engine_->BeginSolidCircleLine(render->X, render->Y, line_width_);
+		else if (context.solid_circle_) {
+			// Thinner than a pixel is drawn as a hairline
+			engine_->BeginSolidCircleLine(render.X, render.Y, context.pixel_ > 0.0 && context.line_width_ < context.pixel_ ? 0.0 : context.line_width_);
 		}
-		else if (solid_rectangle_) {
-			rect_x_ = render->X;
-			rect_y_ = render->Y;
+		else if (context.solid_rectangle_) {
+			context.rect_x_ = render.X;
+			context.rect_y_ = render.Y;
 		}
 		else {
 			LOG(ERROR) << "Error: Only solid circular or rectangular apertures can be used for paths";
@@ -61,17 +150,17 @@ int GerberRender::Draw(std::shared_ptr<RenderCommand> render)
 		break;
 
 	case RenderCommand::gcLine:
-		if (outline_path_ || solid_circle_) {
-			engine_->DrawLine(render->X, render->Y);
+		if (context.outline_path_ || context.solid_circle_) {
+			engine_->DrawLine(render.X, render.Y);
 		}
-		else if (solid_rectangle_) {
+		else if (context.solid_rectangle_) {
 			engine_->DrawRectLine(
-				rect_x_, rect_y_,
-				render->X, render->Y,
-				rect_w_, rect_h_
+				context.rect_x_, context.rect_y_,
+				render.X, render.Y,
+				context.rect_w_, context.rect_h_
 			);
-			rect_x_ = render->X;
-			rect_y_ = render->Y;
+			context.rect_x_ = render.X;
+			context.rect_y_ = render.Y;
 
 		}
 		else {
@@ -81,8 +170,8 @@ int GerberRender::Draw(std::shared_ptr<RenderCommand> render)
 		break;
 
 	case RenderCommand::gcArc:
-		if (outline_path_ || solid_circle_) {
-			engine_->DrawArc(render->X, render->Y, render->A);
+		if (context.outline_path_ || context.solid_circle_) {
+			engine_->DrawArc(render.X, render.Y, render.A);
 		}
 		else {
 			LOG(ERROR) << "Error: Only solid circular apertures can be used for arcs";
@@ -91,11 +180,15 @@ int GerberRender::Draw(std::shared_ptr<RenderCommand> render)
 		break;
 
 	case RenderCommand::gcFlash:
-		if (auto ret = engine_->Flash(render->X, render->Y))
+		if (auto ret = engine_->Flash(render.X, render.Y))
 			return ret;
 
 		break;
 
+	case RenderCommand::gcDot:
+		engine_->DrawDot(render.X, render.Y);
+		break;
+
 	case RenderCommand::gcClose:
 		engine_->Close();
 		break;
@@ -110,27 +203,27 @@ int GerberRender::Draw(std::shared_ptr<RenderCommand> render)
 
 	case RenderCommand::gcBeginOutline:
 		engine_->BeginOutline();
-		outline_path_ = true;
+		context.outline_path_ = true;
 		break;
 
 	case RenderCommand::gcEndOutline:
 		engine_->EndOutline();
-		outline_path_ = false;
+		context.outline_path_ = false;
 		break;
 
 	case RenderCommand::gcApertureSelect: {
-		auto aperture = render->aperture_;
+		const auto& aperture = render.aperture_;
 		if (!aperture) {
 			LOG(ERROR) << "Error: Null Aperture";
 			return 5;
 		}
 
-		solid_circle_ = aperture->SolidCircle();
-		line_width_ = aperture->right_ - aperture->left_;
+		context.solid_circle_ = aperture->SolidCircle();
+		context.line_width_ = aperture->right_ - aperture->left_;
 
-		solid_rectangle_ = aperture->SolidRectangle();
-		rect_w_ = aperture->right_ - aperture->left_;
-		rect_h_ = aperture->top_ - aperture->bottom_;
+		context.solid_rectangle_ = aperture->SolidRectangle();
+		context.rect_w_ = aperture->right_ - aperture->left_;
+		context.rect_h_ = aperture->top_ - aperture->bottom_;
 
 		if (!engine_->PrepareExistAperture(aperture->code_)) {
 			engine_->NewAperture(aperture->left_, aperture->bottom_, aperture->right_, aperture->top_);
@@ -147,36 +240,31 @@ int GerberRender::Draw(std::shared_ptr<RenderCommand> render)
 }
 
 void GerberRender::DrawAperture(
-	std::vector<std::shared_ptr<RenderCommand>> renders,
+	const std::vector<std::shared_ptr<RenderCommand>>& renders,
 	double left,
 	double bottom,
 	double right,
 	double top
-) {
-	struct OBJECT {
-		std::vector<std::shared_ptr<RenderCommand>> commands;
-	};
-	std::list<OBJECT*> objects;
-
-	auto object = new OBJECT;
-	objects.push_front(object);
-	for (auto render : renders) {
-		object->commands.push_back(render);
-
+) const {
+	// Each object ends with a stroke, fill or erase; they are drawn last first.
+	std::vector<std::size_t> objects{ 0 };
+	for (std::size_t i = 0; i < renders.size(); i++) {
+		const auto command = renders[i]->command_;
 		if (
-			render->command_ == RenderCommand::gcStroke ||
-			render->command_ == RenderCommand::gcFill ||
-			render->command_ == RenderCommand::gcErase
+			command == RenderCommand::gcStroke ||
+			command == RenderCommand::gcFill ||
+			command == RenderCommand::gcErase
 			) {
-			object = new OBJECT;
-			objects.push_front(object);
+			objects.push_back(i + 1);
 		}
 	}
 
 	engine_->PrepareDrawAperture();
 
-	for (const auto object : objects) {
-		for (auto render : object->commands) {
+	for (auto object = objects.size(); object-- > 0;) {
+		const auto last = object + 1 < objects.size() ? objects[object + 1] : renders.size();
+		for (auto i = objects[object]; i < last; i++) {
+			const auto& render = renders[i];
 			switch (render->command_) {
 			case RenderCommand::gcRectangle:
 				engine_->DrawApertureRect(render->X, render->Y, render->W, render->H);
@@ -219,19 +307,56 @@ void GerberRender::DrawAperture(
 				break;
 			}
 		}
-		delete object;
 	}
 
 	engine_->EndDrawAperture();
 }
 
-int GerberRender::RenderGerber(std::shared_ptr<Gerber> gerber)
+int GerberRender::RenderGerber(const std::shared_ptr<const Gerber>& gerber) const
+{
+	return Render(*gerber, nullptr);
+}
+
+int GerberRender::RenderGerber(const std::shared_ptr<const Gerber>& gerber, const BoundBox& region) const
+{
+	return Render(*gerber, &region);
+}
+
+bool GerberRender::Empty(const std::shared_ptr<const Gerber>& gerber, const BoundBox& region) const
+{
+	if (engine_->convert_strokes2fills_) {
+		gerber->ConvertStrokesToFills();
+	}
+
+	std::vector<std::uint32_t> visible;
+	for (const auto& level : gerber->Levels()) {
+		const auto& index = Source(*level).Index();
+		if (!index.Valid()) {
+			return false;
+		}
+
+		Query(*level, index, region, visible);
+		if (!visible.empty()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int GerberRender::Render(const Gerber& gerber, const BoundBox* region) const
 {
+	if (engine_->convert_strokes2fills_) {
+		gerber.ConvertStrokesToFills();
+	}
+
+	CONTEXT context;
+
 	engine_->BeginRender();
+	context.pixel_ = engine_->level_of_detail_ ? engine_->PixelSize() : 0.0;
 
-	auto levels = gerber->Levels();
-	for (const auto& level : levels) {
-		if (auto ret = RenderLevel(level)) {
+	for (const auto& level : gerber.Levels()) {
+		if (auto ret = RenderLevel(context, *level, region)) {
 			return ret;
 		}
 	}
@@ -241,22 +366,51 @@ int GerberRender::RenderGerber(std::shared_ptr<Gerber> gerber)
 	return 0;
 }
 
-int GerberRender::RenderLevel(std::shared_ptr<GerberLevel> level)
+int GerberRender::RenderLevel(CONTEXT& context, const GerberLevel& level, const BoundBox* region) const
 {
-	if (level->IsCopyLayer()) {
-		engine_->PrepareCopyLayer(level->bound_box_.Left(), level->bound_box_.Bottom(), level->bound_box_.Right(), level->bound_box_.Top());
+	// Only a few copies are seen in a region, which are drawn one by one
+	// where they are rather than through an image of the whole level.
+	if (level.IsCopyLayer() && region) {
+		engine_->Prepare2Render();
+
+		const auto& box = level.bound_box_;
+		for (int y = 0; y < level.CountY; y++) {
+			for (int x = 0; x < level.CountX; x++) {
+				const auto dx = x * level.StepX;
+				const auto dy = y * level.StepY;
+				if (box.Left() + dx > region->Right() || box.Right() + dx < region->Left() ||
+					box.Bottom() + dy > region->Top() || box.Top() + dy < region->Bottom()) {
+					continue;
+				}
+
+				// The region as the copy sees it
+				const BoundBox visible(region->Left() - dx, region->Right() - dx, region->Top() - dy, region->Bottom() - dy);
+				engine_->Translate(dx, dy);
+				if (auto result = RenderLayer(context, level, &visible)) {
+					engine_->Translate(0.0, 0.0);
+					return result;
+				}
+			}
+		}
+
+		engine_->Translate(0.0, 0.0);
+		return 0;
+	}
+
+	if (level.IsCopyLayer()) {
+		engine_->PrepareCopyLayer(level.bound_box_.Left(), level.bound_box_.Bottom(), level.bound_box_.Right(), level.bound_box_.Top());
 	}
 	else {
 		engine_->Prepare2Render();
 	}
 
-	auto result = RenderLayer(level);
+	auto result = RenderLayer(context, level, region);
 	if (result) {
 		return result;
 	}
 
-	if (level->IsCopyLayer()) {
-		engine_->CopyLayer(level->CountX, level->CountY, level->StepX, level->StepY);
+	if (level.IsCopyLayer()) {
+		engine_->CopyLayer(level.CountX, level.CountY, level.StepX, level.StepY);
 	}
 
 	return 0;
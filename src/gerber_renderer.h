@@ -11,34 +11,56 @@ public:
 	GerberRender(Engine* engine);
 	~GerberRender();
 
-	int RenderGerber(std::shared_ptr<Gerber>);
+	// Rendering only reads the Gerber, so several GerberRenders, each with
+	// its own engine, can render the same one on different threads.
+	int RenderGerber(const std::shared_ptr<const Gerber>& gerber) const;
+	// Only issues the primitives that intersect the region, in mm. Painting
+	// order and polarity are the same as for the whole image.
+	int RenderGerber(const std::shared_ptr<const Gerber>& gerber, const BoundBox& region) const;
+	// True when no primitive of the Gerber intersects the region, so that
+	// rendering it would leave it blank.
+	bool Empty(const std::shared_ptr<const Gerber>& gerber, const BoundBox& region) const;
 
 private:
-	int Draw(std::shared_ptr<RenderCommand> render);
+	// The state of a single render, kept apart from the GerberRender
+	struct CONTEXT {
+		bool outline_path_{ false };
+		bool solid_circle_{ false };
+		bool solid_rectangle_{ false };
+
+		double line_width_{ 0.0 };
+		// Device pixel size in mm when rendering with level of detail, else 0
+		double pixel_{ 0.0 };
+
+		double rect_w_{ 0 };
+		double rect_h_{ 0 };
+		double rect_x_{ 0 };
+		double rect_y_{ 0 };
+
+		// Primitives found by RenderVisible, kept to reuse the allocation
+		std::vector<std::uint32_t> visible_;
+	};
+
+	int Draw(CONTEXT& context, const RenderCommand& render) const;
 
 	void DrawAperture(
-		std::vector<std::shared_ptr<RenderCommand>> renders,
+		const std::vector<std::shared_ptr<RenderCommand>>& renders,
 		double left,
 		double bottom,
 		double right,
 		double top
-	);
+	) const;
 
-	int RenderLayer(std::shared_ptr<GerberLevel> level);
-	int RenderLevel(std::shared_ptr<GerberLevel> level);
+	// The region is null to render everything.
+	int Render(const Gerber& gerber, const BoundBox* region) const;
+	// The level drawn for it, depending on the engine
+	const GerberLevel& Source(const GerberLevel& level) const;
+	// Adds the primitives of any copy of the level that intersect the region.
+	static void Query(const GerberLevel& level, const SpatialIndex& index, const BoundBox& region, std::vector<std::uint32_t>& result);
+	// A single copy of the level; the region is where that copy is seen.
+	int RenderLayer(CONTEXT& context, const GerberLevel& level, const BoundBox* region) const;
+	int RenderLevel(CONTEXT& context, const GerberLevel& level, const BoundBox* region) const;
+	int RenderVisible(CONTEXT& context, const CommandStore& commands, const SpatialIndex& index, const BoundBox& region) const;
 
 	Engine* engine_;
-
-	bool outline_path_{ false };
-	bool solid_circle_{ false };
-	bool solid_rectangle_{ false };
-
-	double line_width_{ 0.0 };
-
-	double rect_w_{ 0 };
-	double rect_h_{ 0 };
-	double rect_x_{ 0 };
-	double rect_y_{ 0 };
-
-	std::shared_ptr<Gerber> gerber_;
 };
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "tiled_renderer.h"
+#include "gerber_renderer.h"
+#include "engine/qt_engine.h"
+
+#include <glog/logging.h>
+#include <QImage>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <vector>
+
+
+TiledRender::TiledRender(unsigned threads, int tile_size) :
+	pool_(threads),
+	tile_size_((std::max(tile_size, 16) + 7) / 8 * 8)
+{
+}
+
+std::size_t TiledRender::RenderedTiles() const {
+	return rendered_;
+}
+
+std::size_t TiledRender::SkippedTiles() const {
+	return skipped_;
+}
+
+int TiledRender::Render(const std::shared_ptr<const Gerber>& gerber, const BoundBox& box, QImage& image) {
+	rendered_ = skipped_ = 0;
+	const auto format = image.format();
+	switch (format) {
+	case QImage::Format_RGB32:
+		image.fill(QColor(255, 255, 255));
+		break;
+	case QImage::Format_Grayscale8:
+		image.fill(255);
+		break;
+	case QImage::Format_Mono:
+		image.setColorTable({ qRgb(255, 255, 255), qRgb(0, 0, 0) });
+		image.fill(0);
+		break;
+	default:
+		LOG(ERROR) << "Error: Tiles can only be rendered into RGB32, Grayscale8 or Mono images";
+		return -1;
+	}
+
+	if (image.isNull()) {
+		return 0;
+	}
+
+	// The same mapping as Transformation: centred, with a single scale
+	const auto scale = std::max(box.Width() / image.width(), box.Height() / image.height());
+	const auto left = box.Left() - (image.width() * scale - box.Width()) / 2.0;
+	const auto top = box.Top() + (image.height() * scale - box.Height()) / 2.0;
+	const auto tile = tile_size_ * scale;
+
+	const auto columns = (image.width() + tile_size_ - 1) / tile_size_;
+	const auto rows = (image.height() + tile_size_ - 1) / tile_size_;
+	const auto count = static_cast<std::size_t>(columns) * rows;
+
+	auto tile_box = [&](std::size_t index) {
+		const auto column = static_cast<int>(index % columns);
+		const auto row = static_cast<int>(index / columns);
+		return BoundBox(left + column * tile, left + (column + 1) * tile, top - row * tile, top - (row + 1) * tile);
+	};
+
+	// Before the threads start, so that each level is converted by one
+	if (convert_strokes2fills_) {
+		gerber->ConvertStrokesToFills();
+	}
+
+	// Taken once, as every thread writes its own rows and columns through it
+	auto bits = image.bits();
+	const auto bytes_per_line = image.bytesPerLine();
+
+	std::atomic<std::size_t> next{ 0 };
+	std::atomic<std::size_t> rendered{ 0 };
+	std::atomic<int> error{ 0 };
+
+	auto work = [&]() {
+		QImage pixels(tile_size_, tile_size_, QImage::Format_RGB32);
+		QtEngine engine(&pixels, tile_box(0), BoundBox(0.0, 0.0, 0.0, 0.0));
+		engine.convert_strokes2fills_ = convert_strokes2fills_;
+		engine.level_of_detail_ = level_of_detail_;
+		GerberRender render(&engine);
+
+		for (auto index = next++; index < count && !error; index = next++) {
+			const auto region = tile_box(index);
+			if (render.Empty(gerber, region)) {
+				continue;
+			}
+
+			engine.View(region);
+			if (auto ret = render.RenderGerber(gerber, region)) {
+				error = ret;
+				return;
+			}
+
+			const auto x = static_cast<int>(index % columns) * tile_size_;
+			const auto y = static_cast<int>(index / columns) * tile_size_;
+			const auto width = std::min(tile_size_, image.width() - x);
+			const auto height = std::min(tile_size_, image.height() - y);
+			for (int line = 0; line < height; line++) {
+				auto target = bits + static_cast<std::size_t>(y + line) * bytes_per_line;
+				auto source = reinterpret_cast<const QRgb*>(pixels.constScanLine(line));
+				if (format == QImage::Format_RGB32) {
+					std::memcpy(target + x * 4, source, static_cast<std::size_t>(width) * 4);
+				}
+				else if (format == QImage::Format_Grayscale8) {
+					for (int i = 0; i < width; i++) {
+						target[x + i] = static_cast<uchar>(qGray(source[i]));
+					}
+				}
+				else {
+					// Tiles start on a byte, so no other thread writes to these
+					for (int i = 0; i < width; i++) {
+						if (qGray(source[i]) < 128) {
+							target[(x + i) >> 3] |= static_cast<uchar>(0x80 >> ((x + i) & 7));
+						}
+					}
+				}
+			}
+			rendered++;
+		}
+	};
+
+	const auto threads = std::min<std::size_t>(pool_.Size(), count);
+	std::vector<std::future<void>> results;
+	for (std::size_t i = 0; i < threads; i++) {
+		results.push_back(pool_.Submit(work));
+	}
+	for (auto& result : results) {
+		result.get();
+	}
+
+	rendered_ = rendered;
+	skipped_ = count - rendered_;
+	return error;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+#include "gerber.h"
+#include "thread_pool.h"
+
+class QImage;
+
+// Renders large images in square tiles on several threads at once. Each
+// thread has its own QtEngine, tile image and GerberRender; tiles are taken
+// from a shared counter, so threads that finish early take on more. Tiles
+// without any primitive are left white without rendering them.
+class TiledRender {
+public:
+	// threads as for ThreadPool, tile_size in pixels, rounded up to a whole
+	// number of bytes of a 1-bit image.
+	explicit TiledRender(unsigned threads = 0, int tile_size = 512);
+
+	// Renders the box of the Gerber onto the whole image, which must be
+	// QImage::Format_RGB32, Format_Grayscale8 or Format_Mono. Tiles are
+	// converted as they are done, so a 1-bit image takes no more memory than
+	// its bits; pixels darker than mid grey are black there, and its colour
+	// table is set to white and black. Like a QtEngine on the image without
+	// offset, the box is centred and keeps its aspect ratio. Returns the first
+	// error of GerberRender::RenderGerber, -1 for an image of another format,
+	// or 0.
+	int Render(const std::shared_ptr<const Gerber>& gerber, const BoundBox& box, QImage& image);
+
+	// Copied to the engine of every thread
+	bool convert_strokes2fills_{ false };
+	bool level_of_detail_{ false };
+
+	// Of the last Render
+	std::size_t RenderedTiles() const;
+	std::size_t SkippedTiles() const;
+
+private:
+	ThreadPool pool_;
+	int tile_size_;
+
+	std::size_t rendered_{ 0 };
+	std::size_t skipped_{ 0 };
+};
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "engine/qt_engine.h"
+#include <QImage>
 #include <QPixmap>
 #include <QPainter>
 #include <QApplication>
@@ -9,6 +10,12 @@ class TestingQtEngine : public QtEngine {
 public:
 	using QtEngine::QtEngine;
 	using QtEngine::BeginRender;
+	using QtEngine::EndRender;
+	using QtEngine::BeginDraw;
+	using QtEngine::EndDraw;
+	using QtEngine::Translate;
+	using QtEngine::DrawDot;
+	using QtEngine::PixelSize;
 
 	std::shared_ptr<QPainter> CreatePainter(QPaintDevice* pic) override {
 		if (!painter_) {
@@ -35,3 +42,37 @@ TEST(QtEngineTest, TestBeginRenderDefault) {
 	EXPECT_EQ(engine.painter_->viewport(), QRect(25, 25, 950, 950));
 	EXPECT_EQ(engine.painter_->window(), QRect(-1000000, 1000000, 2500000, -2500000));
 }
+
+TEST(QtEngineTest, TestDot) {
+	int argc = 0;
+	char* argv[1];
+	QApplication app(argc, argv);
+
+	// The painter leaves 2.5% of the device on every side
+	QImage image(1000, 1000, QImage::Format_RGB32);
+	TestingQtEngine engine(&image, BoundBox(0.0, 100.0, 100.0, 0.0), BoundBox(0.025, 0.025, 0.025, 0.025));
+	EXPECT_DOUBLE_EQ(engine.PixelSize(), 100.0 / 950.0);
+
+	// Once directly and once moved there, both about one pixel in the centre
+	engine.BeginRender();
+	engine.BeginDraw(false);
+	engine.DrawDot(50.0, 50.0);
+	engine.Translate(10.0, 0.0);
+	engine.DrawDot(40.0, 50.0);
+	engine.EndDraw();
+	engine.EndRender();
+	engine.painter_ = nullptr;
+
+	int dark = 0, outside = 0;
+	for (int y = 0; y < image.height(); y++) {
+		for (int x = 0; x < image.width(); x++) {
+			if (image.pixel(x, y) != qRgb(255, 255, 255)) {
+				dark++;
+				outside += std::abs(x - 500) > 1 || std::abs(y - 500) > 1;
+			}
+		}
+	}
+	EXPECT_GT(dark, 0);
+	EXPECT_LE(dark, 4);
+	EXPECT_EQ(outside, 0);
+}
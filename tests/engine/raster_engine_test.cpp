@@ -0,0 +1,386 @@
+#include <gtest/gtest.h>
+#include "engine/raster_engine.h"
+#include "gerber_renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+
+class TestingRasterEngine : public RasterEngine {
+public:
+	using RasterEngine::RasterEngine;
+	using RasterEngine::BeginRender;
+	using RasterEngine::BeginDraw;
+	using RasterEngine::BeginOutline;
+	using RasterEngine::EndOutline;
+	using RasterEngine::BeginLine;
+	using RasterEngine::DrawLine;
+	using RasterEngine::DrawCircle;
+	using RasterEngine::DrawRectangle;
+	using RasterEngine::BeginSolidCircleLine;
+	using RasterEngine::Stroke;
+	using RasterEngine::NewAperture;
+	using RasterEngine::PrepareDrawAperture;
+	using RasterEngine::DrawAperatureCircle;
+	using RasterEngine::ApertureFill;
+	using RasterEngine::ApertureErase;
+	using RasterEngine::EndDrawAperture;
+	using RasterEngine::EndDrawNewAperture;
+	using RasterEngine::Flash;
+	using RasterEngine::PrepareCopyLayer;
+	using RasterEngine::CopyLayer;
+	using RasterEngine::PixelSize;
+
+	// Covered area in pixels
+	double Area() const {
+		double area = 0.0;
+		for (auto pixel : Pixels()) {
+			area += pixel / 255.0;
+		}
+		return area;
+	}
+
+	int At(int x, int y) const {
+		if (Format() == rfBinary) {
+			return (Pixels()[y * Stride() + x / 8] >> (7 - x % 8)) & 1 ? 255 : 0;
+		}
+		return Pixels()[y * Width() + x];
+	}
+
+	void Square(double x, double y, double size) {
+		BeginLine(x, y);
+		DrawLine(x + size, y);
+		DrawLine(x + size, y + size);
+		DrawLine(x, y + size);
+	}
+};
+
+
+TEST(RasterEngineTest, TestPolygonArea) {
+	// A mm per pixel
+	TestingRasterEngine engine(100, 100, BoundBox(0.0, 100.0, 100.0, 0.0));
+	EXPECT_DOUBLE_EQ(engine.PixelSize(), 1.0);
+
+	engine.BeginRender();
+	engine.BeginDraw(false);
+	engine.BeginOutline();
+	engine.BeginLine(10.5, 10.25);
+	engine.DrawLine(30.5, 10.25);
+	engine.DrawLine(30.5, 40.25);
+	engine.DrawLine(10.5, 40.25);
+	engine.EndOutline();
+
+	EXPECT_NEAR(engine.Area(), 600.0, 0.5);
+	EXPECT_EQ(engine.At(20, 70), 255);
+	EXPECT_EQ(engine.At(10, 70), 128);
+	EXPECT_EQ(engine.At(5, 70), 0);
+
+	engine.BeginRender();
+	engine.BeginOutline();
+	engine.DrawCircle(50.0, 50.0, 20.0);
+	engine.EndOutline();
+	EXPECT_NEAR(engine.Area(), 3.141592653589793 * 400.0, 2.0);
+}
+
+TEST(RasterEngineTest, TestFillRules) {
+	TestingRasterEngine engine(100, 100, BoundBox(0.0, 100.0, 100.0, 0.0));
+
+	// Outlines are even-odd, the inner square is a hole
+	engine.BeginRender();
+	engine.BeginDraw(false);
+	engine.BeginOutline();
+	engine.Square(10.0, 10.0, 40.0);
+	engine.Square(20.0, 20.0, 20.0);
+	engine.EndOutline();
+	EXPECT_NEAR(engine.Area(), 1600.0 - 400.0, 0.5);
+	EXPECT_EQ(engine.At(30, 70), 0);
+
+	// Strokes are non-zero, the corner of the two segments is covered once
+	engine.BeginRender();
+	engine.BeginSolidCircleLine(20.0, 20.0, 10.0);
+	engine.DrawLine(80.0, 20.0);
+	engine.DrawLine(80.0, 80.0);
+	engine.Stroke();
+	EXPECT_NEAR(engine.Area(), 1200.0 - 25.0 + 3.141592653589793 * 25.0 * 5.0 / 4.0, 2.0);
+	EXPECT_EQ(engine.At(78, 78), 255);
+}
+
+TEST(RasterEngineTest, TestNegative) {
+	TestingRasterEngine engine(100, 100, BoundBox(0.0, 100.0, 100.0, 0.0));
+
+	engine.BeginRender();
+	engine.BeginDraw(false);
+	engine.BeginOutline();
+	engine.DrawRectangle(0.0, 0.0, 100.0, 100.0);
+	engine.EndOutline();
+	EXPECT_NEAR(engine.Area(), 10000.0, 1e-9);
+
+	engine.BeginDraw(true);
+	engine.BeginOutline();
+	engine.DrawRectangle(10.0, 10.0, 50.0, 20.0);
+	engine.EndOutline();
+	EXPECT_NEAR(engine.Area(), 9000.0, 1e-9);
+	EXPECT_EQ(engine.At(20, 80), 0);
+}
+
+TEST(RasterEngineTest, TestApertureWithHole) {
+	// A tenth of a mm per pixel
+	TestingRasterEngine engine(100, 100, BoundBox(0.0, 10.0, 10.0, 0.0));
+	engine.BeginRender();
+	engine.BeginDraw(false);
+
+	// Objects come last first: a disc with the middle erased
+	engine.NewAperture(-2.0, -2.0, 2.0, 2.0);
+	engine.PrepareDrawAperture();
+	engine.DrawAperatureCircle(0.0, 0.0, 2.0);
+	engine.ApertureErase(-2.0, -2.0, 2.0, 2.0);
+	engine.DrawAperatureCircle(0.0, 0.0, 4.0);
+	engine.ApertureFill();
+	engine.EndDrawAperture();
+	engine.EndDrawNewAperture(10);
+
+	engine.Flash(5.0, 5.0);
+	EXPECT_NEAR(engine.Area(), 3.141592653589793 * 300.0, 3.0);
+	EXPECT_EQ(engine.At(50, 50), 0);
+	EXPECT_EQ(engine.At(50, 35), 255);
+
+	// Flashed again at another quarter pixel
+	engine.BeginRender();
+	engine.Flash(5.025, 5.0);
+	EXPECT_NEAR(engine.Area(), 3.141592653589793 * 300.0, 3.0);
+}
+
+TEST(RasterEngineTest, TestCopyLayer) {
+	TestingRasterEngine engine(100, 100, BoundBox(0.0, 100.0, 100.0, 0.0));
+	engine.BeginRender();
+	engine.BeginDraw(false);
+
+	engine.PrepareCopyLayer(0.0, 0.0, 10.0, 10.0);
+	engine.BeginOutline();
+	engine.DrawRectangle(0.0, 0.0, 10.0, 10.0);
+	engine.EndOutline();
+	EXPECT_EQ(engine.Area(), 0.0);
+
+	engine.CopyLayer(3, 2, 20.0, 30.0);
+	EXPECT_NEAR(engine.Area(), 600.0, 1e-9);
+	EXPECT_EQ(engine.At(45, 65), 255);
+	EXPECT_EQ(engine.At(15, 95), 0);
+}
+
+TEST(RasterEngineTest, TestRenderFiles) {
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		auto gerber = std::make_shared<Gerber>(std::string(TestData) + name);
+
+		TestingRasterEngine engine(400, 300, gerber->GetBBox());
+		GerberRender render(&engine);
+		EXPECT_EQ(render.RenderGerber(gerber), 0) << name;
+
+		const auto area = engine.Area();
+		EXPECT_GT(area, 0.0) << name;
+		EXPECT_LT(area, 400.0 * 300.0) << name;
+
+		// Rendering starts over, with the apertures already made
+		const auto pixels = engine.Pixels();
+		render.RenderGerber(gerber);
+		EXPECT_EQ(engine.Pixels(), pixels) << name;
+	}
+}
+
+TEST(RasterEngineTest, TestRenderCopiesInRegion) {
+	// Mostly step and repeat levels
+	auto gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+	auto box = gerber->GetBBox();
+
+	TestingRasterEngine all(400, 300, box);
+	GerberRender(&all).RenderGerber(gerber);
+
+	// Each copy is drawn where it is, the same as copying the level
+	TestingRasterEngine whole(400, 300, box);
+	GerberRender(&whole).RenderGerber(gerber, BoundBox(box.Left() - 1, box.Right() + 1, box.Top() + 1, box.Bottom() - 1));
+	EXPECT_EQ(whole.Pixels(), all.Pixels());
+
+	// Only what is near the region is drawn, but all of that
+	const auto x = box.Left() + box.Width() / 3;
+	const auto y = box.Bottom() + box.Height() / 3;
+	const auto size = std::min(box.Width(), box.Height()) / 4;
+	TestingRasterEngine part(400, 300, box);
+	GerberRender(&part).RenderGerber(gerber, BoundBox(x, x + size, y + size, y));
+	EXPECT_LT(part.Area(), all.Area() / 2);
+
+	const auto scale = part.PixelSize();
+	const auto left = (400 * scale - box.Width()) / 2;
+	const auto top = (300 * scale - box.Height()) / 2;
+	int different = 0, covered = 0;
+	for (auto row = static_cast<int>((box.Top() - y - size + top) / scale) + 2; row < (box.Top() - y + top) / scale - 2; row++) {
+		for (auto column = static_cast<int>((x - box.Left() + left) / scale) + 2; column < (x + size - box.Left() + left) / scale - 2; column++) {
+			different += part.At(column, row) != all.At(column, row);
+			covered += all.At(column, row) != 0;
+		}
+	}
+	EXPECT_GT(covered, 0);
+	EXPECT_EQ(different, 0);
+}
+
+TEST(RasterEngineTest, TestBinary) {
+	TestingRasterEngine coverage(203, 50, BoundBox(0.0, 203.0, 50.0, 0.0));
+	TestingRasterEngine binary(203, 50, BoundBox(0.0, 203.0, 50.0, 0.0), rfBinary);
+	EXPECT_EQ(binary.Stride(), 26u);
+	EXPECT_EQ(binary.Pixels().size(), 26u * 50u);
+
+	for (auto engine : { &coverage, &binary }) {
+		engine->BeginRender();
+		engine->BeginDraw(false);
+		engine->BeginOutline();
+		engine->BeginLine(0.3, 2.0);
+		engine->DrawLine(190.6, 10.2);
+		engine->DrawLine(120.2, 47.7);
+		engine->EndOutline();
+		engine->BeginOutline();
+		engine->DrawCircle(40.0, 35.3, 10.2);
+		engine->EndOutline();
+	}
+
+	// Shapes that do not overlap are their coverage, cut at a half
+	for (int y = 0; y < 50; y++) {
+		for (int x = 0; x < 203; x++) {
+			ASSERT_EQ(binary.At(x, y), coverage.At(x, y) >= 128 ? 255 : 0) << x << ", " << y;
+		}
+	}
+
+	// Bits past the width are left alone
+	for (int y = 0; y < 50; y++) {
+		EXPECT_EQ(binary.Pixels()[y * 26 + 25] & 0x1F, 0);
+	}
+
+	binary.BeginDraw(true);
+	binary.BeginOutline();
+	binary.DrawRectangle(0.0, 0.0, 203.0, 50.0);
+	binary.EndOutline();
+	EXPECT_TRUE(std::all_of(binary.Pixels().begin(), binary.Pixels().end(), [](std::uint8_t byte) {
+		return byte == 0;
+	}));
+}
+
+TEST(RasterEngineTest, TestBinaryRenderFiles) {
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		auto gerber = std::make_shared<Gerber>(std::string(TestData) + name);
+
+		TestingRasterEngine coverage(1000, 700, gerber->GetBBox());
+		TestingRasterEngine binary(1000, 700, gerber->GetBBox(), rfBinary);
+		EXPECT_EQ(GerberRender(&coverage).RenderGerber(gerber), 0) << name;
+		EXPECT_EQ(GerberRender(&binary).RenderGerber(gerber), 0) << name;
+
+		// Each shape is cut at half coverage on its own, so pixels only partly covered by several shapes
+		// may stay clear, but a set pixel is always at least half covered and whole pixels agree.
+		int covered = 0, set_below_half = 0, whole = 0;
+		for (int y = 0; y < 700; y++) {
+			for (int x = 0; x < 1000; x++) {
+				const auto level = coverage.At(x, y);
+				covered += level >= 128;
+				set_below_half += binary.At(x, y) && level < 128;
+				whole += (level == 0 || level == 255) && binary.At(x, y) != level;
+			}
+		}
+		EXPECT_GT(covered, 0) << name;
+		EXPECT_EQ(set_below_half, 0) << name;
+		EXPECT_EQ(whole, 0) << name;
+	}
+}
+
+TEST(RasterEngineTest, TestRuns) {
+	for (auto format : { rfCoverage, rfBinary }) {
+		TestingRasterEngine engine(300, 10, BoundBox(0.0, 300.0, 10.0, 0.0), format);
+		engine.BeginRender();
+		engine.BeginDraw(false);
+		engine.BeginOutline();
+		engine.DrawRectangle(3.0, 0.0, 250.0, 5.0);
+		engine.DrawRectangle(299.0, 0.0, 1.0, 10.0);
+		engine.EndOutline();
+		engine.BeginDraw(true);
+		engine.BeginOutline();
+		engine.DrawRectangle(100.0, 0.0, 9.0, 10.0);
+		engine.EndOutline();
+
+		std::vector<RasterEngine::RUN> runs;
+		engine.Runs(7, runs);
+		ASSERT_EQ(runs.size(), 3u);
+		EXPECT_EQ(runs[0].x_, 3);
+		EXPECT_EQ(runs[0].length_, 97);
+		EXPECT_EQ(runs[1].x_, 109);
+		EXPECT_EQ(runs[1].length_, 144);
+		EXPECT_EQ(runs[2].x_, 299);
+
+		// Up to the last pixel
+		engine.Runs(2, runs);
+		ASSERT_EQ(runs.size(), 1u);
+		EXPECT_EQ(runs[0].x_, 299);
+		EXPECT_EQ(runs[0].length_, 1);
+
+		engine.Runs(10, runs);
+		EXPECT_TRUE(runs.empty());
+	}
+}
+
+TEST(RasterEngineTest, TestSave) {
+	auto gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+	TestingRasterEngine engine(1000, 700, gerber->GetBBox(), rfBinary);
+	GerberRender(&engine).RenderGerber(gerber);
+
+	auto image_file = testing::TempDir() + "raster_engine.pbm";
+	ASSERT_TRUE(engine.SavePnm(image_file));
+	EXPECT_EQ(std::filesystem::file_size(image_file), std::string("P4\n1000 700\n").size() + 125 * 700);
+	std::filesystem::remove(image_file);
+
+	// Covered pixels are black in both kinds of image
+	TestingRasterEngine coverage(1000, 700, gerber->GetBBox());
+	GerberRender(&coverage).RenderGerber(gerber);
+	image_file = testing::TempDir() + "raster_engine.pgm";
+	ASSERT_TRUE(coverage.SavePnm(image_file));
+	{
+		std::ifstream image(image_file, std::ios::in | std::ios::binary);
+		std::string header(std::string("P5\n1000 700\n255\n").size(), '\0');
+		image.read(&header[0], header.size());
+		EXPECT_EQ(header, "P5\n1000 700\n255\n");
+
+		std::vector<std::uint8_t> pixels(coverage.Pixels().size());
+		image.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+		EXPECT_EQ(image.peek(), std::ifstream::traits_type::eof());
+		std::transform(pixels.begin(), pixels.end(), pixels.begin(), [](std::uint8_t pixel) {
+			return static_cast<std::uint8_t>(255 - pixel);
+		});
+		EXPECT_EQ(pixels, coverage.Pixels());
+	}
+	std::filesystem::remove(image_file);
+
+	auto runs_file = testing::TempDir() + "raster_engine.runs";
+	ASSERT_TRUE(engine.SaveRuns(runs_file));
+
+	std::ifstream file(runs_file, std::ios::in | std::ios::binary);
+	auto read = [&file]() {
+		unsigned char bytes[4] = {};
+		file.read(reinterpret_cast<char*>(bytes), 4);
+		return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<std::uint32_t>(bytes[3]) << 24;
+	};
+	EXPECT_EQ(read(), 1000u);
+	EXPECT_EQ(read(), 700u);
+
+	// Decoded again, the runs give back every pixel
+	std::vector<std::uint8_t> pixels(engine.Pixels().size(), 0);
+	for (int y = 0; y < 700; y++) {
+		const auto count = read();
+		for (std::uint32_t i = 0; i < count; i++) {
+			const auto x = read();
+			const auto length = read();
+			for (auto pixel = x; pixel < x + length; pixel++) {
+				pixels[y * 125 + pixel / 8] |= 0x80 >> (pixel % 8);
+			}
+		}
+	}
+	EXPECT_TRUE(file.good());
+	EXPECT_EQ(file.peek(), std::ifstream::traits_type::eof());
+	EXPECT_EQ(pixels, engine.Pixels());
+
+	file.close();
+	std::filesystem::remove(runs_file);
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "gerber/gerber.h"
+#include "gerber/gerber/aperture_table.h"
+
+
+namespace {
+
+std::shared_ptr<GerberAperture> MakeAperture(int code) {
+	auto aperture = std::make_shared<GerberAperture>();
+	aperture->code_ = code;
+	aperture->Circle(0.1);
+	return aperture;
+}
+
+}
+
+// A friend of ApertureTable, for the probe counts
+class ApertureTableTest : public testing::Test {
+protected:
+	static std::size_t Probes(const ApertureTable& table, int code) {
+		return table.Probes(code);
+	}
+};
+
+TEST_F(ApertureTableTest, TestAddAndFind) {
+	ApertureTable table;
+	EXPECT_EQ(table.Find(10), nullptr);
+
+	// Dense, sparse and colliding codes, enough to grow the index several times.
+	std::vector<int> codes;
+	for (int code = 10; code < 5000; code++) {
+		codes.push_back(code);
+	}
+	for (int code = 100000; code < 100000 + (1 << 20); code += 1 << 12) {
+		codes.push_back(code);
+	}
+
+	for (auto code : codes) {
+		ASSERT_TRUE(table.Add(MakeAperture(code)));
+	}
+	EXPECT_FALSE(table.Add(MakeAperture(10)));
+	EXPECT_EQ(table.Size(), codes.size());
+
+	for (auto code : codes) {
+		auto aperture = table.Find(code);
+		ASSERT_NE(aperture, nullptr);
+		EXPECT_EQ(aperture->code_, code);
+	}
+	EXPECT_EQ(table.Find(9), nullptr);
+	EXPECT_EQ(table.Find(5000), nullptr);
+	EXPECT_EQ(table.Find(100001), nullptr);
+
+	// Iteration is in definition order.
+	size_t i = 0;
+	for (const auto& aperture : table) {
+		EXPECT_EQ(aperture->code_, codes[i++]);
+	}
+
+	table.Clear();
+	EXPECT_EQ(table.Size(), 0);
+	EXPECT_EQ(table.Find(10), nullptr);
+}
+
+TEST_F(ApertureTableTest, TestLargeDCodes) {
+	auto file_name = testing::TempDir() + "large_dcodes.gbr";
+	{
+		std::ofstream file(file_name, std::ios::binary);
+		file << "%FSLAX26Y26*%\n%MOMM*%\n%ADD10C,0.1*%\n%ADD12345R,0.2X0.4*%\n";
+		file << "D12345*\nX1000000Y1000000D03*\nD10*\nX2000000Y2000000D03*\nM02*\n";
+	}
+
+	Gerber gerber(file_name);
+	ASSERT_EQ(gerber.Levels().size(), 1);
+
+	const auto& renders = gerber.Levels().front()->RenderCommands();
+	ASSERT_EQ(renders.size(), 4);
+	EXPECT_EQ(renders[0].command_, RenderCommand::gcApertureSelect);
+	EXPECT_EQ(renders[0].aperture_->code_, 12345);
+	EXPECT_EQ(renders[2].aperture_->code_, 10);
+	EXPECT_EQ(gerber.GetBBox(), BoundBox(0.9, 2.05, 2.05, 0.8));
+
+	std::remove(file_name.c_str());
+}
+
+TEST_F(ApertureTableTest, TestStridedCodes) {
+	// Codes that only differ in their high bits must not pile up in a few
+	// slots, whatever the size of the index.
+	for (int stride : { 1, 10, 64, 1000, 1 << 12, 1 << 16, 1 << 20 }) {
+		ApertureTable table;
+		for (int i = 0; i < 1000; i++) {
+			ASSERT_TRUE(table.Add(MakeAperture(10 + i * stride)));
+		}
+
+		std::size_t longest = 0;
+		for (int i = 0; i < 1000; i++) {
+			longest = std::max(longest, Probes(table, 10 + i * stride));
+		}
+		EXPECT_LE(longest, 8u) << "stride " << stride;
+	}
+}
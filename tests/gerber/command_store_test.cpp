@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include "gerber/gerber/command_store.h"
+#include "gerber/gerber/gerber_aperture.h"
+
+
+namespace {
+
+bool SameBits(double a, double b) {
+	return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+void ExpectSame(const RenderCommand& expected, const RenderCommand& actual) {
+	EXPECT_EQ(expected.command_, actual.command_);
+	EXPECT_TRUE(SameBits(expected.X, actual.X));
+	EXPECT_TRUE(SameBits(expected.Y, actual.Y));
+	EXPECT_TRUE(SameBits(expected.W, actual.W));
+	EXPECT_TRUE(SameBits(expected.H, actual.H));
+	EXPECT_TRUE(SameBits(expected.A, actual.A));
+	EXPECT_TRUE(SameBits(expected.End.X, actual.End.X));
+	EXPECT_TRUE(SameBits(expected.End.Y, actual.End.Y));
+	EXPECT_EQ(expected.aperture_, actual.aperture_);
+}
+
+RenderCommand Make(RenderCommand::GerberCommand command, double x, double y, double end_x, double end_y) {
+	RenderCommand render(command);
+	render.X = x;
+	render.Y = y;
+	render.End.X = end_x;
+	render.End.Y = end_y;
+	return render;
+}
+
+}
+
+TEST(CommandStoreTest, TestRoundTrip) {
+	auto d10 = std::make_shared<GerberAperture>();
+	auto d11 = std::make_shared<GerberAperture>();
+
+	std::vector<RenderCommand> commands;
+	commands.push_back(RenderCommand(RenderCommand::gcBeginOutline));
+	commands.push_back(Make(RenderCommand::gcBeginLine, 1.5, -2.5, 1.5, -2.5));
+	commands.push_back(Make(RenderCommand::gcLine, -0.0, 3.0, -0.0, 3.0));
+	commands.push_back(Make(RenderCommand::gcLine, 4.0, 5.0, 6.0, 7.0));
+	commands.push_back(Make(RenderCommand::gcFill, 0.0, 0.0, 8.0, 9.0));
+	commands.push_back(Make(RenderCommand::gcStroke, -0.0, 0.0, 8.0, 9.0));
+	commands.push_back(Make(RenderCommand::gcFlash, 10.0, 11.0, 0.0, 0.0));
+
+	auto arc = Make(RenderCommand::gcArc, 1.0, 2.0, 3.0, 4.0);
+	arc.A = -90.0;
+	commands.push_back(arc);
+
+	auto rectangle = Make(RenderCommand::gcRectangle, 1.0, 2.0, 0.0, 0.0);
+	rectangle.W = 3.0;
+	rectangle.H = 4.0;
+	commands.push_back(rectangle);
+
+	RenderCommand select(RenderCommand::gcApertureSelect);
+	select.aperture_ = d10;
+	commands.push_back(select);
+	select.aperture_ = d11;
+	commands.push_back(select);
+	select.aperture_ = d10;
+	select.End.X = 1.0; // Not produced by the plotter, but must survive
+	commands.push_back(select);
+	select.aperture_ = nullptr;
+	select.End.X = 0.0;
+	commands.push_back(select);
+
+	CommandStore store;
+	for (const auto& command : commands) {
+		store.Add(command);
+	}
+
+	ASSERT_EQ(store.size(), commands.size());
+	for (size_t i = 0; i < commands.size(); i++) {
+		SCOPED_TRACE(i);
+		ExpectSame(commands[i], store[i]);
+		EXPECT_EQ(store.Command(i), commands[i].command_);
+	}
+
+	size_t i = 0;
+	for (auto iter = store.begin(); iter != store.end(); ++iter, ++i) {
+		EXPECT_EQ(iter.Command(), commands[i].command_);
+		ExpectSame(commands[i], *iter);
+	}
+	EXPECT_EQ(i, commands.size());
+
+	store.clear();
+	EXPECT_TRUE(store.empty());
+}
+
+TEST(CommandStoreTest, TestCompactLines) {
+	CommandStore store;
+	constexpr int kCount = 10000;
+	store.reserve(kCount);
+	for (int i = 0; i < kCount; i++) {
+		store.Add(Make(RenderCommand::gcLine, i, -i, i, -i));
+	}
+
+	// Opcode, X, Y and argument only
+	EXPECT_LE(store.MemoryUsage(), kCount * 21 + 64);
+}
+
+TEST(CommandStoreTest, TestPackedRoundTrip) {
+	auto d10 = std::make_shared<GerberAperture>();
+
+	std::vector<RenderCommand> commands;
+	for (int i = 0; i < 200; i++) {
+		// Parsed the way the plotter does, one division by 10 per decimal
+		double x = 12345 + i * 37, y = -678 - i * 11;
+		for (int d = 0; d < 4; d++) {
+			x /= 10.0;
+			y /= 10.0;
+		}
+		commands.push_back(Make(RenderCommand::gcLine, x * 25.4, y * 25.4, x * 25.4, y * 25.4));
+	}
+	commands.push_back(Make(RenderCommand::gcLine, 0.1234567891, 2.0, 0.1234567891, 2.0));
+	commands.push_back(Make(RenderCommand::gcFill, 0.0, 0.0, 0.0, 0.0));
+	commands.push_back(Make(RenderCommand::gcStroke, -0.0, 0.0, 0.0, 0.0));
+	commands.push_back(Make(RenderCommand::gcFlash, 1e300, -1e300, 0.0, 0.0));
+
+	auto arc = Make(RenderCommand::gcArc, 1.0, 2.0, 3.0, 4.0);
+	arc.A = -90.0;
+	commands.push_back(arc);
+
+	RenderCommand select(RenderCommand::gcApertureSelect);
+	select.aperture_ = d10;
+	commands.push_back(select);
+
+	CommandStore store;
+	for (size_t i = 0; i < commands.size() / 2; i++) {
+		store.Add(commands[i]);
+	}
+	auto unpacked = store.MemoryUsage();
+	store.Pack(4, 4, true);
+	EXPECT_TRUE(store.Packed());
+	EXPECT_LT(store.MemoryUsage() * 3, unpacked);
+
+	// Added after packing
+	for (size_t i = commands.size() / 2; i < commands.size(); i++) {
+		store.Add(commands[i]);
+	}
+
+	ASSERT_EQ(store.size(), commands.size());
+	for (size_t i = 0; i < commands.size(); i++) {
+		SCOPED_TRACE(i);
+		ExpectSame(commands[i], store[i]);
+		EXPECT_EQ(store.Command(i), commands[i].command_);
+	}
+
+	size_t i = 0;
+	for (const auto& command : store) {
+		SCOPED_TRACE(i);
+		ExpectSame(commands[i++], command);
+	}
+	EXPECT_EQ(i, commands.size());
+
+	// Forward within and across checkpoints, in place and back
+	auto skipping = store.begin();
+	for (size_t index : { 3, 3, 40, 70, 71, 190, 5, 130, 205, 0 }) {
+		SCOPED_TRACE(index);
+		skipping.SkipTo(index);
+		EXPECT_EQ(skipping.Index(), index);
+		ExpectSame(commands[index], *skipping);
+	}
+
+	store.clear();
+	EXPECT_FALSE(store.Packed());
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+#include "gerber/gerber.h"
+#include "gerber/gerber_cache.h"
+
+
+namespace {
+
+void ExpectSameCommands(const CommandStore& expected, const CommandStore& actual) {
+	ASSERT_EQ(expected.size(), actual.size());
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_EQ(expected[i].command_, actual[i].command_);
+		EXPECT_EQ(expected[i].X, actual[i].X);
+		EXPECT_EQ(expected[i].Y, actual[i].Y);
+		EXPECT_EQ(expected[i].W, actual[i].W);
+		EXPECT_EQ(expected[i].H, actual[i].H);
+		EXPECT_EQ(expected[i].A, actual[i].A);
+		EXPECT_EQ(expected[i].End.X, actual[i].End.X);
+		EXPECT_EQ(expected[i].End.Y, actual[i].End.Y);
+
+		ASSERT_EQ(!expected[i].aperture_, !actual[i].aperture_);
+		if (expected[i].aperture_) {
+			EXPECT_EQ(expected[i].aperture_->code_, actual[i].aperture_->code_);
+			EXPECT_EQ(expected[i].aperture_->left_, actual[i].aperture_->left_);
+			EXPECT_EQ(expected[i].aperture_->top_, actual[i].aperture_->top_);
+			EXPECT_EQ(expected[i].aperture_->SolidCircle(), actual[i].aperture_->SolidCircle());
+			EXPECT_EQ(expected[i].aperture_->Render().size(), actual[i].aperture_->Render().size());
+		}
+	}
+}
+
+}
+
+TEST(GerberCacheTest, TestRoundTrip) {
+	auto cache_file = testing::TempDir() + "round_trip.gbc";
+
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		auto file_name = std::string(TestData) + name;
+		auto hash = GerberCache::HashFile(file_name);
+
+		Gerber parsed(file_name);
+		ASSERT_TRUE(GerberCache::Save(parsed, hash, cache_file));
+
+		auto cached = GerberCache::Load(cache_file, hash);
+		ASSERT_NE(cached, nullptr) << name;
+		EXPECT_EQ(cached->Unit(), parsed.Unit());
+		EXPECT_EQ(cached->Name(), parsed.Name());
+		EXPECT_EQ(cached->IsNegative(), parsed.IsNegative());
+		EXPECT_EQ(cached->GetBBox(), parsed.GetBBox());
+
+		const auto& parsed_levels = parsed.Levels();
+		const auto& cached_levels = cached->Levels();
+		ASSERT_EQ(parsed_levels.size(), cached_levels.size());
+		for (size_t i = 0; i < parsed_levels.size(); ++i) {
+			EXPECT_EQ(parsed_levels[i]->name_, cached_levels[i]->name_);
+			EXPECT_EQ(parsed_levels[i]->negative_, cached_levels[i]->negative_);
+			EXPECT_EQ(parsed_levels[i]->CountX, cached_levels[i]->CountX);
+			EXPECT_EQ(parsed_levels[i]->CountY, cached_levels[i]->CountY);
+			EXPECT_EQ(parsed_levels[i]->StepX, cached_levels[i]->StepX);
+			EXPECT_EQ(parsed_levels[i]->StepY, cached_levels[i]->StepY);
+			EXPECT_EQ(parsed_levels[i]->bound_box_, cached_levels[i]->bound_box_);
+			ExpectSameCommands(parsed_levels[i]->RenderCommands(), cached_levels[i]->RenderCommands());
+
+			// The index is loaded as it was saved
+			const auto& box = parsed_levels[i]->bound_box_;
+			BoundBox quarter(box.Left(), (box.Left() + box.Right()) / 2.0, (box.Top() + box.Bottom()) / 2.0, box.Bottom());
+			std::vector<std::uint32_t> parsed_primitives, cached_primitives;
+			parsed_levels[i]->Index().Query(quarter, parsed_primitives);
+			cached_levels[i]->Index().Query(quarter, cached_primitives);
+			EXPECT_EQ(parsed_levels[i]->Index().Valid(), cached_levels[i]->Index().Valid());
+			EXPECT_EQ(parsed_primitives, cached_primitives) << name;
+		}
+
+		// Packed with the coordinate format of the file
+		parsed.PackCommands();
+		cached->PackCommands();
+		for (size_t i = 0; i < parsed_levels.size(); ++i) {
+			EXPECT_EQ(parsed_levels[i]->RenderCommands().MemoryUsage(), cached_levels[i]->RenderCommands().MemoryUsage()) << name;
+			ExpectSameCommands(parsed_levels[i]->RenderCommands(), cached_levels[i]->RenderCommands());
+		}
+	}
+
+	std::filesystem::remove(cache_file);
+}
+
+TEST(GerberCacheTest, TestEntryIsCompact) {
+	auto file_name = std::string(TestData) + "2301113563-f-gtl";
+	auto cache_file = testing::TempDir() + "compact.gbc";
+	auto hash = GerberCache::HashFile(file_name);
+
+	Gerber parsed(file_name);
+	ASSERT_TRUE(GerberCache::Save(parsed, hash, cache_file));
+
+	// The commands are stored packed, in less space than their text
+	EXPECT_LT(std::filesystem::file_size(cache_file), std::filesystem::file_size(file_name));
+
+	// and used in place, so the loaded levels are packed as well.
+	auto cached = GerberCache::Load(cache_file, hash);
+	ASSERT_NE(cached, nullptr);
+	ASSERT_EQ(cached->Levels().size(), parsed.Levels().size());
+	for (size_t i = 0; i < parsed.Levels().size(); ++i) {
+		EXPECT_TRUE(cached->Levels()[i]->RenderCommands().Packed());
+		EXPECT_EQ(cached->Levels()[i]->Index().size(), parsed.Levels()[i]->Index().size());
+	}
+
+	std::filesystem::remove(cache_file);
+}
+
+TEST(GerberCacheTest, TestRejectsStaleOrDamagedEntries) {
+	auto file_name = std::string(TestData) + "2301113563-e-gbs";
+	auto cache_file = testing::TempDir() + "damaged.gbc";
+	auto hash = GerberCache::HashFile(file_name);
+
+	Gerber parsed(file_name);
+	ASSERT_TRUE(GerberCache::Save(parsed, hash, cache_file));
+	EXPECT_EQ(GerberCache::Load(cache_file, hash + 1), nullptr);
+	EXPECT_EQ(GerberCache::Load(testing::TempDir() + "missing.gbc", hash), nullptr);
+
+	auto size = std::filesystem::file_size(cache_file);
+	std::filesystem::resize_file(cache_file, size - 8);
+	EXPECT_EQ(GerberCache::Load(cache_file, hash), nullptr);
+
+	std::filesystem::remove(cache_file);
+}
+
+TEST(GerberCacheTest, TestRejectsCorruptedEntries) {
+	auto file_name = std::string(TestData) + "2301113563-e-gbs";
+	auto cache_file = testing::TempDir() + "corrupted.gbc";
+	auto hash = GerberCache::HashFile(file_name);
+
+	Gerber parsed(file_name);
+	ASSERT_TRUE(GerberCache::Save(parsed, hash, cache_file));
+	std::ifstream file(cache_file, std::ios::binary);
+	const std::string entry{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	file.close();
+
+	const auto box = parsed.GetBBox();
+	const BoundBox quarter(box.Left(), (box.Left() + box.Right()) / 2.0, (box.Top() + box.Bottom()) / 2.0, box.Bottom());
+
+	// Whatever still loads with a damaged byte stays within its arrays
+	std::mt19937 random(1);
+	int rejected = 0;
+	for (int i = 0; i < 500; i++) {
+		auto damaged = entry;
+		damaged[random() % damaged.size()] ^= static_cast<char>(1 + random() % 255);
+		std::ofstream(cache_file, std::ios::binary | std::ios::trunc) << damaged;
+
+		auto cached = GerberCache::Load(cache_file, hash);
+		if (!cached) {
+			rejected++;
+			continue;
+		}
+
+		for (const auto& level : cached->Levels()) {
+			const auto& commands = level->RenderCommands();
+			EXPECT_EQ(static_cast<std::size_t>(std::distance(commands.begin(), commands.end())), commands.size());
+
+			for (const auto& region : { box, quarter }) {
+				std::vector<std::uint32_t> primitives;
+				level->Index().Query(region, primitives);
+				for (auto primitive : primitives) {
+					const auto& found = level->Index()[primitive];
+					auto command = commands.At(found.first_);
+					for (auto j = found.first_; j < found.last_; j++, ++command) {
+						EXPECT_EQ(command.Index(), j);
+					}
+				}
+			}
+		}
+	}
+
+	// Damaged coordinates and boxes still load, damaged structure does not
+	EXPECT_GT(rejected, 100);
+
+	std::filesystem::remove(cache_file);
+}
+
+TEST(GerberCacheTest, TestOpen) {
+	auto file_name = std::string(TestData) + "lth_1-3.gbr";
+	auto cache_directory = testing::TempDir() + "gerber_cache";
+	std::filesystem::remove_all(cache_directory);
+
+	auto parsed = GerberCache::Open(file_name, cache_directory);
+	ASSERT_FALSE(std::filesystem::is_empty(cache_directory));
+
+	auto cached = GerberCache::Open(file_name, cache_directory);
+	EXPECT_EQ(cached->FileName(), file_name);
+	EXPECT_EQ(cached->GetBBox(), parsed->GetBBox());
+	ASSERT_EQ(cached->Levels().size(), parsed->Levels().size());
+	EXPECT_EQ(cached->Levels().front()->RenderCommands().size(), parsed->Levels().front()->RenderCommands().size());
+
+	std::filesystem::remove_all(cache_directory);
+}
+
+TEST(GerberCacheTest, TestOpenKeepsNoFailedParse) {
+	auto file_name = testing::TempDir() + "no_end_of_file.gbr";
+	std::ofstream(file_name) << "%FSLAX26Y26*%\n%MOMM*%\n%ADD10C,1*%\nD10*\nX0Y0D03*\n";
+	auto cache_directory = testing::TempDir() + "failed_cache";
+	std::filesystem::remove_all(cache_directory);
+
+	auto parsed = GerberCache::Open(file_name, cache_directory);
+	EXPECT_EQ(parsed->FileName(), file_name);
+	EXPECT_FALSE(std::filesystem::exists(cache_directory) && !std::filesystem::is_empty(cache_directory));
+
+	std::filesystem::remove_all(cache_directory);
+	std::filesystem::remove(file_name);
+}
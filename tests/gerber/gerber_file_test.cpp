@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include "gerber_file.h"
+
+
+namespace {
+
+struct Coordinate {
+	bool   parsed;
+	double number;
+	std::size_t index;
+};
+
+Coordinate Parse(const std::string& text, int integer, int decimal, bool omit_trailing_zeroes, bool scalar) {
+	GerberFile file;
+	file.buffer_ = text;
+
+	Coordinate result{};
+	result.parsed = scalar ?
+		file.GetCoordinateScalar(result.number, integer, decimal, omit_trailing_zeroes) :
+		file.GetCoordinate(result.number, integer, decimal, omit_trailing_zeroes);
+	result.index = file.index_;
+	return result;
+}
+
+void ExpectSameAsScalar(const std::string& text, int integer, int decimal, bool omit_trailing_zeroes) {
+	auto fast = Parse(text, integer, decimal, omit_trailing_zeroes, false);
+	auto scalar = Parse(text, integer, decimal, omit_trailing_zeroes, true);
+
+	EXPECT_EQ(fast.parsed, scalar.parsed) << text;
+	EXPECT_EQ(fast.index, scalar.index) << text;
+	if (fast.parsed && scalar.parsed) {
+		EXPECT_EQ(std::memcmp(&fast.number, &scalar.number, sizeof(double)), 0)
+			<< text << ": " << fast.number << " != " << scalar.number;
+	}
+}
+
+}
+
+TEST(GerberFileTest, TestCoordinate) {
+	GerberFile file;
+	std::string text = "X-12345Y0025000D01*";
+	file.buffer_ = text;
+	file.index_ = 1;
+
+	double number;
+	EXPECT_TRUE(file.GetCoordinate(number, 2, 4, false));
+	EXPECT_DOUBLE_EQ(number, -1.2345);
+	EXPECT_EQ(file.PeekChar(), 'Y');
+
+	file.index_++;
+	EXPECT_TRUE(file.GetCoordinate(number, 3, 5, false));
+	EXPECT_DOUBLE_EQ(number, 0.25);
+	EXPECT_EQ(file.PeekChar(), 'D');
+
+	file.index_ = 1;
+	EXPECT_TRUE(file.GetCoordinate(number, 2, 4, true));
+	EXPECT_DOUBLE_EQ(number, -12.345);
+}
+
+TEST(GerberFileTest, TestCoordinateMatchesScalar) {
+	const char* fixed[] = {
+		"0*", "-0*", "+0*", "1*", "12345678*", "123456789*", "-0000000000001*",
+		"123456789012345*", "1234567890123456*", "99999999999999999999*",
+		"1.5*", "-12.25*", ".5*", "-*", "*", "  42*", "12", "1234567", "123456789",
+		"00000000D01*", "7Y8*"
+	};
+	for (auto text : fixed) {
+		for (int integer = 1; integer <= 7; integer++) {
+			for (int decimal = 0; decimal <= 9; decimal++) {
+				ExpectSameAsScalar(text, integer, decimal, false);
+				ExpectSameAsScalar(text, integer, decimal, true);
+			}
+		}
+	}
+
+	std::mt19937_64 random(20240601);
+	std::uniform_int_distribution<int> digit_count(1, 18);
+	std::uniform_int_distribution<int> digit('0', '9');
+	std::uniform_int_distribution<int> format(1, 9);
+	const char terminators[] = "XYIJD*";
+
+	for (int k = 0; k < 100000; k++) {
+		std::string text;
+		switch (random() % 3) {
+		case 0: text += '-'; break;
+		case 1: text += '+'; break;
+		default: break;
+		}
+
+		auto count = digit_count(random);
+		for (int i = 0; i < count; i++) {
+			text += static_cast<char>(digit(random));
+		}
+		text += terminators[random() % 6];
+		text += "0123456789*";
+
+		ExpectSameAsScalar(text, format(random), format(random), (random() & 1) != 0);
+	}
+}
+
+TEST(GerberFileTest, TestSkipWhiteSpace) {
+	for (std::size_t length = 0; length < 80; length++) {
+		std::string text(length, ' ');
+		for (std::size_t i = 0; i < length; i++) {
+			text[i] = " \t\r\n"[i % 4];
+		}
+		text += "G04*";
+
+		GerberFile file;
+		file.buffer_ = text;
+		EXPECT_FALSE(file.SkipWhiteSpace());
+		EXPECT_EQ(file.index_, length);
+
+		EXPECT_TRUE(file.QueryCharUntilEnd('*'));
+		EXPECT_EQ(file.index_, length + 3);
+		EXPECT_FALSE(file.QueryCharUntilEnd('%'));
+		EXPECT_TRUE(file.EndOfFile());
+	}
+}
+
+TEST(GerberFileTest, TestString) {
+	std::string text = "  Top*Top Copper ,\tA\r\nB C*Last";
+
+	GerberFile file;
+	file.buffer_ = text;
+
+	// Without white space, as everywhere else in a statement
+	std::string_view name;
+	ASSERT_TRUE(file.GetString(name));
+	EXPECT_EQ(name, "Top");
+	EXPECT_EQ(name.data(), text.data() + 2);
+	EXPECT_EQ(file.GetChar(), '*');
+
+	ASSERT_TRUE(file.GetString(name));
+	EXPECT_EQ(name, "TopCopper");
+	EXPECT_EQ(file.GetChar(), ',');
+
+	ASSERT_TRUE(file.GetString(name));
+	EXPECT_EQ(name, "ABC");
+	EXPECT_EQ(file.GetChar(), '*');
+
+	// Not terminated
+	EXPECT_FALSE(file.GetString(name));
+}
+
+TEST(GerberFileTest, TestLineNumber) {
+	std::string text = "G04 first*\r\nG01*\n\n";
+	for (int i = 0; i < 100; i++) {
+		text += "X" + std::to_string(i) + "Y0D01*\n";
+	}
+
+	GerberFile file;
+	file.buffer_ = text;
+	EXPECT_EQ(file.LineNumber(), 1);
+
+	file.index_ = text.find("G01");
+	EXPECT_EQ(file.LineNumber(), 2);
+
+	file.index_ = text.find("X57Y");
+	EXPECT_EQ(file.LineNumber(), 61);
+
+	// Going back uses the index built so far.
+	file.index_ = text.find("X3Y");
+	EXPECT_EQ(file.LineNumber(), 7);
+
+	file.index_ = text.size();
+	EXPECT_EQ(file.LineNumber(), 104);
+}
+
+TEST(GerberFileTest, TestStreamedLineNumber) {
+	std::string text;
+	for (int i = 0; i < 1000; i++) {
+		text += "X" + std::to_string(i) + "D02*\n";
+	}
+
+	GerberFile file;
+	file.Load(std::make_unique<StreamChunkReader>(std::make_unique<std::istringstream>(text)), 16);
+
+	int line = 1;
+	while (file.Prefetch()) {
+		if (file.SkipWhiteSpace()) {
+			break;
+		}
+
+		EXPECT_EQ(file.LineNumber(), line);
+		file.QueryCharUntilEnd('*');
+		file.index_++;
+		line++;
+	}
+	EXPECT_EQ(line, 1001);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include "gerber/gerber/gerber_macro.h"
+
+
+namespace {
+
+std::vector<std::shared_ptr<RenderCommand>> Render(const std::string& source, std::vector<double> modifiers) {
+	GerberMacro macro;
+	EXPECT_TRUE(macro.LoadMacro(source.data(), static_cast<unsigned>(source.size()), false));
+	std::vector<std::shared_ptr<RenderCommand>> renders;
+	EXPECT_TRUE(macro.Render(modifiers.data(), static_cast<int>(modifiers.size()), renders));
+	return renders;
+}
+
+}
+
+TEST(GerberMacroTest, TestExpressions) {
+	auto renders = Render("$3=$1+$2x2*1,1,$3,(1+2)x0.5,-$2*", { 1.0, 2.0 });
+	ASSERT_EQ(renders.size(), 2);
+	EXPECT_EQ(renders[0]->command_, RenderCommand::gcCircle);
+	EXPECT_DOUBLE_EQ(renders[0]->W, 5.0);
+	EXPECT_DOUBLE_EQ(renders[0]->X, 1.5);
+	EXPECT_DOUBLE_EQ(renders[0]->Y, -2.0);
+	EXPECT_EQ(renders[1]->command_, RenderCommand::gcFill);
+}
+
+TEST(GerberMacroTest, TestAssignmentReadsItself) {
+	std::string source = "$1=$1x2-0.5*1,0,$1,0,0*";
+	GerberMacro macro;
+	ASSERT_TRUE(macro.LoadMacro(source.data(), static_cast<unsigned>(source.size()), false));
+
+	double modifiers[] = { 1.5 };
+	std::vector<std::shared_ptr<RenderCommand>> renders;
+	ASSERT_TRUE(macro.Render(modifiers, 1, renders));
+	ASSERT_EQ(renders.size(), 2);
+	EXPECT_DOUBLE_EQ(renders[0]->W, 2.5);
+	EXPECT_EQ(renders[1]->command_, RenderCommand::gcErase);
+
+	// The assignment must not leak into the caller's modifiers
+	EXPECT_EQ(modifiers[0], 1.5);
+}
+
+TEST(GerberMacroTest, TestMissingModifiersAreZero) {
+	auto renders = Render("1,1,2*", {});
+	ASSERT_EQ(renders.size(), 2);
+	EXPECT_DOUBLE_EQ(renders[0]->W, 2.0);
+	EXPECT_DOUBLE_EQ(renders[0]->X, 0.0);
+	EXPECT_DOUBLE_EQ(renders[0]->Y, 0.0);
+}
+
+TEST(GerberMacroTest, TestDeepNestingRejected) {
+	// Every right-nested operand needs another stack slot
+	std::string expression = "$1";
+	for (int i = 0; i < 100; i++) {
+		expression = "$1+(" + expression + ")";
+	}
+	auto source = "1,1," + expression + "*";
+	GerberMacro macro;
+	EXPECT_FALSE(macro.LoadMacro(source.data(), static_cast<unsigned>(source.size()), false));
+}
+
+TEST(GerberMacroTest, TestConcurrentRender) {
+	std::string source = "$3=$1x0.5*1,1,$1,0,0*7,0,0,$1,$1-$2,$2/2,45*21,1,$3,$2,0,0,30*";
+	GerberMacro macro;
+	ASSERT_TRUE(macro.LoadMacro(source.data(), static_cast<unsigned>(source.size()), false));
+
+	auto render = [&macro](int i) {
+		double modifiers[] = { 1.0 + i * 0.01, 0.2 };
+		std::vector<std::shared_ptr<RenderCommand>> renders;
+		macro.Render(modifiers, 2, renders);
+		return renders;
+	};
+
+	constexpr int kCount = 200;
+	std::vector<std::vector<std::shared_ptr<RenderCommand>>> expected;
+	for (int i = 0; i < kCount; i++) {
+		expected.push_back(render(i));
+	}
+
+	std::vector<std::vector<std::shared_ptr<RenderCommand>>> actual(kCount);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&, t] {
+			for (int i = t; i < kCount; i += 4) {
+				actual[i] = render(i);
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (int i = 0; i < kCount; i++) {
+		ASSERT_EQ(actual[i].size(), expected[i].size());
+		for (size_t j = 0; j < actual[i].size(); j++) {
+			EXPECT_EQ(actual[i][j]->command_, expected[i][j]->command_);
+			EXPECT_EQ(actual[i][j]->X, expected[i][j]->X);
+			EXPECT_EQ(actual[i][j]->Y, expected[i][j]->Y);
+			EXPECT_EQ(actual[i][j]->W, expected[i][j]->W);
+			EXPECT_EQ(actual[i][j]->A, expected[i][j]->A);
+		}
+	}
+}
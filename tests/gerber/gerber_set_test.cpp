@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include "gerber/gerber_set.h"
+
+
+TEST(GerberSetTest, TestLoadMatchesSerial) {
+	std::vector<std::string> file_names;
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		file_names.push_back(std::string(TestData) + name);
+	}
+
+	std::atomic<int> loaded{ 0 };
+	GerberSet set(2);
+	auto futures = set.Load(file_names, glMapped, [&loaded](std::shared_ptr<Gerber>) { ++loaded; });
+
+	BoundBox bound_box;
+	auto gerbers = set.Gerbers();
+	ASSERT_EQ(gerbers.size(), file_names.size());
+	for (size_t i = 0; i < file_names.size(); ++i) {
+		EXPECT_EQ(futures[i].get(), gerbers[i]);
+		EXPECT_EQ(gerbers[i]->FileName(), file_names[i]);
+
+		Gerber serial(file_names[i]);
+		EXPECT_EQ(gerbers[i]->GetBBox(), serial.GetBBox());
+		EXPECT_EQ(gerbers[i]->Levels().size(), serial.Levels().size());
+		bound_box.UpdateBox(serial.GetBBox());
+	}
+
+	EXPECT_EQ(loaded.load(), static_cast<int>(file_names.size()));
+	EXPECT_EQ(set.GetBBox(), bound_box);
+}
+
+TEST(GerberSetTest, TestBBoxSkipsFailedFiles) {
+	// Away from the origin
+	auto file_name = testing::TempDir() + "away_from_origin.gbr";
+	{
+		std::ofstream file(file_name, std::ios::binary);
+		file << "%FSLAX26Y26*%\n%MOMM*%\n%ADD10C,1*%\nD10*\nX10000000Y10000000D03*\nM02*\n";
+	}
+
+	GerberSet set(2);
+	set.Load(std::string(TestData) + "missing.gbr");
+	set.Load(file_name);
+
+	auto gerbers = set.Gerbers();
+	ASSERT_EQ(gerbers.size(), 2);
+	EXPECT_TRUE(gerbers[0]->Levels().empty());
+	EXPECT_EQ(set.GetBBox(), BoundBox(9.5, 10.5, 10.5, 9.5));
+}
+
+TEST(GerberSetTest, TestLoadFromSeveralThreads) {
+	auto e_gbs = std::string(TestData) + "2301113563-e-gbs";
+	auto susb = std::string(TestData) + "susb.gbr";
+
+	GerberSet set(2);
+	std::thread first([&set, &e_gbs]() {
+		for (int i = 0; i < 8; i++) {
+			set.Load(e_gbs);
+		}
+	});
+	std::thread second([&set, &susb]() {
+		set.Load(std::vector<std::string>(8, susb));
+	});
+	std::thread reader([&set]() {
+		for (int i = 0; i < 8; i++) {
+			EXPECT_LE(set.Gerbers().size(), 16);
+		}
+	});
+	first.join();
+	second.join();
+	reader.join();
+
+	auto gerbers = set.Gerbers();
+	ASSERT_EQ(gerbers.size(), 16);
+	EXPECT_EQ(std::count_if(gerbers.begin(), gerbers.end(), [&susb](const std::shared_ptr<Gerber>& gerber) {
+		return gerber->FileName() == susb;
+	}), 8);
+}
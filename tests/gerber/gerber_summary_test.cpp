@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "gerber/gerber.h"
+#include "gerber/gerber_summary.h"
+
+
+TEST(GerberSummaryTest, TestMatchesFullParse) {
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		Gerber gerber(std::string(TestData) + name);
+		GerberSummary summary(std::string(TestData) + name);
+
+		EXPECT_TRUE(summary.IsValid());
+		EXPECT_EQ(summary.Unit(), gerber.Unit());
+		EXPECT_EQ(summary.GetBBox(), gerber.GetBBox()) << name;
+		EXPECT_EQ(summary.IsNegative(), gerber.IsNegative());
+		EXPECT_EQ(summary.Name(), gerber.Name());
+		EXPECT_EQ(summary.LevelCount(), gerber.Levels().size());
+
+		std::array<std::size_t, RenderCommand::gcCount> counts{};
+		for (const auto& level : gerber.Levels()) {
+			for (const auto& render : level->RenderCommands()) {
+				counts[render.command_]++;
+			}
+		}
+		for (int command = RenderCommand::gcRectangle; command < RenderCommand::gcCount; command++) {
+			EXPECT_EQ(summary.CommandCount(static_cast<RenderCommand::GerberCommand>(command)), counts[command]) << name;
+		}
+	}
+}
+
+TEST(GerberSummaryTest, TestCommandsNotParsed) {
+	GerberSummary summary(std::string(TestData) + "2301113563-f-gtl");
+	ASSERT_GT(summary.CommandCount(RenderCommand::gcFlash), 0u);
+
+	EXPECT_EQ(summary.CommandCount(RenderCommand::gcDot), 0u);
+	EXPECT_EQ(summary.CommandCount(RenderCommand::gcCount), 0u);
+}
+
+TEST(GerberSummaryTest, TestFormatAndApertures) {
+	GerberSummary summary(std::string(TestData) + "2301113563-e-gbs");
+
+	auto format = summary.Format();
+	EXPECT_GT(format.XInteger + format.XDecimal, 0);
+	EXPECT_GT(format.YInteger + format.YDecimal, 0);
+
+	auto apertures = summary.Apertures();
+	ASSERT_FALSE(apertures.empty());
+	for (size_t i = 1; i < apertures.size(); ++i) {
+		EXPECT_LT(apertures[i - 1]->code_, apertures[i]->code_);
+	}
+}
+
+TEST(GerberSummaryTest, TestMissingFile) {
+	GerberSummary summary(std::string(TestData) + "missing.gbr");
+	EXPECT_FALSE(summary.IsValid());
+	EXPECT_EQ(summary.LevelCount(), 0);
+}
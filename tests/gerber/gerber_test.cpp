@@ -1,4 +1,10 @@
 #include <gtest/gtest.h>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <vector>
 #include "gerber/gerber.h"
 #include "gerber/gerber_enums.h"
 
@@ -10,7 +16,7 @@ TEST(GerberTest, TestParseFile1) {
 	EXPECT_EQ(gerber.Name(), "");
 	EXPECT_FALSE(gerber.IsNegative());
 
-	auto levels = gerber.Levels();
+	const auto& levels = gerber.Levels();
 	EXPECT_EQ(levels.size(), 4);
 	EXPECT_EQ((*(++levels.begin()))->name_, "2301113563-e-gbs.sub2");
 	EXPECT_DOUBLE_EQ((*(++levels.begin()))->StepX, 12.800000000000001);
@@ -31,14 +37,14 @@ TEST(GerberTest, TestParseFile1) {
 	EXPECT_EQ((*(++levels.begin()))->units_, GERBER_UNIT::guMillimeters);
 	EXPECT_EQ((*(++levels.begin()))->RenderCommands().size(), 367);
 
-	auto renders = (*(++levels.begin()))->RenderCommands();
+	const auto& renders = (*(++levels.begin()))->RenderCommands();
 	auto iter = renders.begin();
 	++iter;
 	++iter;
 	++iter;
-	EXPECT_EQ((*iter)->command_, RenderCommand::GerberCommand::gcLine);
-	EXPECT_DOUBLE_EQ((*iter)->X, 43.714999999999996);
-	EXPECT_DOUBLE_EQ((*iter)->Y, -28.337990000000001);
+	EXPECT_EQ((*iter).command_, RenderCommand::GerberCommand::gcLine);
+	EXPECT_DOUBLE_EQ((*iter).X, 43.714999999999996);
+	EXPECT_DOUBLE_EQ((*iter).Y, -28.337990000000001);
 }
 
 TEST(GerberTest, TestParseFile2) {
@@ -48,7 +54,7 @@ TEST(GerberTest, TestParseFile2) {
 	EXPECT_EQ(gerber.Name(), "");
 	EXPECT_FALSE(gerber.IsNegative());
 
-	auto levels = gerber.Levels();
+	const auto& levels = gerber.Levels();
 	EXPECT_EQ(levels.size(), 1);
 	EXPECT_EQ(levels.front()->name_, "lth_1-3_scpt.gbr");
 	EXPECT_DOUBLE_EQ(levels.front()->StepX, 0.0);
@@ -69,14 +75,14 @@ TEST(GerberTest, TestParseFile2) {
 	EXPECT_EQ(levels.front()->units_, GERBER_UNIT::guMillimeters);
 	EXPECT_EQ(levels.front()->RenderCommands().size(), 3934);
 
-	auto renders = levels.front()->RenderCommands();
+	const auto& renders = levels.front()->RenderCommands();
 	auto iter = renders.begin();
 	++iter;
 	++iter;
 	++iter;
-	EXPECT_EQ((*iter)->command_, RenderCommand::GerberCommand::gcFlash);
-	EXPECT_DOUBLE_EQ((*iter)->X, -3.7799999999999998);
-	EXPECT_DOUBLE_EQ((*iter)->Y, 58.826800000000006);
+	EXPECT_EQ((*iter).command_, RenderCommand::GerberCommand::gcFlash);
+	EXPECT_DOUBLE_EQ((*iter).X, -3.7799999999999998);
+	EXPECT_DOUBLE_EQ((*iter).Y, 58.826800000000006);
 }
 
 TEST(GerberTest, TestParseFile3) {
@@ -86,7 +92,7 @@ TEST(GerberTest, TestParseFile3) {
 	EXPECT_EQ(gerber.Name(), "");
 	EXPECT_FALSE(gerber.IsNegative());
 
-	auto levels = gerber.Levels();
+	const auto& levels = gerber.Levels();
 	EXPECT_EQ(levels.size(), 1);
 	EXPECT_EQ(levels.front()->name_, "susb_scpt.gbr");
 	EXPECT_DOUBLE_EQ(levels.front()->StepX, 0.0);
@@ -107,12 +113,327 @@ TEST(GerberTest, TestParseFile3) {
 	EXPECT_EQ(levels.front()->units_, GERBER_UNIT::guMillimeters);
 	EXPECT_EQ(levels.front()->RenderCommands().size(), 576);
 
-	auto renders = levels.front()->RenderCommands();
+	const auto& renders = levels.front()->RenderCommands();
 	auto iter = renders.begin();
 	++iter;
 	++iter;
 	++iter;
-	EXPECT_EQ((*iter)->command_, RenderCommand::GerberCommand::gcArc);
-	EXPECT_DOUBLE_EQ((*iter)->X, -23.668299999999999);
-	EXPECT_DOUBLE_EQ((*iter)->Y, 1.0);
+	EXPECT_EQ((*iter).command_, RenderCommand::GerberCommand::gcArc);
+	EXPECT_DOUBLE_EQ((*iter).X, -23.668299999999999);
+	EXPECT_DOUBLE_EQ((*iter).Y, 1.0);
+}
+
+TEST(GerberTest, TestBufferedLoadMatchesMapped) {
+	Gerber mapped(std::string(TestData) + "lth_1-3.gbr", glMapped);
+	Gerber buffered(std::string(TestData) + "lth_1-3.gbr", glBuffered);
+
+	EXPECT_EQ(mapped.GetBBox(), buffered.GetBBox());
+	ASSERT_EQ(mapped.Levels().size(), buffered.Levels().size());
+	EXPECT_EQ(mapped.Levels().front()->RenderCommands().size(), buffered.Levels().front()->RenderCommands().size());
+}
+
+TEST(GerberTest, TestStreamedLoadMatchesMapped) {
+	// Larger than GerberFile::kChunkSize, so statements straddle chunk boundaries.
+	Gerber mapped(std::string(TestData) + "2301113563-f-gtl", glMapped);
+	Gerber streamed(std::string(TestData) + "2301113563-f-gtl", glStreamed);
+
+	EXPECT_EQ(mapped.GetBBox(), streamed.GetBBox());
+
+	const auto& mapped_levels = mapped.Levels();
+	const auto& streamed_levels = streamed.Levels();
+	ASSERT_EQ(mapped_levels.size(), streamed_levels.size());
+	for (size_t i = 0; i < mapped_levels.size(); ++i) {
+		EXPECT_EQ(mapped_levels[i]->name_, streamed_levels[i]->name_);
+
+		const auto& mapped_renders = mapped_levels[i]->RenderCommands();
+		const auto& streamed_renders = streamed_levels[i]->RenderCommands();
+		ASSERT_EQ(mapped_renders.size(), streamed_renders.size());
+		for (size_t j = 0; j < mapped_renders.size(); ++j) {
+			EXPECT_EQ(mapped_renders[j].command_, streamed_renders[j].command_);
+			EXPECT_EQ(mapped_renders[j].X, streamed_renders[j].X);
+			EXPECT_EQ(mapped_renders[j].Y, streamed_renders[j].Y);
+		}
+	}
+}
+
+TEST(GerberTest, TestParallelParseMatchesSerial) {
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		Gerber serial(std::string(TestData) + name);
+		Gerber parallel(std::string(TestData) + name, glMapped, 4);
+
+		EXPECT_EQ(serial.Unit(), parallel.Unit());
+		EXPECT_EQ(serial.Name(), parallel.Name());
+		EXPECT_EQ(serial.IsNegative(), parallel.IsNegative());
+		EXPECT_EQ(serial.GetBBox(), parallel.GetBBox());
+
+		const auto& serial_levels = serial.Levels();
+		const auto& parallel_levels = parallel.Levels();
+		ASSERT_EQ(serial_levels.size(), parallel_levels.size()) << name;
+		for (size_t i = 0; i < serial_levels.size(); ++i) {
+			EXPECT_EQ(serial_levels[i]->name_, parallel_levels[i]->name_);
+			EXPECT_EQ(serial_levels[i]->negative_, parallel_levels[i]->negative_);
+			EXPECT_EQ(serial_levels[i]->CountX, parallel_levels[i]->CountX);
+			EXPECT_EQ(serial_levels[i]->CountY, parallel_levels[i]->CountY);
+			EXPECT_EQ(serial_levels[i]->StepX, parallel_levels[i]->StepX);
+			EXPECT_EQ(serial_levels[i]->StepY, parallel_levels[i]->StepY);
+			EXPECT_EQ(serial_levels[i]->bound_box_, parallel_levels[i]->bound_box_);
+
+			const auto& serial_renders = serial_levels[i]->RenderCommands();
+			const auto& parallel_renders = parallel_levels[i]->RenderCommands();
+			ASSERT_EQ(serial_renders.size(), parallel_renders.size()) << name;
+			for (size_t j = 0; j < serial_renders.size(); ++j) {
+				EXPECT_EQ(serial_renders[j].command_, parallel_renders[j].command_);
+				EXPECT_EQ(serial_renders[j].X, parallel_renders[j].X);
+				EXPECT_EQ(serial_renders[j].Y, parallel_renders[j].Y);
+				ASSERT_EQ(!serial_renders[j].aperture_, !parallel_renders[j].aperture_);
+				if (serial_renders[j].aperture_) {
+					EXPECT_EQ(serial_renders[j].aperture_->code_, parallel_renders[j].aperture_->code_);
+				}
+			}
+		}
+	}
+}
+
+TEST(GerberTest, TestParallelParseReportsOnce) {
+	const std::string header = "%FSLAX26Y26*%\n%MOMM*%\n%ADD10C,0.1*%\n";
+	// Two levels, a deprecated code and an undefined aperture, which stops
+	// the parse
+	const std::string failed = header +
+		"%LPD*%\nG70*\nD10*\nX0Y0D03*\n"
+		"%LPC*%\nD11*\nX0Y0D03*\nM02*\n";
+	// Three levels, two with an open contour, parsed concurrently
+	const std::string open = header +
+		"%LPD*%\nD10*\nG36*\nX0Y0D02*\nX1000000Y0D01*\nX1000000Y1000000D01*\nG37*\n"
+		"%LPC*%\nX0Y0D03*\n"
+		"%LPD*%\nG36*\nX0Y0D02*\nX2000000Y0D01*\nX2000000Y2000000D01*\nG37*\nM02*\n";
+	// A null in a level name, which stops the parse
+	const auto null = header + "%LPD*%\nD10*\nX0Y0D03*\n%LNA" + std::string(1, '\0') + "B*%\nM02*\n";
+
+	struct CASE {
+		const std::string& text_;
+		std::vector<const char*> messages_;
+	};
+	for (const auto& test : {
+		CASE{ failed, { "Deprecated code: G70", "Aperture not defined: D11" } },
+		CASE{ open, { "Line 10 - Warning: Deprecated feature: Open contours", "Line 18 - Warning: Deprecated feature: Open contours" } },
+		CASE{ null, { "Null in name not allowed" } } }) {
+		for (auto threads : { 1u, 4u }) {
+			testing::internal::CaptureStderr();
+			Gerber::FromMemory(test.text_, threads);
+			auto output = testing::internal::GetCapturedStderr();
+
+			// Once each, in the order of the file
+			std::size_t last = 0;
+			for (auto message : test.messages_) {
+				std::size_t count = 0;
+				for (auto i = output.find(message); i != output.npos; i = output.find(message, i + 1)) {
+					EXPECT_GE(i, last) << message << " with " << threads << " threads";
+					last = i;
+					count++;
+				}
+				EXPECT_EQ(count, 1) << message << " with " << threads << " threads";
+			}
+		}
+	}
+}
+
+TEST(GerberTest, TestMemoryAndStreamLoadMatchFile) {
+	auto file_name = std::string(TestData) + "2301113563-e-gbs";
+	std::ifstream file(file_name, std::ios::binary);
+	std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	Gerber from_file(file_name);
+	auto from_memory = Gerber::FromMemory(text);
+	std::istringstream buffered_stream(text);
+	auto buffered = Gerber::FromStream(buffered_stream);
+	std::istringstream streamed_stream(text);
+	auto streamed = Gerber::FromStream(streamed_stream, glStreamed);
+
+	for (const auto& gerber : { from_memory, buffered, streamed }) {
+		EXPECT_EQ(gerber->FileName(), "");
+		EXPECT_EQ(gerber->Unit(), from_file.Unit());
+		EXPECT_EQ(gerber->GetBBox(), from_file.GetBBox());
+
+		const auto& levels = gerber->Levels();
+		ASSERT_EQ(levels.size(), from_file.Levels().size());
+		for (size_t i = 0; i < levels.size(); ++i) {
+			EXPECT_EQ(levels[i]->RenderCommands().size(), from_file.Levels()[i]->RenderCommands().size());
+		}
+	}
+}
+
+TEST(GerberTest, TestPackedCommandsMatchUnpacked) {
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		Gerber unpacked(std::string(TestData) + name);
+		Gerber packed(std::string(TestData) + name);
+		packed.PackCommands();
+
+		const auto& unpacked_levels = unpacked.Levels();
+		const auto& packed_levels = packed.Levels();
+		ASSERT_EQ(unpacked_levels.size(), packed_levels.size()) << name;
+		for (size_t i = 0; i < unpacked_levels.size(); ++i) {
+			const auto& unpacked_renders = unpacked_levels[i]->RenderCommands();
+			const auto& packed_renders = packed_levels[i]->RenderCommands();
+			EXPECT_TRUE(packed_renders.Packed());
+			EXPECT_LE(packed_renders.MemoryUsage(), unpacked_renders.MemoryUsage());
+			ASSERT_EQ(unpacked_renders.size(), packed_renders.size()) << name;
+
+			auto packed_iter = packed_renders.begin();
+			for (const auto& render : unpacked_renders) {
+				EXPECT_EQ(render.command_, packed_iter->command_);
+				EXPECT_EQ(render.X, packed_iter->X);
+				EXPECT_EQ(render.Y, packed_iter->Y);
+				EXPECT_EQ(render.W, packed_iter->W);
+				EXPECT_EQ(render.H, packed_iter->H);
+				EXPECT_EQ(render.A, packed_iter->A);
+				EXPECT_EQ(render.End.X, packed_iter->End.X);
+				EXPECT_EQ(render.End.Y, packed_iter->End.Y);
+				ASSERT_EQ(!render.aperture_, !packed_iter->aperture_);
+				if (render.aperture_) {
+					EXPECT_EQ(render.aperture_->code_, packed_iter->aperture_->code_);
+				}
+				++packed_iter;
+			}
+		}
+	}
+}
+
+TEST(GerberTest, TestStrokesToFillsJoinsSegments) {
+	// A square out of order, with two sides backwards and one end 0.5 μm off
+	auto gerber = Gerber::FromMemory(
+		"%FSLAX46Y46*%\n%MOMM*%\n%ADD10C,0.1*%\nD10*\nG01*\n"
+		"X10000000Y10000000D02*\nX10000000Y0D01*\n"
+		"X0Y0D02*\nX10000000Y500D01*\n"
+		"X0Y10000000D02*\nX10000000Y10000000D01*\n"
+		"X0Y10000000D02*\nX0Y0D01*\n"
+		"M02*\n"
+	);
+	ASSERT_EQ(gerber->Levels().size(), 1u);
+	const auto& level = *gerber->Levels().front();
+
+	std::vector<RenderCommand> renders;
+	for (const auto& render : level.Fills().RenderCommands()) {
+		renders.push_back(render);
+	}
+
+	ASSERT_EQ(renders.size(), 8u);
+	EXPECT_EQ(renders[0].command_, RenderCommand::gcBeginOutline);
+	EXPECT_EQ(renders[1].command_, RenderCommand::gcBeginLine);
+	EXPECT_EQ(renders[1].X, 10.0);
+	EXPECT_EQ(renders[1].Y, 10.0);
+
+	const double corners[][2] = { { 10.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 10.0 }, { 10.0, 10.0 } };
+	for (int i = 0; i < 4; i++) {
+		EXPECT_EQ(renders[i + 2].command_, RenderCommand::gcLine);
+		EXPECT_EQ(renders[i + 2].End.X, corners[i][0]) << i;
+		EXPECT_EQ(renders[i + 2].End.Y, corners[i][1]) << i;
+	}
+
+	// Closed, so without gcClose
+	EXPECT_EQ(renders[6].command_, RenderCommand::gcFill);
+	EXPECT_EQ(renders[7].command_, RenderCommand::gcEndOutline);
+
+	// Computed once, leaving the strokes alone
+	EXPECT_EQ(&level.Fills(), &level.Fills());
+	EXPECT_EQ(level.RenderCommands().size(), 13u);
+}
+
+TEST(GerberTest, TestParallelStrokesToFillsMatchesSerial) {
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		Gerber serial(std::string(TestData) + name);
+		Gerber parallel(std::string(TestData) + name);
+		serial.ConvertStrokesToFills(1);
+		parallel.ConvertStrokesToFills(4);
+
+		const auto& serial_levels = serial.Levels();
+		const auto& parallel_levels = parallel.Levels();
+		ASSERT_EQ(serial_levels.size(), parallel_levels.size()) << name;
+		for (size_t i = 0; i < serial_levels.size(); ++i) {
+			const auto& serial_renders = serial_levels[i]->Fills().RenderCommands();
+			const auto& parallel_renders = parallel_levels[i]->Fills().RenderCommands();
+			ASSERT_EQ(serial_renders.size(), parallel_renders.size()) << name;
+
+			auto parallel_iter = parallel_renders.begin();
+			for (const auto& render : serial_renders) {
+				EXPECT_EQ(render.command_, parallel_iter->command_);
+				EXPECT_EQ(render.X, parallel_iter->X);
+				EXPECT_EQ(render.Y, parallel_iter->Y);
+				EXPECT_EQ(render.A, parallel_iter->A);
+				EXPECT_EQ(render.End.X, parallel_iter->End.X);
+				EXPECT_EQ(render.End.Y, parallel_iter->End.Y);
+				++parallel_iter;
+			}
+		}
+	}
+}
+
+namespace {
+
+// The arc extent as it used to be found, from 1000 points along the arc
+BoundBox SampledArcBox(double x3, double y3, double x1, double y1, double angle) {
+	constexpr double kPi = 3.141592653589793238463;
+
+	auto r = x3 + x1;
+	auto t = y3 + y1;
+	auto l = r;
+	auto b = t;
+
+	auto d = atan2(y1, x1);
+	const auto rad = sqrt(x1 * x1 + y1 * y1);
+	const auto dd = angle * kPi / 180e3;
+	for (int j = 0; j < 1000; ++j) {
+		const auto x = x3 + rad * cos(d);
+		const auto y = y3 + rad * sin(d);
+		l = std::min(l, x);
+		b = std::min(b, y);
+		r = std::max(r, x);
+		t = std::max(t, y);
+		d += dd;
+	}
+
+	return BoundBox(l, r, t, b);
+}
+
+}
+
+TEST(GerberTest, TestArcBoxMatchesSampledArc) {
+	// Multiples of 0.5 mm, which the parser reads exactly, so that the start
+	// relative to the center is exactly what the plotter had. Offsets are not
+	// 0, whose sign the center does not tell.
+	std::mt19937 random(1);
+	auto coordinate = [&]() { return static_cast<int>(random() % 201) - 100; };
+	auto offset = [&]() { auto value = coordinate(); return value ? value : 1; };
+
+	for (int i = 0; i < 2000; i++) {
+		const auto start_x = coordinate(), start_y = coordinate();
+		const auto end_x = coordinate(), end_y = coordinate();
+		const auto multi_quadrant = i % 2 == 0;
+		auto offset_i = offset(), offset_j = offset();
+		if (!multi_quadrant) {
+			offset_i = std::abs(offset_i);
+			offset_j = std::abs(offset_j);
+		}
+
+		std::ostringstream text;
+		text << "%FSLAX36Y36*%\n%MOMM*%\n%ADD10C,0*%\nD10*\n" << (multi_quadrant ? "G75*\n" : "G74*\n")
+			<< "X" << start_x * 500000 << "Y" << start_y * 500000 << "D02*\n"
+			<< (i % 4 < 2 ? "G02" : "G03") << "X" << end_x * 500000 << "Y" << end_y * 500000
+			<< "I" << offset_i * 500000 << "J" << offset_j * 500000 << "D01*\nM02*\n";
+
+		auto gerber = Gerber::FromMemory(text.str());
+		ASSERT_EQ(gerber->Levels().size(), 1u) << text.str();
+		const auto& level = *gerber->Levels().front();
+
+		auto arc = level.RenderCommands().begin();
+		while (arc != level.RenderCommands().end() && arc->command_ != RenderCommand::gcArc) {
+			++arc;
+		}
+		ASSERT_NE(arc, level.RenderCommands().end()) << text.str();
+
+		// The line that the arc is drawn in also covers both ends
+		auto expected = SampledArcBox(arc->X, arc->Y, start_x * 0.5 - arc->X, start_y * 0.5 - arc->Y, arc->A);
+		expected.UpdateBox(start_x * 0.5, start_x * 0.5, start_y * 0.5, start_y * 0.5);
+		expected.UpdateBox(end_x * 0.5, end_x * 0.5, end_y * 0.5, end_y * 0.5);
+		EXPECT_EQ(level.bound_box_, expected) << text.str();
+	}
 }
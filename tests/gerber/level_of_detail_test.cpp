@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "gerber/gerber.h"
+#include "gerber/gerber/level_of_detail.h"
+#include "render_commands.h"
+
+
+namespace {
+
+RenderCommand Select(double diameter) {
+	auto aperture = std::make_shared<GerberAperture>();
+	aperture->Circle(diameter);
+
+	RenderCommand select(RenderCommand::gcApertureSelect);
+	select.aperture_ = aperture;
+	return select;
+}
+
+std::vector<RenderCommand> Commands(const LevelOfDetail& detail) {
+	std::vector<RenderCommand> result;
+	for (const auto& command : detail.RenderCommands()) {
+		result.push_back(command);
+	}
+	return result;
+}
+
+}
+
+TEST(LevelOfDetailTest, TestArcWithinTolerance) {
+	constexpr double kTolerance = 0.1;
+
+	// A full circle of radius 10 around the origin
+	CommandStore commands;
+	commands.Add(Select(0.5));
+	commands.Add(Make(RenderCommand::gcBeginLine, 10.0, 0.0));
+	auto arc = Make(RenderCommand::gcArc, 0.0, 0.0);
+	arc.End.X = 10.0;
+	arc.End.Y = 0.0;
+	arc.A = 360.0;
+	commands.Add(arc);
+	commands.Add(Make(RenderCommand::gcStroke));
+
+	LevelOfDetail detail(commands, kTolerance);
+	auto result = Commands(detail);
+	ASSERT_GE(result.size(), 6u);
+	EXPECT_EQ(result.front().command_, RenderCommand::gcApertureSelect);
+	EXPECT_EQ(result.back().command_, RenderCommand::gcStroke);
+
+	for (std::size_t i = 1; i + 1 < result.size(); i++) {
+		EXPECT_EQ(result[i].command_, i == 1 ? RenderCommand::gcBeginLine : RenderCommand::gcLine);
+		EXPECT_NEAR(std::hypot(result[i].X, result[i].Y), 10.0, 1e-9);
+
+		// The middle of every chord is close enough to the circle
+		if (i > 1) {
+			const auto x = (result[i - 1].X + result[i].X) / 2.0;
+			const auto y = (result[i - 1].Y + result[i].Y) / 2.0;
+			EXPECT_LE(10.0 - std::hypot(x, y), kTolerance / 2.0 + 1e-9);
+		}
+	}
+
+	EXPECT_DOUBLE_EQ(result[result.size() - 2].X, 10.0);
+	EXPECT_DOUBLE_EQ(result[result.size() - 2].Y, 0.0);
+}
+
+TEST(LevelOfDetailTest, TestStraightPolyline) {
+	CommandStore commands;
+	commands.Add(Select(0.1));
+	commands.Add(Make(RenderCommand::gcBeginLine, 0.0, 0.0));
+	for (int i = 1; i <= 100; i++) {
+		commands.Add(Make(RenderCommand::gcLine, i, i % 2 ? 0.01 : 0.0));
+	}
+	commands.Add(Make(RenderCommand::gcLine, 100.0, 50.0));
+	commands.Add(Make(RenderCommand::gcStroke));
+
+	auto result = Commands(LevelOfDetail(commands, 0.1));
+	ASSERT_EQ(result.size(), 5u);
+	EXPECT_EQ(result[1].command_, RenderCommand::gcBeginLine);
+	EXPECT_EQ(result[2].command_, RenderCommand::gcLine);
+	EXPECT_DOUBLE_EQ(result[2].X, 100.0);
+	EXPECT_DOUBLE_EQ(result[2].Y, 0.0);
+	EXPECT_EQ(result[3].command_, RenderCommand::gcLine);
+	EXPECT_DOUBLE_EQ(result[3].Y, 50.0);
+	EXPECT_EQ(result[4].command_, RenderCommand::gcStroke);
+}
+
+TEST(LevelOfDetailTest, TestSmallBecomesDot) {
+	CommandStore commands;
+	commands.Add(Select(0.1));
+	commands.Add(Make(RenderCommand::gcFlash, 1.0, 2.0));
+	commands.Add(Make(RenderCommand::gcBeginLine, 5.0, 5.0));
+	commands.Add(Make(RenderCommand::gcLine, 5.05, 5.0));
+	commands.Add(Make(RenderCommand::gcStroke));
+	commands.Add(Select(1.0));
+	commands.Add(Make(RenderCommand::gcFlash, 3.0, 4.0));
+
+	auto result = Commands(LevelOfDetail(commands, 0.1));
+	ASSERT_EQ(result.size(), 5u);
+	EXPECT_EQ(result[1].command_, RenderCommand::gcDot);
+	EXPECT_DOUBLE_EQ(result[1].X, 1.0);
+	EXPECT_DOUBLE_EQ(result[1].Y, 2.0);
+	EXPECT_EQ(result[2].command_, RenderCommand::gcDot);
+	EXPECT_DOUBLE_EQ(result[2].X, 5.025);
+	EXPECT_EQ(result[3].command_, RenderCommand::gcApertureSelect);
+	EXPECT_EQ(result[4].command_, RenderCommand::gcFlash);
+}
+
+TEST(LevelOfDetailTest, TestSmallRegions) {
+	auto square = [](CommandStore& commands, double x, double y, double size) {
+		commands.Add(Make(RenderCommand::gcBeginLine, x, y));
+		commands.Add(Make(RenderCommand::gcLine, x + size, y));
+		commands.Add(Make(RenderCommand::gcLine, x + size, y + size));
+		commands.Add(Make(RenderCommand::gcLine, x, y + size));
+		commands.Add(Make(RenderCommand::gcClose));
+	};
+
+	CommandStore commands;
+	commands.Add(Make(RenderCommand::gcBeginOutline));
+	square(commands, 0.0, 0.0, 0.1); // A dot
+	commands.Add(Make(RenderCommand::gcFill));
+	square(commands, 10.0, 0.0, 5.0);
+	square(commands, 20.0, 0.0, 0.15); // Too little area
+	commands.Add(Make(RenderCommand::gcFill));
+	commands.Add(Make(RenderCommand::gcEndOutline));
+
+	auto result = Commands(LevelOfDetail(commands, 0.1));
+	ASSERT_EQ(result.size(), 9u);
+	EXPECT_EQ(result[0].command_, RenderCommand::gcBeginOutline);
+	EXPECT_EQ(result[1].command_, RenderCommand::gcDot);
+	EXPECT_DOUBLE_EQ(result[1].X, 0.05);
+	EXPECT_EQ(result[2].command_, RenderCommand::gcBeginLine);
+	EXPECT_DOUBLE_EQ(result[2].X, 10.0);
+	EXPECT_EQ(result[6].command_, RenderCommand::gcClose);
+	EXPECT_EQ(result[7].command_, RenderCommand::gcFill);
+	EXPECT_EQ(result[8].command_, RenderCommand::gcEndOutline);
+}
+
+TEST(LevelOfDetailTest, TestFiles) {
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		Gerber gerber(std::string(TestData) + name);
+
+		for (const auto& level : gerber.Levels()) {
+			EXPECT_EQ(level->Detail(GerberLevel::kDetailTolerance / 2.0), nullptr);
+
+			const LevelOfDetail* previous = nullptr;
+			for (auto tolerance : { 0.01, 0.04, 0.16, 0.64, 2.56, 100.0 }) {
+				auto detail = level->Detail(tolerance);
+				ASSERT_NE(detail, nullptr) << name;
+				EXPECT_LE(detail->Tolerance(), tolerance);
+				EXPECT_TRUE(detail->Index().Valid()) << name;
+				EXPECT_EQ(detail, level->Detail(tolerance));
+
+				// Coarser is never more work
+				if (previous) {
+					EXPECT_LE(detail->RenderCommands().size(), previous->RenderCommands().size()) << name;
+				}
+				previous = detail;
+			}
+		}
+	}
+}
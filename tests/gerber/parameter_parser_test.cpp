@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include "gerber/gerber.h"
+#include "gerber/gerber/gerber_aperture.h"
+#include "gerber/gerber/gerber_level.h"
+
+
+namespace {
+
+std::atomic<std::size_t> allocations{ 0 };
+
+}
+
+// Counts every heap allocation made by this test binary, which holds no
+// other tests for that reason.
+void* operator new(std::size_t size) {
+	++allocations;
+	if (auto memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+namespace {
+
+// Every repetition defines a new aperture and opens two levels, one per %LP.
+std::string WriteGerber(const std::string& name, int repeat) {
+	auto file_name = testing::TempDir() + name;
+	std::ofstream file(file_name, std::ios::binary);
+
+	file << "%FSLAX26Y26*%\n%MOMM*%\n%ADD10C,0.1*%\n%LPD*%\n";
+	for (int i = 0; i < repeat; i++) {
+		file << "%ADD" << 11 + i << "C,0.1*%\n";
+		file << "%LPC*%\n";
+		file << "%TA.AperFunction,ComponentPad*%\n";
+		file << "%TF.FileFunction,Copper,L1,Top*%\n";
+		file << "%TO.N,Net-(U1-Pad1)_with_a_long_name*%\n";
+		file << "%TD*%\n";
+		file << "%FSLAX26Y26*%\n";
+		file << "%MOMM*%\n";
+		file << "%LPD*%\n";
+		file << "%IPPOS*%\n";
+		file << "%OFA0B0*%\n";
+		file << "%SFA1B1*%\n";
+	}
+	file << "D10*\nX0Y0D03*\nM02*\n";
+
+	return file_name;
+}
+
+// Allocations made by loading the file, less those of the levels and
+// apertures it defines, which are objects the parser creates by design.
+std::size_t CountAllocations(const std::string& file_name, int repeat) {
+	std::size_t level_allocations = 0;
+	std::size_t aperture_allocations = 0;
+	{
+		auto before = allocations.load();
+		auto level = std::make_shared<GerberLevel>(nullptr, guMillimeters);
+		level_allocations = allocations.load() - before;
+
+		before = allocations.load();
+		auto aperture = std::make_shared<GerberAperture>();
+		aperture->Circle(0.1);
+		aperture_allocations = allocations.load() - before;
+	}
+
+	auto before = allocations.load();
+	{
+		Gerber gerber(file_name);
+		EXPECT_EQ(gerber.Levels().size(), 1 + 2 * repeat);
+	}
+	return allocations.load() - before - repeat * (2 * level_allocations + aperture_allocations);
+}
+
+}
+
+TEST(ParameterParserTest, TestNoAllocationPerCommand) {
+	auto warnings = gerber_warnings;
+	gerber_warnings = false;
+
+	auto few = WriteGerber("parameters_few.gbr", 10);
+	auto many = WriteGerber("parameters_many.gbr", 10000);
+
+	// The extended commands themselves must not allocate, so apart from the
+	// levels and apertures only the containers holding them allocate more
+	// for more commands, a few times as they grow.
+	auto allocations_few = CountAllocations(few, 10);
+	auto allocations_many = CountAllocations(many, 10000);
+	EXPECT_GE(allocations_many, allocations_few);
+	EXPECT_LE(allocations_many, allocations_few + 64);
+
+	std::remove(few.c_str());
+	std::remove(many.c_str());
+	gerber_warnings = warnings;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "gerber/gerber/gerber_command.h"
+
+
+// A command at (x, y) that also ends there, as most commands of a level do.
+inline RenderCommand Make(RenderCommand::GerberCommand command, double x = 0.0, double y = 0.0) {
+	RenderCommand render(command);
+	render.End.X = render.X = x;
+	render.End.Y = render.Y = y;
+	return render;
+}
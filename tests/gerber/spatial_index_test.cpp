@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "gerber/gerber.h"
+#include "gerber/gerber/spatial_index.h"
+#include "render_commands.h"
+
+
+namespace {
+
+bool Intersects(const SpatialIndex::PRIMITIVE& primitive, const BoundBox& region) {
+	return primitive.left_ <= region.Right() && primitive.right_ >= region.Left() &&
+		primitive.bottom_ <= region.Top() && primitive.top_ >= region.Bottom();
+}
+
+std::vector<std::uint32_t> Query(const SpatialIndex& index, const BoundBox& region) {
+	std::vector<std::uint32_t> result;
+	index.Query(region, result);
+	return result;
+}
+
+}
+
+TEST(SpatialIndexTest, TestPrimitives) {
+	auto aperture = std::make_shared<GerberAperture>();
+	aperture->Circle(1.0);
+
+	CommandStore commands;
+	RenderCommand select(RenderCommand::gcApertureSelect);
+	select.aperture_ = aperture;
+	commands.Add(select);                                   // 0
+	commands.Add(Make(RenderCommand::gcFlash, 0.0, 0.0));   // 1
+	commands.Add(Make(RenderCommand::gcBeginLine, 10.0, 0.0));
+	commands.Add(Make(RenderCommand::gcLine, 20.0, 0.0));
+	commands.Add(Make(RenderCommand::gcStroke));            // 4
+	commands.Add(Make(RenderCommand::gcBeginOutline));
+	commands.Add(Make(RenderCommand::gcBeginLine, 0.0, 10.0));
+	commands.Add(Make(RenderCommand::gcLine, 5.0, 10.0));
+	commands.Add(Make(RenderCommand::gcClose));
+	commands.Add(Make(RenderCommand::gcFill));              // 9
+	commands.Add(Make(RenderCommand::gcEndOutline));
+
+	// A counterclockwise half circle from (30, 0) around (30, 5)
+	commands.Add(Make(RenderCommand::gcBeginLine, 30.0, 0.0));
+	auto arc = Make(RenderCommand::gcArc, 30.0, 5.0);
+	arc.End.X = 30.0;
+	arc.End.Y = 10.0;
+	arc.A = 180.0;
+	commands.Add(arc);
+	commands.Add(Make(RenderCommand::gcStroke));            // 13
+
+	SpatialIndex index;
+	ASSERT_TRUE(index.Build(commands));
+	ASSERT_EQ(index.size(), 4u);
+
+	EXPECT_EQ(index[0].first_, 1u);
+	EXPECT_EQ(index[0].last_, 2u);
+	EXPECT_EQ(index[0].select_, 0u);
+	EXPECT_EQ(index[0].outline_, SpatialIndex::kNone);
+	EXPECT_FLOAT_EQ(index[0].left_, -0.5f);
+	EXPECT_FLOAT_EQ(index[0].top_, 0.5f);
+
+	EXPECT_EQ(index[1].first_, 2u);
+	EXPECT_EQ(index[1].last_, 5u);
+	EXPECT_FLOAT_EQ(index[1].right_, 20.5f);
+
+	// Outlines are not widened by the aperture
+	EXPECT_EQ(index[2].first_, 6u);
+	EXPECT_EQ(index[2].last_, 10u);
+	EXPECT_EQ(index[2].outline_, 5u);
+	EXPECT_FLOAT_EQ(index[2].left_, 0.0f);
+	EXPECT_FLOAT_EQ(index[2].right_, 5.0f);
+
+	// The arc bulges to the right of its chord
+	EXPECT_EQ(index[3].first_, 11u);
+	EXPECT_EQ(index[3].last_, 14u);
+	EXPECT_FLOAT_EQ(index[3].left_, 29.5f);
+	EXPECT_FLOAT_EQ(index[3].right_, 35.5f);
+
+	EXPECT_EQ(Query(index, BoundBox(-1.0, 1.0, 1.0, -1.0)), std::vector<std::uint32_t>({ 0 }));
+	EXPECT_EQ(Query(index, BoundBox(4.0, 12.0, 11.0, -1.0)), std::vector<std::uint32_t>({ 1, 2 }));
+	EXPECT_EQ(Query(index, BoundBox(35.0, 36.0, 6.0, 4.0)), std::vector<std::uint32_t>({ 3 }));
+	EXPECT_EQ(Query(index, BoundBox(-100.0, 100.0, 100.0, -100.0)), std::vector<std::uint32_t>({ 0, 1, 2, 3 }));
+	EXPECT_TRUE(Query(index, BoundBox(40.0, 50.0, 50.0, 40.0)).empty());
+	EXPECT_TRUE(Query(index, BoundBox(6.0, 9.0, 9.0, 6.0)).empty());
+}
+
+TEST(SpatialIndexTest, TestSelectInsidePath) {
+	CommandStore commands;
+	commands.Add(Make(RenderCommand::gcBeginLine, 0.0, 0.0));
+	commands.Add(Make(RenderCommand::gcApertureSelect));
+	commands.Add(Make(RenderCommand::gcLine, 1.0, 0.0));
+	commands.Add(Make(RenderCommand::gcStroke));
+
+	SpatialIndex index;
+	EXPECT_FALSE(index.Build(commands));
+	EXPECT_FALSE(index.Valid());
+	EXPECT_EQ(index.size(), 0u);
+}
+
+TEST(SpatialIndexTest, TestMatchesExhaustiveSearch) {
+	std::mt19937 random(1);
+
+	for (auto name : { "2301113563-e-gbs", "2301113563-f-gtl", "lth_1-3.gbr", "susb.gbr" }) {
+		Gerber gerber(std::string(TestData) + name);
+		auto box = gerber.GetBBox();
+
+		for (const auto& level : gerber.Levels()) {
+			const auto& index = level->Index();
+			ASSERT_TRUE(index.Valid()) << name;
+
+			// Every drawing command is in exactly one primitive
+			std::size_t covered = 0;
+			for (std::size_t i = 0; i < index.size(); i++) {
+				covered += index[i].last_ - index[i].first_;
+				if (i > 0) {
+					EXPECT_GE(index[i].first_, index[i - 1].last_);
+				}
+			}
+			const auto& counts = level->command_counts_;
+			EXPECT_EQ(covered, level->RenderCommands().size() - counts[RenderCommand::gcApertureSelect] -
+				counts[RenderCommand::gcBeginOutline] - counts[RenderCommand::gcEndOutline]) << name;
+
+			std::uniform_real_distribution<double> x(box.Left(), box.Right());
+			std::uniform_real_distribution<double> y(box.Bottom(), box.Top());
+			std::uniform_real_distribution<double> size(0.0, box.Width() / 4.0);
+			for (int query = 0; query < 50; query++) {
+				const auto left = x(random), bottom = y(random);
+				const BoundBox region(left, left + size(random), bottom + size(random), bottom);
+
+				std::vector<std::uint32_t> expected;
+				for (std::uint32_t i = 0; i < index.size(); i++) {
+					if (Intersects(index[i], region)) {
+						expected.push_back(i);
+					}
+				}
+				EXPECT_EQ(Query(index, region), expected) << name;
+			}
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <iterator>
+#include "gerber/gerber_set.h"
+#include "gerber/zip_archive.h"
+#include "gerber/inflate_chunk_reader.h"
+
+
+namespace {
+
+std::string ReadFile(const std::string& file_name) {
+	std::ifstream file(file_name, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// Reads in small pieces so that every buffer boundary is crossed.
+std::string ReadAll(ChunkReader& reader) {
+	std::string text;
+	char buffer[1000];
+	while (auto size = reader.Read(buffer, sizeof(buffer))) {
+		text.append(buffer, size);
+	}
+	return text;
+}
+
+}
+
+TEST(ZipArchiveTest, TestMembers) {
+	ZipArchive archive;
+	ASSERT_TRUE(archive.Open(std::string(TestData) + "job.zip"));
+	EXPECT_EQ(archive.Names(), std::vector<std::string>({ "2301113563-e-gbs", "susb.gbr" }));
+	EXPECT_EQ(archive.Size("susb.gbr"), 10317);
+	EXPECT_EQ(archive.Size("missing.gbr"), 0);
+	EXPECT_EQ(archive.OpenMember("missing.gbr"), nullptr);
+
+	auto stored = archive.OpenMember("susb.gbr");
+	ASSERT_NE(stored, nullptr);
+	EXPECT_EQ(ReadAll(*stored), ReadFile(std::string(TestData) + "susb.gbr"));
+
+#ifdef GERBER_WITH_ZLIB
+	auto deflated = archive.OpenMember("2301113563-e-gbs");
+	ASSERT_NE(deflated, nullptr);
+	EXPECT_EQ(ReadAll(*deflated), ReadFile(std::string(TestData) + "2301113563-e-gbs"));
+#endif
+}
+
+TEST(ZipArchiveTest, TestNotAnArchive) {
+	ZipArchive archive;
+	EXPECT_FALSE(archive.Open(std::string(TestData) + "susb.gbr"));
+	EXPECT_TRUE(archive.Names().empty());
+}
+
+#ifdef GERBER_WITH_ZLIB
+TEST(ZipArchiveTest, TestGzip) {
+	std::ifstream file(std::string(TestData) + "lth_1-3.gbr.gz", std::ios::binary);
+	InflateChunkReader reader(std::make_unique<StreamChunkReader>(file));
+	EXPECT_EQ(ReadAll(reader), ReadFile(std::string(TestData) + "lth_1-3.gbr"));
+
+	Gerber plain(std::string(TestData) + "lth_1-3.gbr");
+	Gerber compressed(std::string(TestData) + "lth_1-3.gbr.gz");
+	EXPECT_EQ(compressed.GetBBox(), plain.GetBBox());
+	ASSERT_EQ(compressed.Levels().size(), plain.Levels().size());
+	EXPECT_EQ(compressed.Levels().front()->RenderCommands().size(), plain.Levels().front()->RenderCommands().size());
+}
+
+TEST(ZipArchiveTest, TestLoadArchive) {
+	GerberSet set(2);
+	auto futures = set.LoadArchive(std::string(TestData) + "job.zip");
+	ASSERT_EQ(futures.size(), 2);
+
+	for (auto& future : futures) {
+		auto gerber = future.get();
+		Gerber plain(std::string(TestData) + gerber->FileName());
+		EXPECT_EQ(gerber->GetBBox(), plain.GetBBox());
+		ASSERT_EQ(gerber->Levels().size(), plain.Levels().size());
+		for (size_t i = 0; i < plain.Levels().size(); ++i) {
+			EXPECT_EQ(gerber->Levels()[i]->RenderCommands().size(), plain.Levels()[i]->RenderCommands().size());
+		}
+	}
+}
+#endif
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include "engine/engine.h"
+#include "gerber_renderer.h"
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <sstream>
+#include <thread>
+
+
+// The calls GerberRender makes, which need no Qt
+namespace {
+
+// Records the calls a render makes, one line each
+class RecordingEngine : public Engine {
+public:
+	std::vector<std::string> calls_;
+	double pixel_size_{ 0.025 };
+
+	void EndDraw() override { Record("EndDraw"); }
+	void BeginDraw(bool negative) override { Record("BeginDraw", negative); }
+	void BeginOutline() override { Record("BeginOutline"); }
+	void EndOutline() override { Record("EndOutline"); }
+	void FillEvenOdd() override { Record("FillEvenOdd"); }
+	void Stroke() override { Record("Stroke"); }
+	void Close() override { Record("Close"); }
+	void DrawArc(double x, double y, double degree) override { Record("DrawArc", x, y, degree); }
+	void DrawLine(double x, double y) override { Record("DrawLine", x, y); }
+	void BeginSolidCircleLine(double x, double y, double line_width) override { Record("BeginSolidCircleLine", x, y, line_width); }
+	void BeginLine(double x, double y) override { Record("BeginLine", x, y); }
+	void DrawCircle(double x, double y, double r) override { Record("DrawCircle", x, y, r); }
+	void DrawRectangle(double x, double y, double w, double h) override { Record("DrawRectangle", x, y, w, h); }
+	void DrawRectLine(double x1, double y1, double x2, double y2, double w, double h) override { Record("DrawRectLine", x1, y1, x2, y2, w, h); }
+	void ApertureErase(double /*left*/, double /*bottom*/, double /*top*/, double /*right*/) override { Record("ApertureErase"); }
+	void ApertureFill() override { Record("ApertureFill"); }
+	void ApertureStroke() override { Record("ApertureStroke"); }
+	void ApertureClose() override { Record("ApertureClose"); }
+	void DrawApertureArc(double /*x*/, double /*y*/, double /*angle*/) override { Record("DrawApertureArc"); }
+	void DrawApertureLine(double /*x*/, double /*y*/) override { Record("DrawApertureLine"); }
+	void BeginApertureLine(double /*x*/, double /*y*/) override { Record("BeginApertureLine"); }
+	void DrawAperatureCircle(double /*x*/, double /*y*/, double /*w*/) override { Record("DrawAperatureCircle"); }
+	void DrawApertureRect(double /*x*/, double /*y*/, double /*w*/, double /*h*/) override { Record("DrawApertureRect"); }
+	void EndDrawAperture() override { Record("EndDrawAperture"); }
+	void PrepareDrawAperture() override { Record("PrepareDrawAperture"); }
+	void PrepareCopyLayer(double /*left*/, double /*bottom*/, double /*right*/, double /*top*/) override { Record("PrepareCopyLayer"); }
+	void CopyLayer(int /*count_x*/, int /*count_y*/, double /*step_x*/, double /*step_y*/) override { Record("CopyLayer"); }
+	void Prepare2Render() override { Record("Prepare2Render"); }
+	void Translate(double x, double y) override { Record("Translate", x, y); }
+	bool PrepareExistAperture(int code) override { return !apertures_.insert(code).second; }
+	void BeginRender() override { Record("BeginRender"); }
+	void EndRender() override { Record("EndRender"); }
+	int Flash(double x, double y) override { Record("Flash", x, y); return 0; }
+	void EndDrawNewAperture(int code) override { Record("EndDrawNewAperture", code); }
+	void NewAperture(double /*left*/, double /*bottom*/, double /*right*/, double /*top*/) override { Record("NewAperture"); }
+	void DrawDot(double x, double y) override { Record("DrawDot", x, y); }
+	double PixelSize() const override { return pixel_size_; }
+
+private:
+	template <typename... Args>
+	void Record(const char* name, Args... args) {
+		std::ostringstream call;
+		call << name;
+		((call << ' ' << args), ...);
+		calls_.push_back(call.str());
+	}
+
+	std::set<int> apertures_;
+};
+
+}
+
+TEST(GerbRenderTest, TestRenderRegion) {
+	// Without step and repeat, whose copies are drawn one by one in a region
+	auto gerber = std::make_shared<Gerber>(std::string(TestData) + "lth_1-3.gbr");
+	auto box = gerber->GetBBox();
+
+	RecordingEngine all;
+	GerberRender(&all).RenderGerber(gerber);
+
+	// Everything is visible, so nothing is skipped or reordered
+	RecordingEngine whole;
+	GerberRender(&whole).RenderGerber(gerber, BoundBox(box.Left() - 1, box.Right() + 1, box.Top() + 1, box.Bottom() - 1));
+	EXPECT_EQ(whole.calls_, all.calls_);
+
+	// Flashes well inside a corner are drawn, most others are not
+	const auto corner = BoundBox(box.Left(), box.Left() + box.Width() / 4, box.Bottom() + box.Height() / 4, box.Bottom());
+	RecordingEngine part;
+	GerberRender(&part).RenderGerber(gerber, corner);
+
+	std::vector<std::string> expected, flashes;
+	for (const auto& call : all.calls_) {
+		double x, y;
+		if (std::sscanf(call.c_str(), "Flash %lf %lf", &x, &y) == 2 &&
+			x > corner.Left() && x < corner.Right() && y > corner.Bottom() && y < corner.Top()) {
+			expected.push_back(call);
+		}
+	}
+	for (const auto& call : part.calls_) {
+		double x, y;
+		if (std::sscanf(call.c_str(), "Flash %lf %lf", &x, &y) == 2 &&
+			x > corner.Left() && x < corner.Right() && y > corner.Bottom() && y < corner.Top()) {
+			flashes.push_back(call);
+		}
+	}
+	EXPECT_FALSE(expected.empty());
+	EXPECT_EQ(flashes, expected);
+	EXPECT_LT(part.calls_.size(), all.calls_.size() / 2);
+}
+
+TEST(GerbRenderTest, TestRenderCopiesInRegion) {
+	auto gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+	auto box = gerber->GetBBox();
+
+	RecordingEngine all;
+	GerberRender(&all).RenderGerber(gerber);
+	EXPECT_NE(std::find(all.calls_.begin(), all.calls_.end(), "PrepareCopyLayer"), all.calls_.end());
+
+	// No image of a whole level is needed, and only the copies near the
+	// corner are drawn
+	const auto corner = BoundBox(box.Left(), box.Left() + box.Width() / 8, box.Bottom() + box.Height() / 8, box.Bottom());
+	RecordingEngine part;
+	GerberRender(&part).RenderGerber(gerber, corner);
+
+	std::set<std::string> translations;
+	for (const auto& call : part.calls_) {
+		EXPECT_NE(call, "PrepareCopyLayer");
+		EXPECT_NE(call, "CopyLayer");
+		if (call.rfind("Translate", 0) == 0) {
+			translations.insert(call);
+		}
+	}
+	EXPECT_TRUE(translations.count("Translate 0 0"));
+	EXPECT_LT(translations.size(), 6u * 5u);
+	EXPECT_LT(part.calls_.size(), all.calls_.size() / 2);
+}
+
+TEST(GerbRenderTest, TestLevelOfDetail) {
+	auto gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+
+	RecordingEngine all;
+	GerberRender(&all).RenderGerber(gerber);
+
+	// Below the finest tolerance nothing is simplified
+	RecordingEngine fine;
+	fine.level_of_detail_ = true;
+	fine.pixel_size_ = 0.001;
+	GerberRender(&fine).RenderGerber(gerber);
+	EXPECT_EQ(fine.calls_, all.calls_);
+
+	RecordingEngine coarse;
+	coarse.level_of_detail_ = true;
+	coarse.pixel_size_ = 0.5;
+	GerberRender(&coarse).RenderGerber(gerber);
+	EXPECT_LT(coarse.calls_.size(), all.calls_.size());
+	EXPECT_NE(std::find_if(coarse.calls_.begin(), coarse.calls_.end(), [](const std::string& call) {
+		return call.rfind("DrawDot", 0) == 0;
+	}), coarse.calls_.end());
+}
+
+TEST(GerbRenderTest, TestConcurrentRender) {
+	std::shared_ptr<const Gerber> gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+
+	RecordingEngine serial;
+	serial.convert_strokes2fills_ = true;
+	serial.level_of_detail_ = true;
+	GerberRender(&serial).RenderGerber(gerber);
+
+	// Fills, details and apertures are all made on first use, here by
+	// several threads at once
+	gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+	std::vector<RecordingEngine> engines(4);
+	std::vector<std::thread> threads;
+	for (auto& engine : engines) {
+		engine.convert_strokes2fills_ = true;
+		engine.level_of_detail_ = true;
+		threads.emplace_back([&gerber, &engine]() { GerberRender(&engine).RenderGerber(gerber); });
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (const auto& engine : engines) {
+		EXPECT_EQ(engine.calls_, serial.calls_);
+	}
+}
+
+TEST(GerbRenderTest, TestEmpty) {
+	auto gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+	auto box = gerber->GetBBox();
+
+	RecordingEngine engine;
+	GerberRender render(&engine);
+	EXPECT_FALSE(render.Empty(gerber, box));
+	EXPECT_TRUE(render.Empty(gerber, BoundBox(box.Right() + 1, box.Right() + 2, box.Top(), box.Bottom())));
+	EXPECT_TRUE(engine.calls_.empty());
+}
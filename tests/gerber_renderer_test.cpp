@@ -2,6 +2,7 @@
 #include <gmock/gmock.h>
 #include "engine/qt_engine.h"
 #include "gerber_renderer.h"
+#include "tiled_renderer.h"
 #include <QImage>
 #include <QApplication>
 
@@ -113,3 +114,81 @@ TEST(GerbRenderTest, TestConvertStroke2Fill) {
 	QImage expected(QString(TestData) + "results/2301113563-f-gtl_stroke2fill.bmp");
 	EXPECT_EQ(*image, expected);
 }
+
+TEST(GerbRenderTest, TestTiledRender) {
+	int argc = 0;
+	char* argv[1];
+	QApplication app(argc, argv);
+
+	std::shared_ptr<const Gerber> gerber = std::make_shared<Gerber>(std::string(TestData) + "2301113563-f-gtl");
+	auto box = gerber->GetBBox();
+
+	// Tiles do not depend on the thread that renders them
+	QImage serial(1000, 700, QImage::Format_RGB32);
+	TiledRender one(1, 128);
+	EXPECT_EQ(one.Render(gerber, box, serial), 0);
+	EXPECT_EQ(one.RenderedTiles() + one.SkippedTiles(), 8u * 6u);
+	EXPECT_GT(one.RenderedTiles(), 0u);
+
+	QImage parallel(1000, 700, QImage::Format_RGB32);
+	TiledRender four(4, 128);
+	EXPECT_EQ(four.Render(gerber, box, parallel), 0);
+	EXPECT_EQ(parallel, serial);
+
+	// Nothing there, so nothing is rendered
+	QImage empty(1000, 700, QImage::Format_RGB32);
+	EXPECT_EQ(four.Render(gerber, BoundBox(box.Right() + 1, box.Right() + 2, box.Top(), box.Bottom()), empty), 0);
+	EXPECT_EQ(four.RenderedTiles(), 0u);
+	QImage white(1000, 700, QImage::Format_RGB32);
+	white.fill(QColor(255, 255, 255));
+	EXPECT_EQ(empty, white);
+
+	// Converted tile by tile
+	QImage mono(1000, 700, QImage::Format_Mono);
+	EXPECT_EQ(four.Render(gerber, box, mono), 0);
+	QImage gray(1000, 700, QImage::Format_Grayscale8);
+	EXPECT_EQ(four.Render(gerber, box, gray), 0);
+	int different = 0;
+	for (int y = 0; y < serial.height(); y++) {
+		for (int x = 0; x < serial.width(); x++) {
+			const auto level = qGray(serial.pixel(x, y));
+			different += qGray(gray.pixel(x, y)) != level;
+			different += mono.pixel(x, y) != (level < 128 ? qRgb(0, 0, 0) : qRgb(255, 255, 255));
+		}
+	}
+	EXPECT_EQ(different, 0);
+
+	QImage argb(100, 100, QImage::Format_ARGB32);
+	EXPECT_EQ(one.Render(gerber, box, argb), -1);
+}
+
+TEST(GerbRenderTest, TestTiledRenderClearsTiles) {
+	int argc = 0;
+	char* argv[1];
+	QApplication app(argc, argv);
+
+	// The left tile is all black, the right one only has a dot in its corner
+	std::shared_ptr<const Gerber> gerber = Gerber::FromMemory(
+		"%FSLAX26Y26*%\n%MOMM*%\n%ADD10C,0.1*%\n"
+		"G01*\nG36*\nX0Y0D02*\nX1000000D01*\nY1000000D01*\nX0D01*\nY0D01*\nG37*\n"
+		"D10*\nX1900000Y100000D03*\nM02*\n");
+
+	// A single thread renders both tiles into the same tile image
+	TiledRender one(1, 128);
+	for (auto format : { QImage::Format_RGB32, QImage::Format_Grayscale8, QImage::Format_Mono }) {
+		QImage image(256, 128, format);
+		EXPECT_EQ(one.Render(gerber, BoundBox(0.0, 2.0, 1.0, 0.0), image), 0);
+		EXPECT_EQ(one.RenderedTiles(), 2u);
+
+		// Dark is red, a mid grey, except in Mono
+		EXPECT_LT(qGray(image.pixel(64, 64)), 128) << format;
+		EXPECT_LT(qGray(image.pixel(243, 115)), 128) << format;
+		int black = 0;
+		for (int y = 0; y < 100; y++) {
+			for (int x = 132; x < 228; x++) {
+				black += qGray(image.pixel(x, y)) < 128;
+			}
+		}
+		EXPECT_EQ(black, 0) << format;
+	}
+}